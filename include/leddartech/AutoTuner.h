@@ -0,0 +1,103 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    AutoTuner.h
+///
+/// \brief   Search of the acquisition settings for a rate/noise target.
+///
+/// Candidates are the combinations of the measurement rates, oversampling
+/// and accumulation exponents, base point counts and LED intensities to
+/// try. Each one is written to the sensor and measured on the live frames:
+/// the rate actually achieved and the spread of the distance of the
+/// nearest echo of each segment, which is the noise when the scene is
+/// still. The least noisy candidate achieving the target rate wins. The
+/// latency of a frame is at least its acquisition period, so a latency
+/// budget is a minimum rate too.
+// *****************************************************************************
+
+#pragma once
+
+#include <ros/ros.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "leddartech/PropertyCache.h"
+#include "leddartech/SegmentFrame.h"
+
+namespace leddartech
+{
+
+struct AutoTuneSettings
+{
+    AutoTuneSettings( void );
+
+    double              mTargetRate;        ///< Hz, minimum achieved rate.
+    double              mLatencyBudget;     ///< s, also a minimum rate when > 0.
+    std::vector<double> mRates;             ///< Values to try, empty keeps the current one.
+    std::vector<double> mOversampling;
+    std::vector<double> mAccumulation;
+    std::vector<double> mBasePoints;
+    std::vector<double> mLedIntensities;    ///< Disables the automatic intensity.
+    double              mSettleTime;        ///< s, frames ignored after a write.
+    int                 mMeasureFrames;
+    double              mMinDetections;     ///< Fraction of frames for a segment to count.
+    std::string         mReport;            ///< CSV of the measured candidates, empty for none.
+    bool                mAtStart;
+};
+
+struct TuneCandidate
+{
+    double       mRate;
+    double       mOversampling;
+    double       mAccumulation;
+    double       mBasePoints;
+    double       mLedIntensity;
+
+    int          mResult;           ///< LeddarC result of the write.
+    unsigned int mFrames;           ///< Measured.
+    double       mAchievedRate;     ///< Hz.
+    double       mNoise;            ///< m, mean standard deviation over the segments.
+    double       mDetectionRatio;   ///< Segments counted over segments.
+};
+
+class AutoTuner
+{
+public:
+    AutoTuner( void );
+
+    static void ReadSettings( const ros::NodeHandle &aPrivate, AutoTuneSettings &aSettings );
+
+    void Candidates( const AutoTuneSettings &aSettings, const PropertyCache &aProperties,
+                     std::vector<TuneCandidate> &aCandidates ) const;
+    static void Writes( const TuneCandidate &aCandidate, const PropertyCache &aProperties,
+                        bool aManualLed, std::vector<PropertyWrite> &aWrites );
+
+    void Begin( double aMinDetections );
+    void Add( const SegmentFrame &aFrame, double aMonotonic );
+    unsigned int Frames( void ) const { return mFrames.load(); }
+    void End( TuneCandidate &aCandidate );
+
+    static double TargetRate( const AutoTuneSettings &aSettings, double aCurrentRate );
+    static int Select( const std::vector<TuneCandidate> &aCandidates, double aTargetRate );
+    static bool WriteReport( const std::string &aPath, const std::vector<TuneCandidate> &aCandidates,
+                             int aSelected, double aTargetRate );
+
+private:
+    std::mutex                mMutex;
+    std::atomic<bool>         mActive;
+    std::atomic<unsigned int> mFrames;
+    double                    mMinDetections;
+    double                    mFirst;       ///< Monotonic time of the first frame.
+    double                    mLast;
+    unsigned int              mSegmentCount;
+    unsigned int              mCount[ LEDDAR_MAX_SEGMENTS ];
+    double                    mMean[ LEDDAR_MAX_SEGMENTS ];
+    double                    mM2[ LEDDAR_MAX_SEGMENTS ];   ///< Welford sum of squares.
+};
+
+} // namespace leddartech
+
+// End of file AutoTuner.h
@@ -0,0 +1,59 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    ChangeGate.h
+///
+/// \brief   Decides whether a frame differs enough from the last published
+///          one to be published.
+///
+/// A frame is published when a segment gained or lost an echo, or when an
+/// echo moved by more than the distance deadband of its segment or changed
+/// amplitude by more than the amplitude deadband. Comparing with the last
+/// published frame rather than the previous one keeps slow drifts from
+/// being suppressed forever. A keep-alive period bounds the time between
+/// two publications of a static scene.
+// *****************************************************************************
+
+#pragma once
+
+#include <vector>
+
+#include "leddartech/SegmentFrame.h"
+
+namespace leddartech
+{
+
+class ChangeGate
+{
+public:
+    enum Decision
+    {
+        GATE_CHANGED,
+        GATE_KEEP_ALIVE,
+        GATE_SUPPRESSED
+    };
+
+    ChangeGate( void );
+
+    void Configure( bool aEnabled, const std::vector<double> &aDistanceDeadbands,
+                    const std::vector<double> &aAmplitudeDeadbands, double aKeepAliveRate );
+    void Reset( void ) { mHaveReference = false; }
+
+    Decision Check( const SegmentFrame &aFrame );
+
+    bool Enabled( void ) const { return mEnabled; }
+
+private:
+    bool Changed( const SegmentFrame &aFrame ) const;
+
+    bool         mEnabled;
+    bool         mHaveReference;
+    double       mKeepAlivePeriod;      ///< 0 for no keep-alive.
+    float        mDistanceDeadband[ LEDDAR_MAX_SEGMENTS ];
+    float        mAmplitudeDeadband[ LEDDAR_MAX_SEGMENTS ];
+    SegmentFrame mReference;            ///< Last published frame.
+};
+
+} // namespace leddartech
+
+// End of file ChangeGate.h
@@ -0,0 +1,65 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    EventLoop.h
+///
+/// \brief   Wait for any of a set of events without polling.
+///
+/// Events are bits of a 32-bit mask chosen by the user. They come from
+/// three kinds of sources, all waited on with one epoll_wait:
+///
+///   - Post, from any thread or from a signal handler. Posts of an event
+///     already pending are merged and cost no system call, so it can be
+///     called for every frame from a data callback.
+///   - Periodic timers (timerfd), armed only while needed.
+///   - Readable file descriptors, such as the terminal.
+///
+/// Wait returns the events that happened since the previous Wait as soon
+/// as one happens, and uses no CPU until then.
+// *****************************************************************************
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <vector>
+
+namespace leddartech
+{
+
+class EventLoop
+{
+public:
+    EventLoop( void );
+    ~EventLoop( void );
+
+    bool Open( void );
+    void Close( void );
+
+    bool Watch( int aFd, uint32_t aEvents );
+    bool SetTimer( uint32_t aEvents, double aPeriod );
+    void Post( uint32_t aEvents );
+
+    uint32_t Wait( double aTimeout = -1 );
+
+private:
+    EventLoop( const EventLoop & );
+    EventLoop &operator=( const EventLoop & );
+
+    struct Source
+    {
+        int      mFd;
+        uint32_t mEvents;
+        bool     mTimer;    ///< Owned timerfd, to be read when it fires.
+    };
+
+    int                   mEpoll;
+    int                   mWake;      ///< eventfd written by Post.
+    std::atomic<uint32_t> mPending;   ///< Posted, not yet returned by Wait.
+    std::vector<Source>   mSources;
+};
+
+} // namespace leddartech
+
+// End of file EventLoop.h
@@ -0,0 +1,125 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    FrameRecorder.h
+///
+/// \brief   Record the processed frames to files, off the publisher thread.
+///
+/// Frames are encoded (see RecordFormat.h) into one of two buffers. When it
+/// is full, or holds frames older than the flush period, it is handed to a
+/// writer thread which compresses and writes it while the other one fills.
+/// Adding a frame therefore never waits for the disk: if both buffers are
+/// busy the frame is dropped and counted. Files are rotated once they reach
+/// the maximum size or duration.
+// *****************************************************************************
+
+#pragma once
+
+#include <ros/ros.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "leddartech/LatencyHistogram.h"
+#include "leddartech/SegmentFrame.h"
+
+namespace leddartech
+{
+
+struct RecorderSettings
+{
+    RecorderSettings( void );
+
+    static void Read( const ros::NodeHandle &aPrivate, RecorderSettings &aSettings );
+
+    std::string mDirectory;     ///< Record to this directory when not empty.
+    std::string mPrefix;        ///< Of the file names.
+    int         mCompression;   ///< zlib level, 0 stores the frames as is.
+    double      mMaxSize;       ///< MB per file, 0 for no limit.
+    double      mMaxDuration;   ///< s per file, 0 for no limit.
+    int         mBufferSize;    ///< KB per buffer.
+    double      mFlushPeriod;   ///< s, longest a frame waits in a buffer.
+};
+
+class FrameRecorder
+{
+public:
+    FrameRecorder( void );
+    ~FrameRecorder( void );
+
+    bool Open( const RecorderSettings &aSettings, unsigned int aSegmentCount );
+    void Add( const SegmentFrame &aFrame );
+    void Close( void );
+
+    bool Active( void ) const { return mActive.load(); }
+    std::string FileName( void ) const;
+
+    uint64_t Frames( void ) const { return mFrames.load(); }
+    uint64_t Dropped( void ) const { return mDropped.load(); }
+    uint64_t RawBytes( void ) const { return mRawBytes.load(); }
+    uint64_t StoredBytes( void ) const { return mStoredBytes.load(); }
+    double   WriteSeconds( void ) const { return mWriteSeconds.load(); }
+    unsigned Files( void ) const { return mFiles.load(); }
+
+    /// Time taken by Add, on the publisher thread.
+    LatencyHistogram &HandOffTime( void ) { return mHandOffTime; }
+
+private:
+    FrameRecorder( const FrameRecorder & );
+    FrameRecorder &operator=( const FrameRecorder & );
+
+    struct Buffer
+    {
+        std::vector<uint8_t> mData;
+        size_t               mSize;
+        uint32_t             mFrames;
+        double               mFirst;    ///< Monotonic time of the first frame.
+    };
+
+    bool HandOff( void );
+    void WriterThread( void );
+    void WriteBlock( const Buffer &aBuffer );
+    bool OpenFile( void );
+    void CloseFile( void );
+
+    RecorderSettings        mSettings;
+    unsigned int            mSegmentCount;
+    std::atomic<bool>       mActive;
+
+    // Producer side.
+    std::mutex              mFillMutex;     ///< Add against Close, uncontended.
+    Buffer                  mBuffers[2];
+    Buffer                 *mFill;
+
+    // Hand-off to the writer.
+    mutable std::mutex      mMutex;
+    std::condition_variable mWake;
+    Buffer                 *mFull;          ///< Null when the writer is idle.
+    bool                    mStop;
+    std::thread             mWriter;
+
+    // Writer side.
+    FILE                   *mFile;
+    std::string             mFileName;      ///< Guarded by mMutex.
+    uint64_t                mFileSize;
+    double                  mFileStart;
+    std::vector<uint8_t>    mCompressed;
+
+    std::atomic<uint64_t>   mFrames;
+    std::atomic<uint64_t>   mDropped;
+    std::atomic<uint64_t>   mRawBytes;
+    std::atomic<uint64_t>   mStoredBytes;
+    std::atomic<double>     mWriteSeconds;
+    std::atomic<unsigned>   mFiles;
+    LatencyHistogram        mHandOffTime;
+};
+
+} // namespace leddartech
+
+// End of file FrameRecorder.h
@@ -0,0 +1,59 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    LatencyHistogram.h
+///
+/// \brief   Fixed-bin histogram of latencies with percentile queries.
+///
+/// 2000 bins, 100 us wide (up to 200 ms) unless set otherwise, larger values
+/// go to the last bin.
+/// Adding a sample is a few relaxed atomic operations and never blocks, so
+/// it can be done for every frame from any thread. A reader takes a
+/// consistent snapshot (and resets the histogram) with Take, then queries
+/// the snapshot at leisure.
+// *****************************************************************************
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+namespace leddartech
+{
+
+class LatencyHistogram
+{
+public:
+    static const unsigned int kBinCount = 2000;
+
+    LatencyHistogram( void ) : mBinWidth( 100e-6 ) { Clear(); }
+
+    void SetBinWidth( double aSeconds ) { mBinWidth = aSeconds; Clear(); }
+    void Clear( void );
+    void Add( double aSeconds );
+    void Take( LatencyHistogram &aSource );
+
+    uint64_t Count( void ) const { return mCount.load( std::memory_order_relaxed ); }
+    double   Min( void ) const;
+    double   Max( void ) const;
+    double   Mean( void ) const;
+    double   Percentile( double aFraction ) const;
+
+private:
+    LatencyHistogram( const LatencyHistogram & );
+    LatencyHistogram &operator=( const LatencyHistogram & );
+
+    // Sum, min and max are kept in nanoseconds since there is no atomic
+    // floating point addition before C++20.
+    double                mBinWidth;
+    std::atomic<uint32_t> mBins[ kBinCount ];
+    std::atomic<uint64_t> mCount;
+    std::atomic<uint64_t> mSum;
+    std::atomic<uint64_t> mMin;
+    std::atomic<uint64_t> mMax;
+};
+
+} // namespace leddartech
+
+// End of file LatencyHistogram.h
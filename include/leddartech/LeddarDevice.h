@@ -0,0 +1,365 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    LeddarDevice.h
+///
+/// \brief   C++ layer over the LeddarC handle API. Header only.
+///
+/// A Device owns its LeddarHandle: it is created with the device, destroyed
+/// with it and moves with it, a Device cannot be copied. Calls return a
+/// Result instead of a bare code. Properties are read and written by their
+/// LdProperties id, with the value type given by PropertyTraits.
+///
+/// Data callbacks can be any callable taking the data levels and returning
+/// whether to be called again. The device registers a trampoline
+/// instantiated for the callable type with the callable itself as the user
+/// data: nothing is allocated and the call is direct. The callable must
+/// outlive its registration.
+///
+/// Detections are fetched into a buffer the caller keeps (a frame of a ring,
+/// a DetectionBuffer) and handed back as a DetectionView over that buffer:
+/// LeddarC writes them in place and nothing else copies them.
+///
+///   Device          lDevice;
+///   DetectionBuffer lBuffer;
+///   auto            lOnData = [&]( LeddarU32 ) {
+///                       for( const LdDetection &lDetection : lDevice.Detections( lBuffer ) ) ...
+///                       return true;
+///                   };
+///
+///   if ( lDevice.Connect( "" ).Ok() && lDevice.AddCallback( lOnData ).Ok() ) ...
+// *****************************************************************************
+
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "LeddarC.h"
+#include "LeddarProperties.h"
+#include "LeddarResults.h"
+
+namespace leddartech
+{
+
+// *****************************************************************************
+/// \brief   Code returned by a LeddarC call: LD_SUCCESS, negative for a
+///          failure, positive for a success with a warning.
+// *****************************************************************************
+
+class Result
+{
+public:
+    Result( int aCode = LD_SUCCESS ) : mCode( aCode ) {}
+
+    bool Ok( void ) const { return mCode == LD_SUCCESS; }
+    int  Code( void ) const { return mCode; }
+
+    std::basic_string<LtChar> Message( void ) const
+    {
+        LtChar lMessage[200];
+
+        if ( LeddarGetErrorMessage( mCode, lMessage, sizeof( lMessage ) / sizeof( lMessage[0] ) )
+             != LD_SUCCESS )
+        {
+            return std::basic_string<LtChar>();
+        }
+
+        return lMessage;
+    }
+
+    bool operator==( const Result &aOther ) const { return mCode == aOther.mCode; }
+    bool operator!=( const Result &aOther ) const { return mCode != aOther.mCode; }
+
+private:
+    int mCode;
+};
+
+// *****************************************************************************
+/// \brief   Value type of a property: text for PID_NAME, a number otherwise.
+// *****************************************************************************
+
+template< LdProperties tId >
+struct PropertyTraits
+{
+    typedef double Type;
+};
+
+template<>
+struct PropertyTraits<PID_NAME>
+{
+    typedef std::string Type;
+};
+
+// *****************************************************************************
+/// \brief   Detections of one frame, in a buffer owned by someone else.
+///          Valid until that buffer is written again.
+// *****************************************************************************
+
+class DetectionView
+{
+public:
+    typedef const LdDetection *const_iterator;
+
+    DetectionView( void ) : mData( NULL ), mSize( 0 ) {}
+    DetectionView( const LdDetection *aData, unsigned int aSize ) : mData( aData ), mSize( aSize ) {}
+
+    const LdDetection *begin( void ) const { return mData; }
+    const LdDetection *end( void ) const { return mData + mSize; }
+
+    const LdDetection *Data( void ) const { return mData; }
+    unsigned int       Size( void ) const { return mSize; }
+    bool               Empty( void ) const { return mSize == 0; }
+
+    const LdDetection &operator[]( unsigned int aIndex ) const { return mData[ aIndex ]; }
+
+private:
+    const LdDetection *mData;
+    unsigned int       mSize;
+};
+
+// *****************************************************************************
+/// \brief   Reusable detection storage. Grows to the largest frame fetched
+///          into it and is not reallocated afterwards.
+// *****************************************************************************
+
+class DetectionBuffer
+{
+public:
+    explicit DetectionBuffer( unsigned int aCapacity = 64 ) : mDetections( aCapacity ) {}
+
+    void Reserve( unsigned int aCapacity )
+    {
+        if ( aCapacity > mDetections.size() )
+        {
+            mDetections.resize( aCapacity );
+        }
+    }
+
+    LdDetection *Data( void ) { return mDetections.data(); }
+    unsigned int Capacity( void ) const { return mDetections.size(); }
+
+private:
+    std::vector<LdDetection> mDetections;
+};
+
+// *****************************************************************************
+/// \brief   One sensor connection or loaded record.
+///
+/// Calls on one device must be serialized by the user, as for LeddarC,
+/// except what the data callback does on the device it is called for.
+// *****************************************************************************
+
+class Device
+{
+public:
+    Device( void ) : mHandle( LeddarCreate() ) {}
+    ~Device( void ) { Destroy(); }
+
+    Device( Device &&aOther ) : mHandle( aOther.mHandle ) { aOther.mHandle = NULL; }
+
+    Device &operator=( Device &&aOther )
+    {
+        if ( this != &aOther )
+        {
+            Destroy();
+            mHandle = aOther.mHandle;
+            aOther.mHandle = NULL;
+        }
+
+        return *this;
+    }
+
+    /// \brief   The handle, for LeddarC calls not wrapped here. Still owned.
+    LeddarHandle Handle( void ) const { return mHandle; }
+
+    // Connection.
+    Result Connect( const std::string &aAddress ) { return LeddarConnect( mHandle, aAddress.c_str() ); }
+    void   Disconnect( void ) { LeddarDisconnect( mHandle ); }
+    bool   Connected( void ) const { return LeddarGetConnected( mHandle ) != 0; }
+    Result Ping( void ) { return LeddarPing( mHandle ); }
+
+    // Records, loaded or made by LeddarC.
+    Result LoadRecord( const std::basic_string<LtChar> &aFileName )
+    {
+        return LeddarLoadRecord( mHandle, aFileName.c_str() );
+    }
+
+    size_t RecordSize( void ) const { return LeddarGetRecordSize( mHandle ); }
+    bool   RecordLoading( void ) const { return LeddarGetRecordLoading( mHandle ) != 0; }
+    size_t RecordIndex( void ) const { return LeddarGetCurrentRecordIndex( mHandle ); }
+    Result StepForward( void ) { return LeddarStepForward( mHandle ); }
+    Result StepBackward( void ) { return LeddarStepBackward( mHandle ); }
+    Result MoveRecordTo( unsigned int aIndex ) { return LeddarMoveRecordTo( mHandle, aIndex ); }
+
+    bool   Recording( void ) const { return LeddarGetRecording( mHandle ) != 0; }
+    Result StartRecording( void ) { return LeddarStartRecording( mHandle ); }
+    void   StopRecording( void ) { LeddarStopRecording( mHandle ); }
+
+    // Properties, by id and index (per segment, 0 otherwise).
+    Result GetProperty( LdProperties aId, unsigned int aIndex, double &aValue ) const
+    {
+        return LeddarGetProperty( mHandle, aId, aIndex, &aValue );
+    }
+
+    Result GetProperty( LdProperties aId, unsigned int aIndex, std::string &aValue ) const
+    {
+        char         lText[256];
+        const Result lResult = LeddarGetTextProperty( mHandle, aId, aIndex, lText, sizeof( lText ) );
+
+        if ( lResult.Ok() )
+        {
+            lText[ sizeof( lText ) - 1 ] = 0;
+            aValue = lText;
+        }
+
+        return lResult;
+    }
+
+    Result SetProperty( LdProperties aId, unsigned int aIndex, double aValue )
+    {
+        return LeddarSetProperty( mHandle, aId, aIndex, aValue );
+    }
+
+    Result SetProperty( LdProperties aId, unsigned int aIndex, const std::string &aValue )
+    {
+        return LeddarSetTextProperty( mHandle, aId, aIndex, aValue.c_str() );
+    }
+
+    /// \brief   Read a property as the type it has, PropertyTraits<tId>::Type.
+    template< LdProperties tId >
+    Result Get( typename PropertyTraits<tId>::Type &aValue, unsigned int aIndex = 0 ) const
+    {
+        return GetProperty( tId, aIndex, aValue );
+    }
+
+    template< LdProperties tId >
+    Result Set( const typename PropertyTraits<tId>::Type &aValue, unsigned int aIndex = 0 )
+    {
+        return SetProperty( tId, aIndex, aValue );
+    }
+
+    Result WriteConfiguration( void ) { return LeddarWriteConfiguration( mHandle ); }
+    Result RestoreConfiguration( void ) { return LeddarRestoreConfiguration( mHandle ); }
+    bool   ConfigurationModified( void ) const { return LeddarGetConfigurationModified( mHandle ) != 0; }
+
+    Result GetResult( LdResults aId, unsigned int aIndex, double &aValue ) const
+    {
+        return LeddarGetResult( mHandle, aId, aIndex, &aValue );
+    }
+
+    // *************************************************************************
+    /// \brief   Have a callable called with the data levels of each frame
+    ///          from the LeddarC thread. It returns true to be called again.
+    ///          Removed with RemoveCallback and the same object.
+    // *************************************************************************
+
+    template< typename tCallback >
+    Result AddCallback( tCallback &aCallback )
+    {
+        return LeddarAddCallback( mHandle, &Trampoline<tCallback>, &aCallback );
+    }
+
+    template< typename tCallback >
+    Result RemoveCallback( tCallback &aCallback )
+    {
+        return LeddarRemoveCallback( mHandle, &Trampoline<tCallback>, &aCallback );
+    }
+
+    Result StartDataTransfer( LeddarU32 aLevels ) { return LeddarStartDataTransfer( mHandle, aLevels ); }
+    void   StopDataTransfer( void ) { LeddarStopDataTransfer( mHandle ); }
+
+    /// \brief   Number of detections of the current frame.
+    unsigned int DetectionCount( void ) const { return LeddarGetDetectionCount( mHandle ); }
+
+    // *************************************************************************
+    /// \brief   Fetch the detections of the current frame into a buffer.
+    ///
+    /// \param   aBuffer    Where LeddarC writes them.
+    /// \param   aCapacity  Length of aBuffer, extra detections are left out.
+    ///
+    /// \return  The detections fetched, in aBuffer.
+    // *************************************************************************
+
+    DetectionView Detections( LdDetection *aBuffer, unsigned int aCapacity ) const
+    {
+        unsigned int lCount = LeddarGetDetectionCount( mHandle );
+
+        if ( lCount > aCapacity )
+        {
+            lCount = aCapacity;
+        }
+
+        if ( LeddarGetDetections( mHandle, aBuffer, aCapacity ) < 0 )
+        {
+            lCount = 0;
+        }
+
+        return DetectionView( aBuffer, lCount );
+    }
+
+    template< size_t tCapacity >
+    DetectionView Detections( LdDetection ( &aBuffer )[ tCapacity ] ) const
+    {
+        return Detections( aBuffer, tCapacity );
+    }
+
+    /// \brief   Fetch all the detections, growing the buffer if needed.
+    DetectionView Detections( DetectionBuffer &aBuffer ) const
+    {
+        aBuffer.Reserve( LeddarGetDetectionCount( mHandle ) );
+        return Detections( aBuffer.Data(), aBuffer.Capacity() );
+    }
+
+    // *************************************************************************
+    /// \brief   Addresses of the sensors that answer within aTimeout ms.
+    // *************************************************************************
+
+    static Result ListSensors( std::vector<std::string> &aAddresses, unsigned int aTimeout )
+    {
+        char         lAddresses[1024] = { 0 };
+        unsigned int lCount = sizeof( lAddresses );
+        const Result lResult = LeddarListSensors( lAddresses, &lCount, aTimeout );
+        size_t       lIndex = 0;
+
+        aAddresses.clear();
+
+        while( lResult.Ok() && ( lIndex < sizeof( lAddresses ) ) && ( lAddresses[lIndex] != 0 ) )
+        {
+            const size_t lLength = strnlen( lAddresses + lIndex, sizeof( lAddresses ) - lIndex );
+
+            aAddresses.push_back( std::string( lAddresses + lIndex, lLength ) );
+            lIndex += lLength + 1;
+        }
+
+        return lResult;
+    }
+
+private:
+    Device( const Device & );
+    Device &operator=( const Device & );
+
+    template< typename tCallback >
+    static LeddarBool Trampoline( void *aCallback, LeddarU32 aLevels )
+    {
+        return ( *static_cast<tCallback *>( aCallback ) )( aLevels ) ? 1 : 0;
+    }
+
+    void Destroy( void )
+    {
+        if ( mHandle != NULL )
+        {
+            LeddarDestroy( mHandle );
+            mHandle = NULL;
+        }
+    }
+
+    LeddarHandle mHandle;
+};
+
+} // namespace leddartech
+
+// End of file LeddarDevice.h
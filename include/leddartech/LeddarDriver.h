@@ -0,0 +1,69 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    LeddarDriver.h
+///
+/// \brief   Headless driver: the set of sensors configured by parameters.
+///
+/// Shared by the standalone node and the nodelet. The sensors are opened
+/// concurrently in the background so that a missing sensor neither delays
+/// the others nor blocks the nodelet manager while loading.
+///
+/// A sensor that stops for good (lost without reconnect, end of the record
+/// with exit_at_end) never stops the others: the node exits once all of them
+/// are finished, a nodelet only loses that sensor.
+// *****************************************************************************
+
+#pragma once
+
+#include <ros/ros.h>
+#include <stddef.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "leddartech/LeddarSensor.h"
+
+namespace leddartech
+{
+
+class LeddarDriver
+{
+public:
+    LeddarDriver( ros::NodeHandle &aNode, ros::NodeHandle &aPrivate,
+                  const LeddarSensorOptions &aDefaults,
+                  const std::function<void( void )> &aAllFinished = std::function<void( void )>() );
+    ~LeddarDriver( void );
+
+    size_t SensorCount( void ) const { return mSensors.size(); }
+
+    void   Start( void );
+    size_t WaitOpened( void );
+
+private:
+    LeddarDriver( const LeddarDriver & );
+    LeddarDriver &operator=( const LeddarDriver & );
+
+    static void DiscoverSensors( std::vector<std::string> &aAddresses );
+
+    void OpenSensor( size_t aIndex );
+    void SensorFinished( size_t aIndex );
+
+    std::vector< std::unique_ptr<LeddarSensor> > mSensors;
+    std::vector<std::thread>                     mOpeners;
+    std::vector<char>                            mOpened;
+
+    // Sensors stopped for good, from their own threads.
+    std::function<void( void )>                  mAllFinished;
+    std::mutex                                   mFinishedMutex;
+    std::vector<char>                            mFinished;
+    size_t                                       mFinishedCount;
+};
+
+} // namespace leddartech
+
+// End of file LeddarDriver.h
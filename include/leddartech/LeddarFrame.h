@@ -0,0 +1,38 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    LeddarFrame.h
+///
+/// \brief   Raw detection frame copied out of the LeddarC data callback.
+// *****************************************************************************
+
+#pragma once
+
+#include <ros/time.h>
+#include <stddef.h>
+
+#include "LeddarC.h"
+
+namespace leddartech
+{
+
+/// Maximum number of segments of a supported sensor.
+#define LEDDAR_MAX_SEGMENTS 64
+/// Maximum number of echoes kept per segment, the farthest ones are dropped.
+#define LEDDAR_MAX_ECHOES 6
+/// Maximum number of detections kept per frame: every echo of every segment.
+#define LEDDAR_MAX_DETECTIONS ( LEDDAR_MAX_SEGMENTS * LEDDAR_MAX_ECHOES )
+
+struct LeddarFrame
+{
+    ros::Time    mArrival;      ///< Time at which the callback was called.
+    double       mMonotonic;    ///< Same on the monotonic clock, for timing.
+    size_t       mRecordIndex;  ///< Record index when replaying, 0 otherwise.
+    unsigned int mLevels;       ///< Data levels received in that frame.
+    unsigned int mCount;        ///< Number of valid entries in mDetections.
+    LdDetection  mDetections[ LEDDAR_MAX_DETECTIONS ];
+};
+
+} // namespace leddartech
+
+// End of file LeddarFrame.h
@@ -0,0 +1,345 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    LeddarSensor.h
+///
+/// \brief   One Leddar sensor (or record) driven by the node.
+///
+/// Each sensor owns its Device, the ring its data callback fills, the
+/// publisher thread draining it, its messages, stamp estimation and
+/// sequence counter, and publishes under its own namespace. Nothing is
+/// shared between sensors on the data path, so a slow sensor or subscriber
+/// never delays another sensor.
+// *****************************************************************************
+
+#pragma once
+
+#include <boost/thread/recursive_mutex.hpp>
+#include <dynamic_reconfigure/server.h>
+#include <leddartech/LeddarConfig.h>
+#include <leddartech/ZoneEvent.h>
+#include <ros/ros.h>
+#include <rosbag/bag.h>
+#include <std_srvs/Empty.h>
+#include <semaphore.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LeddarC.h"
+#include "leddartech/AutoTuner.h"
+#include "leddartech/ChangeGate.h"
+#include "leddartech/EventLoop.h"
+#include "leddartech/LatencyHistogram.h"
+#include "leddartech/FrameRecorder.h"
+#include "leddartech/LeddarDevice.h"
+#include "leddartech/LeddarFrame.h"
+#include "leddartech/MessagePool.h"
+#include "leddartech/PipelineStats.h"
+#include "leddartech/PropertyCache.h"
+#include "leddartech/RecordReader.h"
+#include "leddartech/ScanBatcher.h"
+#include "leddartech/ScanBuilder.h"
+#include "leddartech/SegmentFrame.h"
+#include "leddartech/ShmWriter.h"
+#include "leddartech/SpscRing.h"
+#include "leddartech/StampFilter.h"
+#include "leddartech/TemporalFilter.h"
+#include "leddartech/ZoneMonitor.h"
+
+namespace leddartech
+{
+
+// *****************************************************************************
+/// \brief   Per-sensor settings. Read first from the node private namespace
+///          then overridden from the sensor private namespace.
+// *****************************************************************************
+
+struct LeddarSensorOptions
+{
+    LeddarSensorOptions( void );
+
+    void Read( const ros::NodeHandle &aPrivate );
+
+    std::string   mAddress;             ///< Empty for the single USB sensor.
+    std::string   mReplayFile;          ///< Replay this record if not empty.
+    double        mReplayRate;          ///< Times the recorded rate, 0 for as fast as possible.
+    double        mReplayStartStamp;    ///< Stamp of the first record frame, 0 for now.
+    bool          mReplayWaitLoaded;    ///< Replay only once the whole record is indexed.
+    std::string   mBagFile;             ///< Write the replay to this bag instead of publishing.
+    bool          mExitAtEnd;           ///< Finish the sensor at the end of the record.
+    std::string   mFrameId;
+    std::string   mCloudFrameId;        ///< Empty to use mFrameId.
+    int           mCloudEchoes;
+    bool          mApplyTransform;
+    int           mQueueSize;
+    int           mDataLevels;
+    bool          mAutostart;
+    double        mPingPeriod;
+    double        mStallTimeout;        ///< No frame for this long is a lost link, 0 disables.
+    bool          mReconnect;           ///< Reconnect when lost, otherwise finish.
+    double        mReconnectBackoffMin;
+    double        mReconnectBackoffMax;
+    double        mConnectRetryPeriod;
+    double        mConnectTimeout;
+    double        mLatencyOffset;
+    double        mLatencyReportPeriod;
+    double        mDiagnosticsPeriod;   ///< 0 disables the diagnostics.
+    bool          mReconfigure;         ///< Serve the sensor properties with dynamic_reconfigure.
+    std::string   mFilter;              ///< none, median, exponential or kalman.
+    int           mFilterWindow;
+    double        mFilterAlpha;
+    double        mFilterProcessNoise;
+    double        mFilterMeasurementNoise;
+    double        mFilterMinAmplitude;
+    int           mBatchFrames;         ///< Frames per leddar_scan_batch, 0 to disable.
+    double        mBatchMaxLatency;     ///< Span (s) completing a batch early, 0 for none.
+    int           mBatchEchoes;
+    bool          mPublishOnChange;     ///< Suppress frames similar to the last published.
+    std::vector<double> mChangeDistanceDeadband;    ///< m, per segment or one for all.
+    std::vector<double> mChangeAmplitudeDeadband;   ///< Per segment or one for all.
+    double        mKeepAliveRate;       ///< Minimum rate (Hz) when publishing on change.
+    bool          mSensorZone;          ///< Also monitor the zone set in the sensor.
+    std::vector<ZoneSettings> mZones;
+    AutoTuneSettings mAutoTune;
+    RecorderSettings mRecord;
+    std::string   mShmName;             ///< Shared memory frame ring, empty disables.
+    int           mShmSlots;            ///< Frames kept in the ring.
+    ros::WallTime mStartTime;           ///< Reference for time-to-first-frame.
+};
+
+class LeddarSensor
+{
+public:
+    LeddarSensor( const std::string &aName, const LeddarSensorOptions &aOptions,
+                  ros::NodeHandle &aNode, ros::NodeHandle &aPrivate );
+    ~LeddarSensor( void );
+
+    const std::string &Name( void ) const { return mName; }
+    Device &Handle( void ) { return mDevice; }
+
+    bool Open( void );
+    void AbortOpen( void ) { mAbortOpen = true; }
+
+    /// \brief   Called once the sensor stopped for good: lost without
+    ///          reconnect, or at the end of the record with exit_at_end.
+    ///          Set before Activate.
+    void SetFinishedCallback( const std::function<void( void )> &aCallback ) { mFinished = aCallback; }
+    void Activate( void );
+    void Close( void );
+
+    void Configure( void );
+    bool StartStreaming( void );
+    void StopStreaming( void );
+
+    bool StartRecording( void );
+    void StopRecording( void );
+    FrameRecorder &Recorder( void ) { return mRecorder; }
+
+    void SetFrameEvents( EventLoop *aLoop, uint32_t aEvents );
+
+    const PropertyCache &Properties( void ) const { return mProperties; }
+    int WriteProperties( const std::vector<PropertyWrite> &aWrites );
+
+private:
+    LeddarSensor( const LeddarSensor & );
+    LeddarSensor &operator=( const LeddarSensor & );
+
+    // Drives PublishFrame directly (test/allocations.cpp).
+    friend class LeddarSensorTest;
+
+    // Registered with the device for the data callback, calls OnData.
+    struct DataHandler
+    {
+        explicit DataHandler( LeddarSensor *aSensor ) : mSensor( aSensor ) {}
+
+        bool operator()( LeddarU32 aLevels ) const { return mSensor->OnData( aLevels ); }
+
+        LeddarSensor *mSensor;
+    };
+
+    bool         OnData( LeddarU32 aLevels );
+
+    void         PublisherThread( void );
+    void         ApplyProperties( void );
+    bool         StartTransfer( void );
+    void         StopTransfer( void );
+    void         PublishFrame( const LeddarFrame &aFrame );
+    template< typename M >
+    void         PublishMessage( ros::Publisher &aPublisher, bool aAlways,
+                                 boost::shared_ptr<const M> ( ScanBuilder::*aBuild )(
+                                     const SegmentFrame &, uint32_t ),
+                                 double &aBuildTime, double &aPublishTime );
+    template< typename M >
+    void         Send( ros::Publisher &aPublisher, const boost::shared_ptr<const M> &aMessage );
+    void         PublishZoneEvents( void );
+    void         PublishBatch( void );
+    void         FlushBatch( void );
+    void         ReportLatency( void );
+    unsigned int GetSegmentCount( void );
+
+    bool     StepReplay( void );
+    int      StepRecord( void );
+    uint64_t RecordSize( void );
+    bool     RecordLoading( void );
+    void     PublishRecordSize( void );
+    void ReplayThread( void );
+    void FinishReplay( void );
+    void WaitPublished( void );
+    void WaitPublishedCount( uint64_t aCount );
+    void OpenBag( void );
+    void CloseBag( void );
+
+    void WatchdogThread( void );
+    bool WatchdogSleep( double aSeconds );
+    void Reconnect( void );
+    void ReplayTimer( const ros::WallTimerEvent &aEvent );
+    void OverflowTimer( const ros::WallTimerEvent &aEvent );
+    void DiagnosticsTimer( const ros::WallTimerEvent &aEvent );
+    bool StartService( std_srvs::Empty::Request &, std_srvs::Empty::Response & );
+    bool StopService( std_srvs::Empty::Request &, std_srvs::Empty::Response & );
+    void ReconfigureCallback( LeddarConfig &aConfig, uint32_t aLevel );
+    bool AutoTuneService( std_srvs::Empty::Request &, std_srvs::Empty::Response & );
+    bool StartRecordingService( std_srvs::Empty::Request &, std_srvs::Empty::Response & );
+    bool StopRecordingService( std_srvs::Empty::Request &, std_srvs::Empty::Response & );
+    bool StartAutoTune( void );
+    void AutoTuneThread( void );
+    bool TuneSleep( double aSeconds, unsigned int aFrames = 0 );
+    bool TuneResume( void );
+    void WakeTuner( void );
+
+    const std::string   mName;
+    const std::string   mLabel;     ///< Name used in the logs.
+    LeddarSensorOptions mOptions;
+    Device              mDevice;
+    DataHandler         mDataHandler;
+    ros::NodeHandle     mTopics;
+    ros::NodeHandle     mPrivate;
+    std::mutex          mControlMutex;  ///< Serializes start, stop and steps.
+    bool                mStreaming;     ///< Data transfer started.
+    bool                mWantStreaming; ///< Started by the user, restored on reconnect.
+    bool                mFirstFrame;
+    double              mMeasurementRate;
+    std::atomic<bool>   mAbortOpen;     ///< Set to give up connecting.
+    std::function<void( void )> mFinished;
+    PropertyCache       mProperties;
+    std::atomic<bool>   mPropertiesWritten; ///< For the publisher thread to apply.
+
+    // Connection supervision of a live sensor.
+    enum WatchdogState
+    {
+        WATCHDOG_OFF,
+        WATCHDOG_CONNECTED,
+        WATCHDOG_RECONNECTING
+    };
+
+    std::thread             mWatchdogThread;
+    std::mutex              mWatchdogMutex;
+    std::condition_variable mWatchdogWake;
+    bool                    mWatchdogStop;
+    std::atomic<int>        mWatchdogState;
+    std::atomic<uint64_t>   mReconnects;
+    std::atomic<double>     mLastDowntime;
+    std::atomic<double>     mTotalDowntime;
+
+    // Replay of a record.
+    bool                mReplaying;
+    ros::Time           mReplayOrigin;      ///< Stamp of record frame 0.
+    std::atomic<bool>   mReplayRunning;
+    std::thread         mReplayThread;      ///< Steps as fast as possible.
+    ros::WallTime       mReplayStartTime;   ///< For the throughput report.
+    uint64_t            mReplayStartCount;
+    RecordReader        mReader;            ///< Replay of a FrameRecorder record.
+    uint64_t            mReplayIndex;       ///< Next frame of mReader.
+    SegmentFrame        mReplayFrame;
+    std::atomic<uint64_t> mKnownRecordSize; ///< Last published on record_size.
+
+    // Acquisition auto-tuning.
+    AutoTuner           mTuner;
+    std::thread         mTuneThread;
+    std::atomic<bool>   mTuning;
+    std::atomic<bool>   mTuneAbort;
+    std::mutex              mTuneMutex;
+    std::condition_variable mTuneWake;  ///< Frames measured, reconnection or abort.
+
+    FrameRecorder       mRecorder;
+    std::atomic<EventLoop *> mFrameLoop;   ///< Told of each frame received, if not null.
+    uint32_t            mFrameEvents;
+    ShmWriter           mShm;           ///< Written by the publisher thread.
+
+    // Callback to publisher thread hand-off.
+    SpscRing<LeddarFrame> mRing;
+    sem_t                 mFrameReady;
+    std::atomic<bool>     mRunning;
+    std::thread           mPublisherThread;
+    std::atomic<uint64_t> mPublished;       ///< Frames taken from the ring.
+    std::atomic<unsigned> mPublishedWaiters;///< Threads in WaitPublishedCount.
+    std::mutex              mPublishedMutex;
+    std::condition_variable mPublishedWake; ///< Notified on mPublished if waited on.
+    std::atomic<uint64_t> mSuppressed;      ///< Of which not published, unchanged.
+    std::atomic<uint64_t> mKeepAlives;      ///< Of which published unchanged.
+    std::atomic<uint64_t> mTruncated;       ///< Frames with more detections than kept.
+    uint64_t              mLastDropped;
+
+    // Written by the callback and publisher threads, taken by the
+    // diagnostics timer.
+    PipelineStats         mStats;
+    double                mLastMonotonic;   ///< Previous arrival, publisher thread only.
+
+    // Only used by the diagnostics timer.
+    LatencyHistogram      mDiagnosticsStage;
+    uint64_t              mDiagnosticsPublished;
+    uint64_t              mDiagnosticsDropped;
+    uint64_t              mDiagnosticsSuppressed;
+    ros::WallTime         mDiagnosticsTime;
+
+    // Only used by the publisher thread.
+    ScanBuilder      mScanBuilder;
+    SegmentFrame     mSegmentFrame;
+    StampFilter      mStampFilter;
+    TemporalFilter   mFilter;
+    ZoneMonitor      mZoneMonitor;
+    MessagePool<ZoneEvent> mZoneEvents;
+    ChangeGate       mChangeGate;
+    ScanBatcher      mBatcher;
+    LatencyHistogram mLatency;
+    ros::WallTime    mLatencyReportTime;
+    ros::WallTime    mLatencyReportStart;
+    uint32_t         mSequence;
+    rosbag::Bag      mBag;
+    bool             mBagOpen;
+
+    ros::Publisher     mScanPublisher;
+    ros::Publisher     mMultiEchoPublisher;
+    ros::Publisher     mCloudPublisher;
+    ros::Publisher     mDroppedPublisher;
+    ros::Publisher     mRecordSizePublisher;
+    ros::Publisher     mZonePublisher;
+    ros::Publisher     mBatchPublisher;
+    ros::Publisher     mDiagnosticsPublisher;
+    ros::ServiceServer mStartServer;
+    ros::ServiceServer mStopServer;
+    ros::ServiceServer mAutoTuneServer;
+    ros::ServiceServer mStartRecordingServer;
+    ros::ServiceServer mStopRecordingServer;
+    ros::WallTimer     mTimer;
+    ros::WallTimer     mOverflowTimer;
+    ros::WallTimer     mDiagnosticsTimer;
+
+    typedef dynamic_reconfigure::Server<LeddarConfig> ReconfigureServer;
+
+    boost::recursive_mutex             mReconfigureMutex;
+    std::unique_ptr<ReconfigureServer> mReconfigureServer;
+};
+
+} // namespace leddartech
+
+// End of file LeddarSensor.h
@@ -0,0 +1,100 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    LeddarShm.h
+///
+/// \brief   Shared-memory ring of the segment-binned frames, for local
+///          readers that are not ROS nodes. C and C++.
+///
+/// With shm_name set, the driver writes every processed frame (the frame
+/// published on leddar_scan, before the publish_on_change gate) to a POSIX
+/// shared memory object of that name. The ring keeps the last slot_count
+/// frames. Each slot is guarded by a sequence lock: the writer makes its
+/// sequence odd while it writes the slot, and never waits for the readers.
+/// A reader copies the slot and keeps the copy only if the sequence was
+/// even and unchanged across the copy. Reading takes no system call and no
+/// lock; a reader only ever loses the frames the writer lapped.
+///
+///   LeddarShm      *lShm = LeddarShmOpen( "/leddar" );
+///   LeddarShmFrame  lFrame;
+///
+///   if ( LeddarShmLatest( lShm, &lFrame ) == LEDDAR_SHM_OK ) ...
+///
+/// Link with leddartech_shm (no ROS dependency).
+// *****************************************************************************
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LEDDAR_SHM_MAGIC        0x48534C44  /* "LDSH" */
+#define LEDDAR_SHM_VERSION      1
+#define LEDDAR_SHM_MAX_SEGMENTS 64
+#define LEDDAR_SHM_MAX_ECHOES   6
+
+/* Results of the read functions. */
+#define LEDDAR_SHM_OK           0
+#define LEDDAR_SHM_NOT_YET      1   /* Not written yet. */
+#define LEDDAR_SHM_OVERWRITTEN  2   /* Lapped by the writer. */
+#define LEDDAR_SHM_BUSY         3   /* Kept being written while read. */
+
+/* Same layout as SegmentFrame, stamps in ns since the epoch. Echoes of a
+   segment at or above mEchoCount are undefined. */
+typedef struct LeddarShmFrame
+{
+    uint64_t mIndex;        /* Frames written before this one, from 0. */
+    int64_t  mStamp;        /* Estimated acquisition time. */
+    int64_t  mArrival;      /* Reception by the driver. */
+    int64_t  mWritten;      /* Write to the ring, CLOCK_REALTIME. */
+    uint32_t mSegmentCount;
+    uint8_t  mEchoCount[ LEDDAR_SHM_MAX_SEGMENTS ];
+    float    mDistance[ LEDDAR_SHM_MAX_ECHOES ][ LEDDAR_SHM_MAX_SEGMENTS ];
+    float    mAmplitude[ LEDDAR_SHM_MAX_ECHOES ][ LEDDAR_SHM_MAX_SEGMENTS ];
+    uint16_t mFlags[ LEDDAR_SHM_MAX_ECHOES ][ LEDDAR_SHM_MAX_SEGMENTS ];
+} LeddarShmFrame;
+
+typedef struct LeddarShmSlot
+{
+    uint32_t       mSequence;   /* Odd while written. */
+    uint32_t       mReserved;
+    LeddarShmFrame mFrame;
+} __attribute__(( aligned( 64 ) )) LeddarShmSlot;
+
+typedef struct LeddarShmHeader
+{
+    uint32_t mMagic;
+    uint32_t mVersion;
+    uint32_t mSlotCount;
+    uint32_t mSlotSize;     /* sizeof( LeddarShmSlot ) of the writer. */
+    uint32_t mSegmentCount;
+    uint32_t mActive;       /* Cleared when the writer closes the ring. */
+    uint64_t mWriterId;     /* Process id of the writer. */
+
+    /* Frames written so far, alone on its cache line. */
+    uint64_t mWritten __attribute__(( aligned( 64 ) ));
+} __attribute__(( aligned( 64 ) )) LeddarShmHeader;
+
+typedef struct LeddarShm LeddarShm;
+
+LeddarShm *LeddarShmOpen( const char *aName );
+void LeddarShmClose( LeddarShm *aShm );
+
+int LeddarShmActive( const LeddarShm *aShm );
+uint32_t LeddarShmSlotCount( const LeddarShm *aShm );
+uint32_t LeddarShmSegmentCount( const LeddarShm *aShm );
+uint64_t LeddarShmWritten( const LeddarShm *aShm );
+
+int LeddarShmRead( const LeddarShm *aShm, uint64_t aIndex, LeddarShmFrame *aFrame );
+int LeddarShmLatest( const LeddarShm *aShm, LeddarShmFrame *aFrame );
+int LeddarShmWait( const LeddarShm *aShm, uint64_t aIndex, LeddarShmFrame *aFrame,
+                   double aTimeout );
+
+#ifdef __cplusplus
+}
+#endif
+
+// End of file LeddarShm.h
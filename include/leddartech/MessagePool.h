@@ -0,0 +1,85 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    MessagePool.h
+///
+/// \brief   Pool of preallocated messages published as shared pointers.
+///
+/// Publishing a shared pointer lets subscribers in the same process (such
+/// as nodelets) receive the message without serialization or copy, but the
+/// message must then never be modified while a subscriber holds it. The
+/// pool hands out a message only once its reference count shows nobody
+/// else holds it, and grows (allocating) only when every message is still
+/// in use.
+// *****************************************************************************
+
+#pragma once
+
+#include <boost/shared_ptr.hpp>
+#include <stddef.h>
+#include <vector>
+
+namespace leddartech
+{
+
+template< typename M >
+class MessagePool
+{
+public:
+    MessagePool( void ) : mNext( 0 ) {}
+
+    // *************************************************************************
+    /// \brief   Drop the messages of the pool and preallocate copies of a
+    ///          new prototype. Messages still held by subscribers are simply
+    ///          released by the pool.
+    ///
+    /// \param   aPrototype  Message with every constant field set and the
+    ///                      arrays sized.
+    /// \param   aCount      Number of messages to preallocate.
+    // *************************************************************************
+    void Reset( const M &aPrototype, size_t aCount )
+    {
+        mMessages.clear();
+        mNext = 0;
+
+        for( size_t i=0; i<aCount; ++i )
+        {
+            mMessages.push_back( boost::shared_ptr<M>( new M( aPrototype ) ) );
+        }
+    }
+
+    // *************************************************************************
+    /// \brief   Get a message nobody else holds, ready to be filled. Only
+    ///          allocates if all messages are still held by subscribers.
+    ///
+    /// \param   aPrototype  Copied to create a new message if needed.
+    // *************************************************************************
+    boost::shared_ptr<M> Acquire( const M &aPrototype )
+    {
+        const size_t lSize = mMessages.size();
+
+        for( size_t i=0; i<lSize; ++i )
+        {
+            boost::shared_ptr<M> &lMessage = mMessages[ ( mNext + i ) % lSize ];
+
+            if ( lMessage.use_count() == 1 )
+            {
+                mNext = ( mNext + i + 1 ) % lSize;
+                return lMessage;
+            }
+        }
+
+        mMessages.push_back( boost::shared_ptr<M>( new M( aPrototype ) ) );
+        return mMessages.back();
+    }
+
+    size_t Size( void ) const { return mMessages.size(); }
+
+private:
+    std::vector< boost::shared_ptr<M> > mMessages;
+    size_t                              mNext;
+};
+
+} // namespace leddartech
+
+// End of file MessagePool.h
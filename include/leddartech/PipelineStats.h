@@ -0,0 +1,76 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    PipelineStats.h
+///
+/// \brief   Per-stage timing of the path from the SDK callback to publish.
+///
+/// Each stage feeds a lock-free histogram from the thread running it, using
+/// the monotonic clock. The diagnostics timer takes the histograms
+/// periodically, so recording stays cheap enough to leave on.
+// *****************************************************************************
+
+#pragma once
+
+#include <time.h>
+
+#include "leddartech/LatencyHistogram.h"
+
+namespace leddartech
+{
+
+enum PipelineStage
+{
+    STAGE_CALLBACK,     ///< SDK data callback, entry to return.
+    STAGE_FETCH,        ///< LeddarGetDetections, within the callback.
+    STAGE_QUEUE,        ///< Waiting in the ring for the publisher thread.
+    STAGE_FILTER,       ///< Temporal filter of the binned frame.
+    STAGE_BUILD,        ///< Binning and filling the messages.
+    STAGE_PUBLISH,      ///< Publishing (or writing to the bag), all outputs.
+    STAGE_TOTAL,        ///< Callback entry to last publish.
+    STAGE_FRAME_GAP,    ///< Between the arrivals of consecutive frames.
+    STAGE_COUNT
+};
+
+static const char *const kStageNames[ STAGE_COUNT ] =
+{
+    "callback", "fetch", "queue", "filter", "build", "publish", "total", "frame gap"
+};
+
+struct PipelineStats
+{
+    // Fine bins for the short stages, coarse ones for the waits.
+    PipelineStats( void )
+    {
+        mStages[STAGE_CALLBACK].SetBinWidth( 1e-6 );
+        mStages[STAGE_FETCH].SetBinWidth( 1e-6 );
+        mStages[STAGE_QUEUE].SetBinWidth( 10e-6 );
+        mStages[STAGE_FILTER].SetBinWidth( 1e-6 );
+        mStages[STAGE_BUILD].SetBinWidth( 1e-6 );
+        mStages[STAGE_PUBLISH].SetBinWidth( 1e-6 );
+        mStages[STAGE_TOTAL].SetBinWidth( 10e-6 );
+        mStages[STAGE_FRAME_GAP].SetBinWidth( 1e-3 );
+    }
+
+    LatencyHistogram mStages[ STAGE_COUNT ];
+};
+
+// *****************************************************************************
+// Function: MonotonicSeconds
+//
+/// \brief   Monotonic clock for measuring durations, unaffected by time
+///          adjustments and simulated time.
+// *****************************************************************************
+
+inline double
+MonotonicSeconds( void )
+{
+    struct timespec lNow;
+
+    clock_gettime( CLOCK_MONOTONIC, &lNow );
+    return lNow.tv_sec + lNow.tv_nsec * 1e-9;
+}
+
+} // namespace leddartech
+
+// End of file PipelineStats.h
@@ -0,0 +1,72 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    PropertyCache.h
+///
+/// \brief   Mirror of the properties of a sensor.
+///
+/// Every LdProperties id is read once when the sensor is connected, then
+/// reads are served from memory from any thread. Writes are applied as one
+/// batch: all properties are set, then the configuration is written once
+/// with Device::WriteConfiguration. If any step fails the configuration is
+/// rolled back with Device::RestoreConfiguration, so the sensor never keeps a
+/// partial batch.
+// *****************************************************************************
+
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "leddartech/LeddarDevice.h"
+
+namespace leddartech
+{
+
+/// One property to set, numeric or text (PID_NAME).
+struct PropertyWrite
+{
+    PropertyWrite( unsigned int aId, unsigned int aIndex, double aValue )
+        : mId( aId ), mIndex( aIndex ), mValue( aValue ), mIsText( false ) {}
+    PropertyWrite( unsigned int aId, unsigned int aIndex, const std::string &aText )
+        : mId( aId ), mIndex( aIndex ), mValue( 0 ), mText( aText ), mIsText( true ) {}
+
+    unsigned int mId;
+    unsigned int mIndex;
+    double       mValue;
+    std::string  mText;
+    bool         mIsText;
+};
+
+class PropertyCache
+{
+public:
+    PropertyCache( void );
+
+    void Load( const Device &aDevice, unsigned int aSegmentCount );
+    void Clear( void );
+
+    bool   Get( unsigned int aId, unsigned int aIndex, double &aValue ) const;
+    double Value( unsigned int aId, unsigned int aIndex, double aDefault ) const;
+    bool   GetText( unsigned int aId, unsigned int aIndex, std::string &aValue ) const;
+
+    Result Write( Device &aDevice, const std::vector<PropertyWrite> &aWrites );
+
+    /// Map key of a property index, ordered by id then index.
+    static uint32_t Key( unsigned int aId, unsigned int aIndex ) { return ( aId << 16 ) | aIndex; }
+
+private:
+
+    mutable std::mutex                 mMutex;
+    unsigned int                       mSegmentCount;
+    std::map<uint32_t, double>         mValues;
+    std::map<uint32_t, std::string>    mTexts;
+};
+
+} // namespace leddartech
+
+// End of file PropertyCache.h
@@ -0,0 +1,77 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    RayTable.h
+///
+/// \brief   Per-segment ray directions, computed once per connection.
+///
+/// The direction of each segment is the center of its angular extent
+/// (PID_SEGMENT_LEFT/RIGHT/TOP/BOTTOM, in degrees). Optionally the rays are
+/// expressed in the global frame of the sensor configuration using
+/// PID_GLOBAL_TRANSFORM (or PID_SENSOR_HEIGHT when no transform is set).
+/// Projecting a frame is then a multiply-add of the distances with the
+/// cached unit vectors, with the kernel of the segment count of the model
+/// (see SensorModel.h).
+// *****************************************************************************
+
+#pragma once
+
+#include <stddef.h>
+
+#include "leddartech/LeddarDevice.h"
+#include "leddartech/SegmentFrame.h"
+#include "leddartech/SensorModel.h"
+
+namespace leddartech
+{
+
+template< unsigned int tSegments > struct ProjectKernel;
+
+class RayTable
+{
+public:
+    RayTable( void );
+
+    void SetUniform( unsigned int aSegmentCount, double aFieldOfView );
+    bool Load( const Device &aDevice, unsigned int aSegmentCount, bool aApplyTransform );
+
+    unsigned int SegmentCount( void ) const { return mSegmentCount; }
+
+    /// \brief   Model matching the geometry, null if none does.
+    const SensorModelInfo *Model( void ) const { return mModel; }
+
+    /// \brief   Nominal range of the model, in m.
+    float RangeMax( void ) const { return mModel != NULL ? mModel->mRangeMax : kDefaultRangeMax; }
+
+    /// \brief   Horizontal angle of the center of a segment, in radians.
+    float Azimuth( unsigned int aSegment ) const { return mAzimuth[ aSegment ]; }
+
+    void Project( const SegmentFrame &aFrame, unsigned int aEcho, float *aOut ) const
+    {
+        mProject( *this, aFrame, aEcho, aOut );
+    }
+
+private:
+    template< unsigned int tSegments > friend struct ProjectKernel;
+
+    typedef void (*ProjectFunction)( const RayTable &, const SegmentFrame &, unsigned int, float * );
+
+    static const float kDefaultRangeMax;
+
+    void ComputeRays( const double aTransform[ 12 ] );
+    void SelectModel( double aFieldOfView );
+
+    unsigned int           mSegmentCount;
+    const SensorModelInfo *mModel;
+    ProjectFunction        mProject;
+    float                  mAzimuth[ LEDDAR_MAX_SEGMENTS ];
+    float                  mElevation[ LEDDAR_MAX_SEGMENTS ];
+    float                  mRayX[ LEDDAR_MAX_SEGMENTS ];
+    float                  mRayY[ LEDDAR_MAX_SEGMENTS ];
+    float                  mRayZ[ LEDDAR_MAX_SEGMENTS ];
+    float                  mOrigin[ 3 ];
+};
+
+} // namespace leddartech
+
+// End of file RayTable.h
@@ -0,0 +1,87 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    RecordFormat.h
+///
+/// \brief   Binary format of the frame records written by FrameRecorder.
+///
+/// A record file is a RecordFileHeader followed by blocks. Each block is a
+/// RecordBlockHeader and the frames it holds, compressed with zlib as a
+/// whole when mCodec is RECORD_CODEC_ZLIB, so a block can be decoded
+/// without the rest of the file. A frame is a RecordFrameHeader and its
+/// mDetectionCount RecordDetection, nearest echo of each segment first.
+/// Everything is little endian, packed.
+// *****************************************************************************
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "leddartech/SegmentFrame.h"
+
+namespace leddartech
+{
+
+static const char     kRecordMagic[4] = { 'L', 'D', 'R', 'C' };
+static const char     kRecordBlockMagic[4] = { 'L', 'D', 'B', 'K' };
+static const uint16_t kRecordVersion = 1;
+
+enum RecordCodec
+{
+    RECORD_CODEC_NONE,
+    RECORD_CODEC_ZLIB
+};
+
+#pragma pack( push, 1 )
+
+struct RecordFileHeader
+{
+    char     mMagic[4];
+    uint16_t mVersion;
+    uint16_t mSegmentCount;
+    uint32_t mReserved;
+};
+
+struct RecordBlockHeader
+{
+    char     mMagic[4];
+    uint32_t mCodec;
+    uint32_t mFrameCount;
+    uint32_t mRawSize;      ///< Size of the frames.
+    uint32_t mStoredSize;   ///< Size following this header.
+};
+
+struct RecordFrameHeader
+{
+    uint32_t mStampSec;     ///< Estimated acquisition time.
+    uint32_t mStampNsec;
+    uint32_t mArrivalSec;   ///< Time at which the callback was called.
+    uint32_t mArrivalNsec;
+    uint32_t mRecordIndex;
+    uint16_t mSegmentCount;
+    uint16_t mDetectionCount;
+};
+
+struct RecordDetection
+{
+    uint8_t  mSegment;
+    uint8_t  mEcho;
+    uint16_t mFlags;
+    float    mDistance;
+    float    mAmplitude;
+};
+
+#pragma pack( pop )
+
+/// Largest encoded frame.
+static const size_t kRecordMaxFrameSize = sizeof( RecordFrameHeader )
+                                          + LEDDAR_MAX_SEGMENTS * LEDDAR_MAX_ECHOES
+                                            * sizeof( RecordDetection );
+
+size_t EncodeFrame( const SegmentFrame &aFrame, uint8_t *aBuffer );
+size_t DecodeFrame( const uint8_t *aBuffer, size_t aSize, SegmentFrame &aFrame );
+
+} // namespace leddartech
+
+// End of file RecordFormat.h
@@ -0,0 +1,94 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    RecordReader.h
+///
+/// \brief   Random access to the frames of a record written by FrameRecorder.
+///
+/// Opening a record only reads its header and first block, so frames are
+/// available right away. A background thread then walks the block headers,
+/// skipping the payloads, and extends the known range as it goes: Read
+/// serves any frame already indexed while the rest of a large (or remote)
+/// file is still being scanned. The last decoded block is kept, so reading
+/// frames in order decompresses each block once.
+// *****************************************************************************
+
+#pragma once
+
+#include <ros/time.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "leddartech/SegmentFrame.h"
+
+namespace leddartech
+{
+
+class RecordReader
+{
+public:
+    RecordReader( void );
+    ~RecordReader( void );
+
+    static bool IsRecord( const std::string &aPath );
+
+    bool Open( const std::string &aPath );
+    void Close( void );
+    void WaitIndexed( void );
+
+    bool IsOpen( void ) const { return mFile != NULL; }
+    unsigned int SegmentCount( void ) const { return mSegmentCount; }
+    uint64_t KnownFrames( void ) const { return mKnownFrames.load(); }
+    bool Indexing( void ) const { return mIndexing.load(); }
+
+    bool Read( uint64_t aIndex, SegmentFrame &aFrame );
+
+    ros::Time FirstStamp( void ) const { return mFirstStamp; }
+    double Rate( void ) const { return mRate; }
+
+private:
+    RecordReader( const RecordReader & );
+    RecordReader &operator=( const RecordReader & );
+
+    struct Block
+    {
+        uint64_t mOffset;       ///< Of the block header in the file.
+        uint64_t mFirstFrame;   ///< Index of its first frame in the record.
+        uint32_t mFrameCount;
+    };
+
+    static bool ReadBlockHeader( FILE *aFile, uint64_t aOffset, uint32_t &aFrameCount,
+                                 uint64_t &aNext );
+    void IndexerThread( FILE *aFile, uint64_t aOffset );
+    bool LoadBlock( size_t aBlock );
+
+    std::string            mPath;
+    FILE                  *mFile;           ///< For Read, the indexer has its own.
+    unsigned int           mSegmentCount;
+    ros::Time              mFirstStamp;
+    double                 mRate;           ///< Estimated from the first block, 0 if unknown.
+
+    // Index, extended by the indexer thread.
+    mutable std::mutex     mMutex;
+    std::vector<Block>     mBlocks;
+    std::atomic<uint64_t>  mKnownFrames;
+    std::atomic<bool>      mIndexing;
+    std::atomic<bool>      mStop;
+    std::thread            mIndexer;
+
+    // Last decoded block, for Read.
+    size_t                 mLoaded;         ///< Index in mBlocks, SIZE_MAX if none.
+    std::vector<uint8_t>   mStored;
+    std::vector<uint8_t>   mRaw;
+    std::vector<uint32_t>  mFrameOffsets;   ///< In mRaw.
+};
+
+} // namespace leddartech
+
+// End of file RecordReader.h
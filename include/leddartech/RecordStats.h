@@ -0,0 +1,85 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    RecordStats.h
+///
+/// \brief   Per-segment statistics over recorded frames.
+///
+/// Counts, per segment, the frames with and without a detection, the
+/// drop-outs (runs of frames without one) and the echoes, and histograms
+/// the distance and amplitude of every echo. Everything is a sum, a count
+/// or a maximum, so the statistics of several records gathered apart (on
+/// several threads) are merged exactly.
+// *****************************************************************************
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "leddartech/SegmentFrame.h"
+
+namespace leddartech
+{
+
+struct StatsSettings
+{
+    StatsSettings( void );
+
+    double mDistanceBin;    ///< m, width of a distance bin.
+    double mMaxDistance;    ///< m, farther echoes go to the last bin.
+    double mAmplitudeBin;   ///< Width of an amplitude bin.
+    double mMaxAmplitude;   ///< Stronger echoes go to the last bin.
+};
+
+struct SegmentStats
+{
+    uint64_t mFrames;           ///< Of the records that have this segment.
+    uint64_t mDetected;         ///< Frames with at least one echo.
+    uint64_t mEchoes;
+    uint64_t mDropouts;         ///< Runs of frames without an echo.
+    uint64_t mLongestDropout;   ///< Frames.
+    double   mSum;              ///< m, of the nearest echo distance.
+    double   mSumSquares;       ///< m^2.
+
+    std::vector<uint64_t> mDistance;    ///< Histogram of every echo.
+    std::vector<uint64_t> mAmplitude;
+};
+
+class RecordStats
+{
+public:
+    RecordStats( void );
+
+    void Reset( const StatsSettings &aSettings );
+
+    void BeginRecord( unsigned int aSegmentCount );
+    void Add( const SegmentFrame &aFrame );
+    void EndRecord( void );
+
+    void Merge( const RecordStats &aOther );
+
+    uint64_t Frames( void ) const { return mFrames; }
+    unsigned int Records( void ) const { return mRecords; }
+    unsigned int SegmentCount( void ) const { return mSegmentCount; }
+    const SegmentStats &Segment( unsigned int aSegment ) const { return mSegments[ aSegment ]; }
+
+    bool WriteSegments( const std::string &aPath ) const;
+    bool WriteHistograms( const std::string &aPath ) const;
+
+private:
+    StatsSettings mSettings;
+    uint64_t      mFrames;
+    unsigned int  mRecords;
+    unsigned int  mSegmentCount;    ///< Largest of the records added.
+    SegmentStats  mSegments[ LEDDAR_MAX_SEGMENTS ];
+
+    // Drop-out in progress in the current record, frames.
+    uint64_t      mRun[ LEDDAR_MAX_SEGMENTS ];
+};
+
+} // namespace leddartech
+
+// End of file RecordStats.h
@@ -0,0 +1,53 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    ScanBatcher.h
+///
+/// \brief   Pack consecutive segment-binned frames into ScanBatch messages.
+///
+/// A batch is complete once it holds the configured number of frames, or
+/// once the last frame added is the maximum latency or more after the
+/// first one. Frames are written straight into a pooled message, as
+/// ScanBuilder does, so batching does not allocate either.
+// *****************************************************************************
+
+#pragma once
+
+#include <leddartech/ScanBatch.h>
+#include <stdint.h>
+#include <string>
+
+#include "leddartech/MessagePool.h"
+#include "leddartech/RayTable.h"
+#include "leddartech/SegmentFrame.h"
+
+namespace leddartech
+{
+
+class ScanBatcher
+{
+public:
+    ScanBatcher( void );
+
+    void Configure( const RayTable &aRays, const std::string &aFrameId, unsigned int aEchoes,
+                    unsigned int aFrames, double aMaxLatency );
+
+    ScanBatch::ConstPtr Add( const SegmentFrame &aFrame );
+    ScanBatch::ConstPtr Flush( void );
+    void Discard( void ) { mCurrent.reset(); }
+
+    bool Enabled( void ) const { return mFrames > 0; }
+
+private:
+    ScanBatch              mBatch;      ///< Prototype, sized for mFrames.
+    MessagePool<ScanBatch> mPool;
+    ScanBatch::Ptr         mCurrent;    ///< Batch being filled.
+    unsigned int           mCount;      ///< Frames in mCurrent.
+    unsigned int           mFrames;     ///< 0 when disabled.
+    double                 mMaxLatency;
+    uint32_t               mSequence;
+};
+
+} // namespace leddartech
+
+// End of file ScanBatcher.h
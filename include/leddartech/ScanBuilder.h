@@ -0,0 +1,65 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    ScanBuilder.h
+///
+/// \brief   Build scan and point cloud messages from segment-binned frames
+///          without allocating.
+///
+/// Configure sets up one prototype of each message, for the segment count
+/// of the connected sensor, and fills a pool with copies of it. Each frame
+/// is then written into a pooled message nobody holds anymore, which is
+/// returned as a shared pointer so it can be published without copy to
+/// subscribers in the same process.
+// *****************************************************************************
+
+#pragma once
+
+#include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/MultiEchoLaserScan.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <stdint.h>
+#include <string>
+
+#include "leddartech/MessagePool.h"
+#include "leddartech/RayTable.h"
+#include "leddartech/SegmentFrame.h"
+
+namespace leddartech
+{
+
+class ScanBuilder
+{
+public:
+    ScanBuilder( void );
+
+    void Configure( const RayTable &aRays, const std::string &aFrameId,
+                    const std::string &aCloudFrameId, unsigned int aCloudEchoes );
+
+    sensor_msgs::LaserScan::ConstPtr Build( const SegmentFrame &aFrame, uint32_t aSequence );
+    sensor_msgs::MultiEchoLaserScan::ConstPtr BuildMultiEcho( const SegmentFrame &aFrame,
+                                                              uint32_t aSequence );
+    sensor_msgs::PointCloud2::ConstPtr BuildCloud( const SegmentFrame &aFrame,
+                                                   uint32_t aSequence );
+
+    unsigned int SegmentCount( void ) const { return mScan.ranges.size(); }
+
+private:
+    RayTable                        mRays;
+
+    /// Fills a single echo scan, for the segment count.
+    void                          (*mFillScan)( const SegmentFrame &, sensor_msgs::LaserScan & );
+
+    // Prototypes with the constant fields set and the arrays sized.
+    sensor_msgs::LaserScan          mScan;
+    sensor_msgs::MultiEchoLaserScan mMultiEchoScan;
+    sensor_msgs::PointCloud2        mCloud;
+
+    MessagePool<sensor_msgs::LaserScan>          mScanPool;
+    MessagePool<sensor_msgs::MultiEchoLaserScan> mMultiEchoPool;
+    MessagePool<sensor_msgs::PointCloud2>        mCloudPool;
+};
+
+} // namespace leddartech
+
+// End of file ScanBuilder.h
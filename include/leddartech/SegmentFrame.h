@@ -0,0 +1,45 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    SegmentFrame.h
+///
+/// \brief   Detections of a frame binned by segment.
+///
+/// Echoes are stored structure-of-arrays, echo-major: mDistance[e][s] is the
+/// e-th nearest echo of segment s. Row 0 therefore holds the first echo of
+/// every segment contiguously. Entries at or above mEchoCount[s] are
+/// undefined.
+// *****************************************************************************
+
+#pragma once
+
+#include <ros/time.h>
+#include <stddef.h>
+
+#include "LeddarC.h"
+#include "leddartech/LeddarFrame.h"
+
+namespace leddartech
+{
+
+/// Bit set in LdDetection::mFlags for a valid detection.
+#define LEDDAR_FLAG_VALID 0x0001
+
+struct SegmentFrame
+{
+    ros::Time     mArrival;     ///< Time at which the callback was called.
+    ros::Time     mStamp;       ///< Estimated acquisition time.
+    size_t        mRecordIndex;
+    unsigned int  mSegmentCount;
+    unsigned char mEchoCount[ LEDDAR_MAX_SEGMENTS ];
+    float         mDistance[ LEDDAR_MAX_ECHOES ][ LEDDAR_MAX_SEGMENTS ];
+    float         mAmplitude[ LEDDAR_MAX_ECHOES ][ LEDDAR_MAX_SEGMENTS ];
+    LeddarU16     mFlags[ LEDDAR_MAX_ECHOES ][ LEDDAR_MAX_SEGMENTS ];
+};
+
+void BinDetections( const LeddarFrame &aFrame, unsigned int aSegmentCount,
+                    SegmentFrame &aBinned, float aMinAmplitude = 0 );
+
+} // namespace leddartech
+
+// End of file SegmentFrame.h
@@ -0,0 +1,172 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    SensorModel.h
+///
+/// \brief   Compile-time descriptors of the supported Leddar sensor models.
+///
+/// A model is its segment count, its horizontal field of view and its
+/// nominal range, as template arguments. The azimuth of the center of each
+/// segment and its sine and cosine are computed by the compiler into
+/// constant tables. The connected sensor is matched to a model from its
+/// segment count and the field of view spanned by PID_SEGMENT_LEFT/RIGHT.
+///
+/// The per-frame kernels (binning, scans, projection) are templates on the
+/// segment count, instantiated for the count of every model. SelectKernel
+/// picks the instantiation once the count is known; other counts get the
+/// instantiation for 0, which reads the count at run time.
+// *****************************************************************************
+
+#pragma once
+
+#include <stddef.h>
+
+#include "leddartech/SegmentFrame.h"
+
+namespace leddartech
+{
+
+namespace detail
+{
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Taylor series, enough terms for |x| <= pi to float precision.
+constexpr double
+SineTerms( double aX2, double aTerm, unsigned int aN )
+{
+    return ( aN > 12 ) ? 0
+                       : aTerm + SineTerms( aX2, -aTerm * aX2 / ( ( 2*aN ) * ( 2*aN + 1 ) ), aN + 1 );
+}
+
+constexpr double
+CosineTerms( double aX2, double aTerm, unsigned int aN )
+{
+    return ( aN > 12 ) ? 0
+                       : aTerm + CosineTerms( aX2, -aTerm * aX2 / ( ( 2*aN - 1 ) * ( 2*aN ) ), aN + 1 );
+}
+
+constexpr double Sine( double aX ) { return SineTerms( aX * aX, aX, 1 ); }
+constexpr double Cosine( double aX ) { return CosineTerms( aX * aX, 1, 1 ); }
+
+template< unsigned int... tIndices >
+struct IndexSequence
+{
+};
+
+template< unsigned int tCount, unsigned int... tIndices >
+struct MakeIndexSequence : MakeIndexSequence< tCount - 1, tCount - 1, tIndices... >
+{
+};
+
+template< unsigned int... tIndices >
+struct MakeIndexSequence< 0, tIndices... >
+{
+    typedef IndexSequence< tIndices... > Type;
+};
+
+} // namespace detail
+
+// *****************************************************************************
+// Class: SensorModel
+//
+/// \brief   Descriptor of a model, segments spread evenly over the field of
+///          view, segment 0 on the right like the sensors report them.
+///
+/// \param   tSegmentCount  Number of segments.
+/// \param   tFieldOfView   Horizontal field of view, hundredths of a degree.
+/// \param   tRangeMax      Nominal range, cm.
+// *****************************************************************************
+
+template< unsigned int tSegmentCount, unsigned int tFieldOfView, unsigned int tRangeMax >
+struct SensorModel
+{
+    static_assert( ( tSegmentCount > 0 ) && ( tSegmentCount <= LEDDAR_MAX_SEGMENTS ),
+                   "Unsupported segment count" );
+
+    static constexpr unsigned int kSegmentCount = tSegmentCount;
+    static constexpr double       kFieldOfView = tFieldOfView / 100.0;     ///< Degrees.
+    static constexpr double       kRangeMax = tRangeMax / 100.0;           ///< m.
+
+    /// \brief   Azimuth of the center of a segment, in radians.
+    static constexpr double Azimuth( unsigned int aSegment )
+    {
+        return ( -kFieldOfView / 2 + ( aSegment + 0.5 ) * kFieldOfView / tSegmentCount )
+               * detail::kPi / 180;
+    }
+};
+
+/// Angles of the segments of a model, computed at compile time.
+template< class tModel,
+          class tIndices = typename detail::MakeIndexSequence< tModel::kSegmentCount >::Type >
+struct AngleTable;
+
+template< class tModel, unsigned int... tIndices >
+struct AngleTable< tModel, detail::IndexSequence< tIndices... > >
+{
+    static constexpr float kAzimuth[ tModel::kSegmentCount ] = { float( tModel::Azimuth( tIndices ) )... };
+    static constexpr float kCos[ tModel::kSegmentCount ] = { float( detail::Cosine( tModel::Azimuth( tIndices ) ) )... };
+    static constexpr float kSin[ tModel::kSegmentCount ] = { float( detail::Sine( tModel::Azimuth( tIndices ) ) )... };
+};
+
+template< class tModel, unsigned int... tIndices >
+constexpr float AngleTable< tModel, detail::IndexSequence< tIndices... > >::kAzimuth[ tModel::kSegmentCount ];
+template< class tModel, unsigned int... tIndices >
+constexpr float AngleTable< tModel, detail::IndexSequence< tIndices... > >::kCos[ tModel::kSegmentCount ];
+template< class tModel, unsigned int... tIndices >
+constexpr float AngleTable< tModel, detail::IndexSequence< tIndices... > >::kSin[ tModel::kSegmentCount ];
+
+// Supported models. A model with a new segment count needs its case in
+// SelectKernel too.
+typedef SensorModel< 16, 4500, 5000 > LeddarEvaluationKit;
+typedef SensorModel< 16, 4800, 5000 > LeddarM16;
+typedef SensorModel<  8, 4800, 5000 > LeddarVu8;
+typedef SensorModel<  1,  300, 4000 > LeddarOne;
+
+/// Run-time view of a model, for the selection and the messages.
+struct SensorModelInfo
+{
+    const char  *mName;
+    unsigned int mSegmentCount;
+    double       mFieldOfView;      ///< Degrees.
+    double       mRangeMax;         ///< m.
+    const float *mAzimuth;          ///< Radians, one per segment.
+    const float *mCos;
+    const float *mSin;
+};
+
+template< class tModel >
+constexpr SensorModelInfo
+MakeModelInfo( const char *aName )
+{
+    return SensorModelInfo{ aName, tModel::kSegmentCount, tModel::kFieldOfView, tModel::kRangeMax,
+                            AngleTable< tModel >::kAzimuth, AngleTable< tModel >::kCos,
+                            AngleTable< tModel >::kSin };
+}
+
+const SensorModelInfo *FindSensorModel( unsigned int aSegmentCount, double aFieldOfView );
+const SensorModelInfo *DefaultSensorModel( unsigned int aSegmentCount );
+
+// *****************************************************************************
+// Function: SelectKernel
+//
+/// \brief   Instantiation of a kernel for a segment count: tKernel<N>::Run
+///          for the count of a model, tKernel<0>::Run otherwise.
+// *****************************************************************************
+
+template< template< unsigned int > class tKernel >
+inline typename tKernel< 0 >::Function
+SelectKernel( unsigned int aSegmentCount )
+{
+    switch( aSegmentCount )
+    {
+        case LeddarOne::kSegmentCount:           return &tKernel< LeddarOne::kSegmentCount >::Run;
+        case LeddarVu8::kSegmentCount:           return &tKernel< LeddarVu8::kSegmentCount >::Run;
+        case LeddarEvaluationKit::kSegmentCount: return &tKernel< LeddarEvaluationKit::kSegmentCount >::Run;
+        default:                                 return &tKernel< 0 >::Run;
+    }
+}
+
+} // namespace leddartech
+
+// End of file SensorModel.h
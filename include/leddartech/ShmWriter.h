@@ -0,0 +1,54 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    ShmWriter.h
+///
+/// \brief   Writer of the shared-memory frame ring (see LeddarShm.h).
+///
+/// The ring is created when opened and unlinked when closed. Readers that
+/// still have it mapped keep it and see it inactive. A driver restarted
+/// under the same name creates a new ring. Writing a frame is a copy into
+/// the next slot between two sequence increments; it never waits.
+// *****************************************************************************
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "leddartech/LeddarShm.h"
+#include "leddartech/SegmentFrame.h"
+
+namespace leddartech
+{
+
+class ShmWriter
+{
+public:
+    ShmWriter( void );
+    ~ShmWriter( void );
+
+    bool Open( const std::string &aName, unsigned int aSlotCount, unsigned int aSegmentCount );
+    void Write( const SegmentFrame &aFrame );
+    void Close( void );
+
+    bool Active( void ) const { return mHeader != NULL; }
+    const std::string &Name( void ) const { return mName; }
+    uint64_t Written( void ) const { return mWritten; }
+
+private:
+    ShmWriter( const ShmWriter & );
+    ShmWriter &operator=( const ShmWriter & );
+
+    std::string      mName;
+    LeddarShmHeader *mHeader;
+    LeddarShmSlot   *mSlots;
+    size_t           mSize;
+    uint64_t         mWritten;  ///< Only changed by the writer, mirrors the header.
+};
+
+} // namespace leddartech
+
+// End of file ShmWriter.h
@@ -0,0 +1,129 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    SpscRing.h
+///
+/// \brief   Bounded lock-free single producer / single consumer ring buffer.
+///
+/// The producer reserves a slot with BeginPush, fills it in place and makes
+/// it visible with EndPush. The consumer reads the oldest slot with Front and
+/// releases it with Pop. When the ring is full the new element is dropped
+/// and counted, the producer never waits for the consumer.
+// *****************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace leddartech
+{
+
+template< typename T >
+class SpscRing
+{
+public:
+    // *************************************************************************
+    /// \brief   Construct the ring.
+    ///
+    /// \param   aCapacity  Minimum number of elements, rounded up to a power
+    ///                     of 2. All elements are allocated here.
+    // *************************************************************************
+    explicit SpscRing( size_t aCapacity )
+        : mHead( 0 ), mTail( 0 ), mPushed( 0 ), mDropped( 0 )
+    {
+        size_t lCapacity = 2;
+
+        while( lCapacity < aCapacity )
+        {
+            lCapacity <<= 1;
+        }
+
+        mSlots.resize( lCapacity );
+        mMask = lCapacity - 1;
+    }
+
+    size_t Capacity( void ) const { return mSlots.size(); }
+
+    // *************************************************************************
+    /// \brief   Producer side: reserve the next free slot.
+    ///
+    /// \return  The slot to fill, or NULL if the ring is full (the drop is
+    ///          counted).
+    // *************************************************************************
+    T *BeginPush( void )
+    {
+        const size_t lHead = mHead.load( std::memory_order_relaxed );
+
+        if ( lHead - mTail.load( std::memory_order_acquire ) >= mSlots.size() )
+        {
+            mDropped.fetch_add( 1, std::memory_order_relaxed );
+            return NULL;
+        }
+
+        return &mSlots[ lHead & mMask ];
+    }
+
+    /// \brief   Producer side: true if the next push would be dropped. Lets
+    ///          a producer that can wait (replay) throttle itself instead.
+    bool Full( void ) const
+    {
+        return mHead.load( std::memory_order_relaxed ) - mTail.load( std::memory_order_acquire )
+               >= mSlots.size();
+    }
+
+    /// \brief   Producer side: publish the slot returned by BeginPush.
+    void EndPush( void )
+    {
+        mHead.store( mHead.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+        mPushed.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    /// \brief   Consumer side: oldest element, or NULL if the ring is empty.
+    T *Front( void )
+    {
+        const size_t lTail = mTail.load( std::memory_order_relaxed );
+
+        if ( lTail == mHead.load( std::memory_order_acquire ) )
+        {
+            return NULL;
+        }
+
+        return &mSlots[ lTail & mMask ];
+    }
+
+    /// \brief   Consumer side: release the element returned by Front.
+    void Pop( void )
+    {
+        mTail.store( mTail.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+    }
+
+    /// \brief   Number of elements successfully pushed since construction.
+    uint64_t Pushed( void ) const { return mPushed.load( std::memory_order_relaxed ); }
+
+    /// \brief   Number of elements dropped because the ring was full.
+    uint64_t Dropped( void ) const { return mDropped.load( std::memory_order_relaxed ); }
+
+private:
+    SpscRing( const SpscRing & );
+    SpscRing &operator=( const SpscRing & );
+
+    // Head and tail are written by different threads, pad them to separate
+    // cache lines to avoid false sharing. Padding is used instead of alignas
+    // since over-aligned new is not available before C++17.
+    char                  mPad0[ 64 ];
+    std::atomic<size_t>   mHead;
+    char                  mPad1[ 64 - sizeof( std::atomic<size_t> ) ];
+    std::atomic<size_t>   mTail;
+    char                  mPad2[ 64 - sizeof( std::atomic<size_t> ) ];
+    std::atomic<uint64_t> mPushed;
+    std::atomic<uint64_t> mDropped;
+    std::vector<T>        mSlots;
+    size_t                mMask;
+};
+
+} // namespace leddartech
+
+// End of file SpscRing.h
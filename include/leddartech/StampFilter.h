@@ -0,0 +1,49 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    StampFilter.h
+///
+/// \brief   Estimate acquisition times from callback arrival times.
+///
+/// Frames are acquired at a fixed period but reach the callback after a
+/// variable, always positive, delivery delay. The filter tracks the lower
+/// envelope of the arrival times with a line of slope equal to the
+/// estimated period: arrivals earlier than predicted pull the line down
+/// quickly, later ones only nudge it up. The resulting stamps are free of
+/// scheduler jitter; a constant delivery latency can be removed with
+/// SetLatencyOffset.
+// *****************************************************************************
+
+#pragma once
+
+#include <ros/time.h>
+
+namespace leddartech
+{
+
+class StampFilter
+{
+public:
+    StampFilter( void );
+
+    void Reset( double aNominalPeriod );
+    void SetLatencyOffset( double aOffset ) { mLatencyOffset = aOffset; }
+
+    ros::Time Update( const ros::Time &aArrival );
+
+    double Period( void ) const { return mPeriod; }
+
+private:
+    double mNominalPeriod;
+    double mPeriod;
+    double mLatencyOffset;
+    double mFirst;
+    double mFrames;
+    double mLastArrival;
+    double mLast;
+    bool   mInitialized;
+};
+
+} // namespace leddartech
+
+// End of file StampFilter.h
@@ -0,0 +1,82 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    TemporalFilter.h
+///
+/// \brief   Per-segment smoothing of the nearest echo over time.
+///
+/// Runs on the segment-binned frame before the messages are built, so every
+/// output (scan, multi echo scan first echo, cloud first row) is filtered
+/// once. The state of every segment is kept structure-of-arrays like the
+/// frame itself, so each kernel processes 4 segments per SSE instruction and
+/// a 16 segment frame in a handful of iterations.
+///
+/// The state follows the nearest echo of each frame. When the filtered value
+/// goes past the next echo of its segment, the echoes are sorted again so
+/// they stay nearest first.
+///
+/// Segments without a detection keep their state (and report no detection);
+/// after a few missing frames the state is restarted from the next
+/// detection. Low amplitude detections are rejected earlier, by
+/// BinDetections.
+// *****************************************************************************
+
+#pragma once
+
+#include <string>
+
+#include "leddartech/SegmentFrame.h"
+
+namespace leddartech
+{
+
+class TemporalFilter
+{
+public:
+    enum Mode
+    {
+        FILTER_NONE,
+        FILTER_MEDIAN,          ///< Median of the last 3 or 5 detections.
+        FILTER_EXPONENTIAL,     ///< Exponential moving average.
+        FILTER_KALMAN           ///< Constant velocity Kalman filter.
+    };
+
+    static const unsigned int kMaxWindow = 5;
+
+    TemporalFilter( void );
+
+    static bool ParseMode( const std::string &aName, Mode &aMode );
+
+    void Configure( Mode aMode, unsigned int aWindow, float aAlpha, float aProcessNoise,
+                    float aMeasurementNoise, double aPeriod );
+    void Reset( void );
+    void Apply( SegmentFrame &aFrame );
+
+    Mode GetMode( void ) const { return mMode; }
+
+private:
+    void ApplyMedian( SegmentFrame &aFrame );
+    void ApplyExponential( SegmentFrame &aFrame );
+    void ApplyKalman( SegmentFrame &aFrame );
+
+    Mode         mMode;
+    unsigned int mWindow;
+    float        mAlpha;
+    float        mProcessNoise;         ///< Acceleration variance, (m/s^2)^2.
+    float        mMeasurementNoise;     ///< Distance variance, m^2.
+    float        mPeriod;
+
+    // Per-segment state.
+    float        mMissed[ LEDDAR_MAX_SEGMENTS ];    ///< Frames since the last detection.
+    float        mValue[ LEDDAR_MAX_SEGMENTS ];     ///< Average or Kalman distance.
+    float        mVelocity[ LEDDAR_MAX_SEGMENTS ];
+    float        mP00[ LEDDAR_MAX_SEGMENTS ];       ///< Kalman covariance.
+    float        mP01[ LEDDAR_MAX_SEGMENTS ];
+    float        mP11[ LEDDAR_MAX_SEGMENTS ];
+    float        mHistory[ kMaxWindow ][ LEDDAR_MAX_SEGMENTS ];
+    unsigned int mHistoryIndex;
+};
+
+} // namespace leddartech
+
+// End of file TemporalFilter.h
@@ -0,0 +1,79 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    ZoneMonitor.h
+///
+/// \brief   Zone intrusion detection on the segment-binned frames.
+///
+/// A zone is a distance interval over a set of segments, with the semantics
+/// of the detection zone of the sensor (PID_ZONE_NEAR_LIMIT, FAR_LIMIT,
+/// SEGMENT_ENABLED, RISING_DEBOUNCE and FALLING_DEBOUNCE): it is occupied
+/// once a detection has been in it for the rising debounce in consecutive
+/// frames, and clear again once it has been empty for the falling debounce.
+/// Only the confirmed changes are reported, so consumers that need the
+/// occupancy do not have to process every scan.
+// *****************************************************************************
+
+#pragma once
+
+#include <ros/ros.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "leddartech/PropertyCache.h"
+#include "leddartech/SegmentFrame.h"
+
+namespace leddartech
+{
+
+struct ZoneSettings
+{
+    ZoneSettings( void );
+
+    std::string  mName;
+    float        mNearLimit;        ///< m, detections nearer are outside.
+    float        mFarLimit;         ///< m, detections at or beyond are outside.
+    uint64_t     mSegments;         ///< Bit s set when segment s is monitored.
+    unsigned int mRisingDebounce;   ///< Frames with a detection to become occupied.
+    unsigned int mFallingDebounce;  ///< Frames without one to become clear.
+};
+
+/// A confirmed change of a zone.
+struct ZoneTransition
+{
+    unsigned int mZone;             ///< Index in the configuration.
+    bool         mEnter;
+    unsigned int mSegment;          ///< Nearest detection in the zone, on enter.
+    float        mDistance;
+};
+
+class ZoneMonitor
+{
+public:
+    /// Occupancy is reported as a 32 bit mask.
+    static const unsigned int kMaxZones = 32;
+
+    ZoneMonitor( void );
+
+    static void ReadZones( const ros::NodeHandle &aPrivate, std::vector<ZoneSettings> &aZones );
+    static bool ReadSensorZone( const PropertyCache &aProperties, unsigned int aSegmentCount,
+                                ZoneSettings &aZone );
+
+    void Configure( const std::vector<ZoneSettings> &aZones );
+    unsigned int Update( const SegmentFrame &aFrame, ZoneTransition aTransitions[ kMaxZones ] );
+
+    const ZoneSettings &Zone( unsigned int aIndex ) const { return mZones[ aIndex ]; }
+    unsigned int ZoneCount( void ) const { return mZones.size(); }
+    uint32_t Occupied( void ) const { return mOccupied; }
+
+private:
+    std::vector<ZoneSettings> mZones;
+    std::vector<unsigned int> mPending;     ///< Consecutive frames contradicting the state.
+    uint32_t                  mOccupied;
+};
+
+} // namespace leddartech
+
+// End of file ZoneMonitor.h
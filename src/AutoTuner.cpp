@@ -0,0 +1,383 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    AutoTuner.cpp
+///
+/// \brief   Search of the acquisition settings for a rate/noise target.
+// *****************************************************************************
+
+#include "leddartech/AutoTuner.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "LeddarProperties.h"
+
+namespace leddartech
+{
+
+#define ARRAY_LEN( a )  (sizeof(a)/sizeof(a[0]))
+
+// The measured rate jitters around the nominal one.
+static const double kRateTolerance = 0.95;
+
+AutoTuneSettings::AutoTuneSettings( void )
+    : mTargetRate( 0 ),
+      mLatencyBudget( 0 ),
+      mSettleTime( 1.0 ),
+      mMeasureFrames( 50 ),
+      mMinDetections( 0.9 ),
+      mReport( "leddar_autotune.csv" ),
+      mAtStart( false )
+{
+}
+
+AutoTuner::AutoTuner( void )
+    : mActive( false ),
+      mFrames( 0 ),
+      mMinDetections( 0 ),
+      mFirst( 0 ),
+      mLast( 0 ),
+      mSegmentCount( 0 )
+{
+}
+
+// *****************************************************************************
+// Function: AutoTuner::ReadSettings
+//
+/// \brief   Read the autotune/ parameters of a namespace, settings without a
+///          parameter keep their value.
+// *****************************************************************************
+
+void
+AutoTuner::ReadSettings( const ros::NodeHandle &aPrivate, AutoTuneSettings &aSettings )
+{
+    const ros::NodeHandle lNode( aPrivate, "autotune" );
+
+    lNode.param( "target_rate", aSettings.mTargetRate, aSettings.mTargetRate );
+    lNode.param( "latency_budget", aSettings.mLatencyBudget, aSettings.mLatencyBudget );
+    lNode.getParam( "measurement_rates", aSettings.mRates );
+    lNode.getParam( "oversampling_exponents", aSettings.mOversampling );
+    lNode.getParam( "accumulation_exponents", aSettings.mAccumulation );
+    lNode.getParam( "base_point_counts", aSettings.mBasePoints );
+    lNode.getParam( "led_intensities", aSettings.mLedIntensities );
+    lNode.param( "settle_time", aSettings.mSettleTime, aSettings.mSettleTime );
+    lNode.param( "measure_frames", aSettings.mMeasureFrames, aSettings.mMeasureFrames );
+    lNode.param( "min_detections", aSettings.mMinDetections, aSettings.mMinDetections );
+    lNode.param( "report", aSettings.mReport, aSettings.mReport );
+    lNode.param( "at_start", aSettings.mAtStart, aSettings.mAtStart );
+}
+
+/// \brief   The values to try, the current one if none is given.
+static std::vector<double>
+Values( const std::vector<double> &aValues, const PropertyCache &aProperties, unsigned int aId )
+{
+    return aValues.empty() ? std::vector<double>( 1, aProperties.Value( aId, 0, 0 ) ) : aValues;
+}
+
+// *****************************************************************************
+// Function: AutoTuner::Candidates
+//
+/// \brief   Every combination of the values to try. Rates that cannot meet
+///          the target are left out.
+///
+/// \param   aSettings     Values to try and target.
+/// \param   aProperties   Current properties, for the values not swept.
+/// \param   aCandidates   Receives the combinations, not yet measured.
+// *****************************************************************************
+
+void
+AutoTuner::Candidates( const AutoTuneSettings &aSettings, const PropertyCache &aProperties,
+                       std::vector<TuneCandidate> &aCandidates ) const
+{
+    const double              lTarget = TargetRate( aSettings,
+                                                    aProperties.Value( PID_MEASUREMENT_RATE, 0, 0 ) );
+    const std::vector<double> lRates = Values( aSettings.mRates, aProperties, PID_MEASUREMENT_RATE );
+    const std::vector<double> lOversampling = Values( aSettings.mOversampling, aProperties,
+                                                      PID_OVERSAMPLING_EXPONENT );
+    const std::vector<double> lAccumulation = Values( aSettings.mAccumulation, aProperties,
+                                                      PID_ACCUMULATION_EXPONENT );
+    const std::vector<double> lBasePoints = Values( aSettings.mBasePoints, aProperties,
+                                                    PID_BASE_POINT_COUNT );
+    const std::vector<double> lLeds = Values( aSettings.mLedIntensities, aProperties,
+                                              PID_LED_INTENSITY );
+
+    aCandidates.clear();
+
+    for( size_t r=0; r<lRates.size(); ++r )
+    {
+        if ( lRates[r] < lTarget * kRateTolerance )
+        {
+            continue;
+        }
+
+        for( size_t o=0; o<lOversampling.size(); ++o )
+        {
+            for( size_t a=0; a<lAccumulation.size(); ++a )
+            {
+                for( size_t b=0; b<lBasePoints.size(); ++b )
+                {
+                    for( size_t l=0; l<lLeds.size(); ++l )
+                    {
+                        TuneCandidate lCandidate = TuneCandidate();
+
+                        lCandidate.mRate = lRates[r];
+                        lCandidate.mOversampling = lOversampling[o];
+                        lCandidate.mAccumulation = lAccumulation[a];
+                        lCandidate.mBasePoints = lBasePoints[b];
+                        lCandidate.mLedIntensity = lLeds[l];
+                        lCandidate.mNoise = std::numeric_limits<double>::infinity();
+                        aCandidates.push_back( lCandidate );
+                    }
+                }
+            }
+        }
+    }
+}
+
+// *****************************************************************************
+// Function: AutoTuner::Writes
+//
+/// \brief   The properties to write for a candidate, among those the sensor
+///          has.
+///
+/// \param   aCandidate   Settings to write.
+/// \param   aProperties  Current properties.
+/// \param   aManualLed   Also turn the automatic LED intensity off.
+/// \param   aWrites      Receives the writes.
+// *****************************************************************************
+
+void
+AutoTuner::Writes( const TuneCandidate &aCandidate, const PropertyCache &aProperties,
+                   bool aManualLed, std::vector<PropertyWrite> &aWrites )
+{
+    const unsigned int lIds[] = { PID_MEASUREMENT_RATE, PID_OVERSAMPLING_EXPONENT,
+                                  PID_ACCUMULATION_EXPONENT, PID_BASE_POINT_COUNT,
+                                  PID_LED_INTENSITY };
+    const double       lValues[] = { aCandidate.mRate, aCandidate.mOversampling,
+                                     aCandidate.mAccumulation, aCandidate.mBasePoints,
+                                     aCandidate.mLedIntensity };
+    double             lCurrent;
+
+    aWrites.clear();
+
+    if ( aManualLed && aProperties.Get( PID_AUTOMATIC_LED_INTENSITY, 0, lCurrent ) )
+    {
+        aWrites.push_back( PropertyWrite( PID_AUTOMATIC_LED_INTENSITY, 0, 0 ) );
+    }
+
+    for( size_t i=0; i<ARRAY_LEN( lIds ); ++i )
+    {
+        if ( aProperties.Get( lIds[i], 0, lCurrent ) )
+        {
+            aWrites.push_back( PropertyWrite( lIds[i], 0, lValues[i] ) );
+        }
+    }
+}
+
+// *****************************************************************************
+// Function: AutoTuner::Begin
+//
+/// \brief   Start measuring the frames given to Add.
+///
+/// \param   aMinDetections  Fraction of the frames in which a segment must
+///                          have a detection for its spread to count.
+// *****************************************************************************
+
+void
+AutoTuner::Begin( double aMinDetections )
+{
+    std::lock_guard<std::mutex> lLock( mMutex );
+
+    mMinDetections = aMinDetections;
+    mFirst = 0;
+    mLast = 0;
+    mSegmentCount = 0;
+    mFrames = 0;
+
+    for( unsigned int s=0; s<LEDDAR_MAX_SEGMENTS; ++s )
+    {
+        mCount[s] = 0;
+        mMean[s] = 0;
+        mM2[s] = 0;
+    }
+
+    mActive = true;
+}
+
+// *****************************************************************************
+// Function: AutoTuner::Add
+//
+/// \brief   Accumulate the nearest echo of each segment of a frame. Does
+///          nothing unless measuring, so it can be called for every frame.
+///
+/// \param   aFrame      Segment-binned frame, before the temporal filter.
+/// \param   aMonotonic  Time it was received.
+// *****************************************************************************
+
+void
+AutoTuner::Add( const SegmentFrame &aFrame, double aMonotonic )
+{
+    if ( !mActive.load() )
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lLock( mMutex );
+
+    if ( mFrames.load() == 0 )
+    {
+        mFirst = aMonotonic;
+    }
+
+    mLast = aMonotonic;
+    mSegmentCount = aFrame.mSegmentCount;
+
+    for( unsigned int s=0; s<aFrame.mSegmentCount; ++s )
+    {
+        if ( aFrame.mEchoCount[s] == 0 )
+        {
+            continue;
+        }
+
+        const double lDistance = aFrame.mDistance[0][s];
+        const double lDelta = lDistance - mMean[s];
+
+        ++mCount[s];
+        mMean[s] += lDelta / mCount[s];
+        mM2[s] += lDelta * ( lDistance - mMean[s] );
+    }
+
+    mFrames.fetch_add( 1 );
+}
+
+// *****************************************************************************
+// Function: AutoTuner::End
+//
+/// \brief   Stop measuring and store the results in a candidate.
+// *****************************************************************************
+
+void
+AutoTuner::End( TuneCandidate &aCandidate )
+{
+    mActive = false;
+
+    std::lock_guard<std::mutex> lLock( mMutex );
+
+    const unsigned int lFrames = mFrames.load();
+    double             lSpread = 0;
+    unsigned int       lCounted = 0;
+
+    for( unsigned int s=0; s<mSegmentCount; ++s )
+    {
+        if ( ( mCount[s] > 1 ) && ( mCount[s] >= mMinDetections * lFrames ) )
+        {
+            lSpread += std::sqrt( mM2[s] / ( mCount[s] - 1 ) );
+            ++lCounted;
+        }
+    }
+
+    aCandidate.mFrames = lFrames;
+    aCandidate.mAchievedRate = ( ( lFrames > 1 ) && ( mLast > mFirst ) )
+                               ? ( lFrames - 1 ) / ( mLast - mFirst ) : 0;
+    aCandidate.mNoise = ( lCounted > 0 ) ? lSpread / lCounted
+                                         : std::numeric_limits<double>::infinity();
+    aCandidate.mDetectionRatio = ( mSegmentCount > 0 ) ? double( lCounted ) / mSegmentCount : 0;
+}
+
+/// \brief   The rate to achieve: the larger of the target rate and the
+///          inverse of the latency budget, the current rate if neither is set.
+double
+AutoTuner::TargetRate( const AutoTuneSettings &aSettings, double aCurrentRate )
+{
+    double lTarget = aSettings.mTargetRate;
+
+    if ( aSettings.mLatencyBudget > 0 )
+    {
+        lTarget = std::max( lTarget, 1.0 / aSettings.mLatencyBudget );
+    }
+
+    return ( lTarget > 0 ) ? lTarget : aCurrentRate;
+}
+
+// *****************************************************************************
+// Function: AutoTuner::Select
+//
+/// \brief   The least noisy measured candidate achieving the target rate,
+///          the faster one on a tie.
+///
+/// \return  Its index, -1 if none qualifies.
+// *****************************************************************************
+
+int
+AutoTuner::Select( const std::vector<TuneCandidate> &aCandidates, double aTargetRate )
+{
+    int lBest = -1;
+
+    for( size_t i=0; i<aCandidates.size(); ++i )
+    {
+        const TuneCandidate &lCandidate = aCandidates[i];
+
+        if (    ( lCandidate.mResult != LD_SUCCESS )
+             || ( lCandidate.mAchievedRate < aTargetRate * kRateTolerance )
+             || !std::isfinite( lCandidate.mNoise ) )
+        {
+            continue;
+        }
+
+        if (    ( lBest < 0 )
+             || ( lCandidate.mNoise < aCandidates[lBest].mNoise )
+             || (    ( lCandidate.mNoise == aCandidates[lBest].mNoise )
+                  && ( lCandidate.mAchievedRate > aCandidates[lBest].mAchievedRate ) ) )
+        {
+            lBest = i;
+        }
+    }
+
+    return lBest;
+}
+
+// *****************************************************************************
+// Function: AutoTuner::WriteReport
+//
+/// \brief   Write the tradeoff curve as CSV, one line per candidate.
+///
+/// \return  False if the file could not be written.
+// *****************************************************************************
+
+bool
+AutoTuner::WriteReport( const std::string &aPath, const std::vector<TuneCandidate> &aCandidates,
+                        int aSelected, double aTargetRate )
+{
+    FILE *lFile = fopen( aPath.c_str(), "w" );
+
+    if ( lFile == NULL )
+    {
+        return false;
+    }
+
+    fprintf( lFile, "# target rate %.4f Hz\n", aTargetRate );
+    fprintf( lFile, "measurement_rate,oversampling_exponent,accumulation_exponent,"
+                    "base_point_count,led_intensity,result,frames,achieved_rate,noise,"
+                    "detection_ratio,selected\n" );
+
+    for( size_t i=0; i<aCandidates.size(); ++i )
+    {
+        const TuneCandidate &lCandidate = aCandidates[i];
+
+        fprintf( lFile, "%g,%g,%g,%g,%g,%d,%u,%.4f,%.6f,%.3f,%d\n", lCandidate.mRate,
+                 lCandidate.mOversampling, lCandidate.mAccumulation, lCandidate.mBasePoints,
+                 lCandidate.mLedIntensity, lCandidate.mResult, lCandidate.mFrames,
+                 lCandidate.mAchievedRate, lCandidate.mNoise, lCandidate.mDetectionRatio,
+                 int( i ) == aSelected );
+    }
+
+    return fclose( lFile ) == 0;
+}
+
+} // namespace leddartech
+
+// End of file AutoTuner.cpp
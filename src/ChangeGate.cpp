@@ -0,0 +1,158 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    ChangeGate.cpp
+///
+/// \brief   Decides whether a frame differs enough from the last published
+///          one to be published.
+// *****************************************************************************
+
+#include "leddartech/ChangeGate.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace leddartech
+{
+
+// *****************************************************************************
+// Function: FillDeadbands
+//
+/// \brief   Expand the deadbands given for the first segments to all of
+///          them: missing ones take the last value given. Deadbands of 0 or
+///          less disable the comparison.
+// *****************************************************************************
+
+static void
+FillDeadbands( const std::vector<double> &aValues, float aDeadbands[ LEDDAR_MAX_SEGMENTS ] )
+{
+    for( unsigned int i=0; i<LEDDAR_MAX_SEGMENTS; ++i )
+    {
+        const double lValue = aValues.empty() ? 0 : aValues[ std::min<size_t>( i, aValues.size()-1 ) ];
+
+        aDeadbands[i] = ( lValue > 0 ) ? lValue : std::numeric_limits<float>::infinity();
+    }
+}
+
+ChangeGate::ChangeGate( void )
+    : mEnabled( false ),
+      mHaveReference( false ),
+      mKeepAlivePeriod( 0 )
+{
+    FillDeadbands( std::vector<double>(), mDistanceDeadband );
+    FillDeadbands( std::vector<double>(), mAmplitudeDeadband );
+}
+
+// *****************************************************************************
+// Function: ChangeGate::Configure
+//
+/// \param   aEnabled             Every frame passes when false.
+/// \param   aDistanceDeadbands   Per segment (m), a single value for all.
+/// \param   aAmplitudeDeadbands  Per segment, a single value for all, empty
+///                               or 0 to ignore the amplitude.
+/// \param   aKeepAliveRate       Minimum publishing rate (Hz), 0 for none.
+// *****************************************************************************
+
+void
+ChangeGate::Configure( bool aEnabled, const std::vector<double> &aDistanceDeadbands,
+                       const std::vector<double> &aAmplitudeDeadbands, double aKeepAliveRate )
+{
+    mEnabled = aEnabled;
+    mKeepAlivePeriod = ( aKeepAliveRate > 0 ) ? 1.0 / aKeepAliveRate : 0;
+    FillDeadbands( aDistanceDeadbands, mDistanceDeadband );
+    FillDeadbands( aAmplitudeDeadbands, mAmplitudeDeadband );
+    Reset();
+}
+
+// *****************************************************************************
+// Function: ChangeGate::Check
+//
+/// \brief   Decide on a frame. Frames that are not suppressed become the new
+///          reference.
+///
+/// \param   aFrame  Stamped, segment-binned frame.
+// *****************************************************************************
+
+ChangeGate::Decision
+ChangeGate::Check( const SegmentFrame &aFrame )
+{
+    if ( !mEnabled )
+    {
+        return GATE_CHANGED;
+    }
+
+    Decision lDecision;
+
+    if ( !mHaveReference || Changed( aFrame ) )
+    {
+        lDecision = GATE_CHANGED;
+    }
+    else if (    ( mKeepAlivePeriod > 0 )
+              && ( ( aFrame.mStamp - mReference.mStamp ).toSec() >= mKeepAlivePeriod ) )
+    {
+        lDecision = GATE_KEEP_ALIVE;
+    }
+    else
+    {
+        return GATE_SUPPRESSED;
+    }
+
+    // Only the rows in use are worth copying.
+    unsigned int lEchoes = 0;
+
+    for( unsigned int s=0; s<aFrame.mSegmentCount; ++s )
+    {
+        lEchoes = std::max<unsigned int>( lEchoes, aFrame.mEchoCount[s] );
+    }
+
+    mReference.mStamp = aFrame.mStamp;
+    mReference.mSegmentCount = aFrame.mSegmentCount;
+    memcpy( mReference.mEchoCount, aFrame.mEchoCount, aFrame.mSegmentCount );
+
+    for( unsigned int e=0; e<lEchoes; ++e )
+    {
+        memcpy( mReference.mDistance[e], aFrame.mDistance[e], aFrame.mSegmentCount * sizeof( float ) );
+        memcpy( mReference.mAmplitude[e], aFrame.mAmplitude[e], aFrame.mSegmentCount * sizeof( float ) );
+    }
+
+    mHaveReference = true;
+    return lDecision;
+}
+
+// *****************************************************************************
+// Function: ChangeGate::Changed
+//
+/// \brief   Compare a frame with the reference, stopping at the first
+///          significant difference.
+// *****************************************************************************
+
+bool
+ChangeGate::Changed( const SegmentFrame &aFrame ) const
+{
+    if (    ( aFrame.mSegmentCount != mReference.mSegmentCount )
+         || ( memcmp( aFrame.mEchoCount, mReference.mEchoCount, aFrame.mSegmentCount ) != 0 ) )
+    {
+        return true;
+    }
+
+    for( unsigned int s=0; s<aFrame.mSegmentCount; ++s )
+    {
+        for( unsigned int e=0; e<aFrame.mEchoCount[s]; ++e )
+        {
+            if (    ( fabsf( aFrame.mDistance[e][s] - mReference.mDistance[e][s] ) > mDistanceDeadband[s] )
+                 || ( fabsf( aFrame.mAmplitude[e][s] - mReference.mAmplitude[e][s] ) > mAmplitudeDeadband[s] ) )
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+} // namespace leddartech
+
+// End of file ChangeGate.cpp
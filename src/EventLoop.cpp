@@ -0,0 +1,278 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    EventLoop.cpp
+///
+/// \brief   Wait for any of a set of events without polling.
+// *****************************************************************************
+
+#include "leddartech/EventLoop.h"
+
+#include <errno.h>
+#include <math.h>
+#include <ros/ros.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace leddartech
+{
+
+// epoll data of the eventfd, sources are 1 + their index.
+static const uint32_t kWakeSource = 0;
+
+EventLoop::EventLoop( void )
+    : mEpoll( -1 ),
+      mWake( -1 ),
+      mPending( 0 )
+{
+}
+
+EventLoop::~EventLoop( void )
+{
+    Close();
+}
+
+// *****************************************************************************
+// Function: EventLoop::Open
+//
+/// \brief   Create the epoll instance and the eventfd Post writes to.
+///
+/// \return  False if they could not be created.
+// *****************************************************************************
+
+bool
+EventLoop::Open( void )
+{
+    Close();
+
+    mEpoll = epoll_create1( EPOLL_CLOEXEC );
+    mWake = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+
+    struct epoll_event lEvent;
+
+    lEvent.events = EPOLLIN;
+    lEvent.data.u32 = kWakeSource;
+
+    if (    ( mEpoll < 0 ) || ( mWake < 0 )
+         || ( epoll_ctl( mEpoll, EPOLL_CTL_ADD, mWake, &lEvent ) != 0 ) )
+    {
+        ROS_ERROR( "Failed to create the event loop: %s.", strerror( errno ) );
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void
+EventLoop::Close( void )
+{
+    for( size_t i=0; i<mSources.size(); ++i )
+    {
+        if ( mSources[i].mTimer )
+        {
+            close( mSources[i].mFd );
+        }
+    }
+
+    mSources.clear();
+
+    if ( mWake >= 0 )
+    {
+        close( mWake );
+        mWake = -1;
+    }
+
+    if ( mEpoll >= 0 )
+    {
+        close( mEpoll );
+        mEpoll = -1;
+    }
+}
+
+// *****************************************************************************
+// Function: EventLoop::Watch
+//
+/// \brief   Report aEvents whenever a file descriptor is readable. It stays
+///          readable, and reported, until the user reads it. Only from the
+///          thread calling Wait.
+///
+/// \param   aFd      Descriptor, still owned by the caller.
+/// \param   aEvents  Events it stands for.
+///
+/// \return  False if it cannot be waited on.
+// *****************************************************************************
+
+bool
+EventLoop::Watch( int aFd, uint32_t aEvents )
+{
+    struct epoll_event lEvent;
+
+    lEvent.events = EPOLLIN;
+    lEvent.data.u32 = mSources.size() + 1;
+
+    if ( epoll_ctl( mEpoll, EPOLL_CTL_ADD, aFd, &lEvent ) != 0 )
+    {
+        ROS_ERROR( "Failed to watch descriptor %d: %s.", aFd, strerror( errno ) );
+        return false;
+    }
+
+    const Source lSource = { aFd, aEvents, false };
+
+    mSources.push_back( lSource );
+    return true;
+}
+
+// *****************************************************************************
+// Function: EventLoop::SetTimer
+//
+/// \brief   Report aEvents every aPeriod, starting aPeriod from now. Setting
+///          the same events again restarts the timer. Only from the thread
+///          calling Wait.
+///
+/// \param   aEvents  Events of the timer.
+/// \param   aPeriod  s, 0 to stop it.
+///
+/// \return  False if the timer could not be created.
+// *****************************************************************************
+
+bool
+EventLoop::SetTimer( uint32_t aEvents, double aPeriod )
+{
+    size_t lIndex = 0;
+
+    while( ( lIndex < mSources.size() )
+           && !( mSources[lIndex].mTimer && ( mSources[lIndex].mEvents == aEvents ) ) )
+    {
+        ++lIndex;
+    }
+
+    if ( lIndex == mSources.size() )
+    {
+        if ( aPeriod <= 0 )
+        {
+            return true;
+        }
+
+        const int lFd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+
+        if ( ( lFd < 0 ) || !Watch( lFd, aEvents ) )
+        {
+            ROS_ERROR( "Failed to create a timer: %s.", strerror( errno ) );
+
+            if ( lFd >= 0 )
+            {
+                close( lFd );
+            }
+
+            return false;
+        }
+
+        mSources.back().mTimer = true;
+    }
+
+    struct itimerspec lSpec;
+
+    memset( &lSpec, 0, sizeof( lSpec ) );
+
+    if ( aPeriod > 0 )
+    {
+        lSpec.it_interval.tv_sec = floor( aPeriod );
+        lSpec.it_interval.tv_nsec = ( aPeriod - floor( aPeriod ) ) * 1e9;
+        lSpec.it_value = lSpec.it_interval;
+    }
+
+    return timerfd_settime( mSources[lIndex].mFd, 0, &lSpec, NULL ) == 0;
+}
+
+// *****************************************************************************
+// Function: EventLoop::Post
+//
+/// \brief   Report events from any thread, or from a signal handler. Only
+///          the first post of an event pending writes to the eventfd.
+// *****************************************************************************
+
+void
+EventLoop::Post( uint32_t aEvents )
+{
+    if ( ( mPending.fetch_or( aEvents ) & aEvents ) != aEvents )
+    {
+        const uint64_t lOne = 1;
+
+        // Fails only when the counter would overflow: a wake is pending.
+        const ssize_t lWritten = write( mWake, &lOne, sizeof( lOne ) );
+
+        (void) lWritten;
+    }
+}
+
+// *****************************************************************************
+// Function: EventLoop::Wait
+//
+/// \brief   Sleep until at least one event happens.
+///
+/// \param   aTimeout  s, negative to wait as long as needed.
+///
+/// \return  The events that happened since the previous call, 0 on
+///          timeout.
+// *****************************************************************************
+
+uint32_t
+EventLoop::Wait( double aTimeout )
+{
+    struct epoll_event lReady[ 8 ];
+    uint32_t           lEvents = mPending.exchange( 0 );
+    const int          lTimeout = ( aTimeout < 0 ) ? -1 : int( ceil( aTimeout * 1e3 ) );
+
+    while( lEvents == 0 )
+    {
+        const int lCount = epoll_wait( mEpoll, lReady, 8, lTimeout );
+
+        if ( ( lCount < 0 ) && ( errno != EINTR ) )
+        {
+            ROS_ERROR( "Failed to wait for events: %s.", strerror( errno ) );
+            return 0;
+        }
+
+        for( int i=0; i<lCount; ++i )
+        {
+            uint64_t lValue;
+
+            if ( lReady[i].data.u32 == kWakeSource )
+            {
+                // The posted events are in mPending, the count is not needed.
+                const ssize_t lRead = read( mWake, &lValue, sizeof( lValue ) );
+
+                (void) lRead;
+            }
+            else
+            {
+                const Source &lSource = mSources[ lReady[i].data.u32 - 1 ];
+
+                // A timer is readable until its expirations are read.
+                if ( lSource.mTimer && ( read( lSource.mFd, &lValue, sizeof( lValue ) ) < 0 ) )
+                {
+                    continue;
+                }
+
+                lEvents |= lSource.mEvents;
+            }
+        }
+
+        lEvents |= mPending.exchange( 0 );
+
+        if ( lTimeout >= 0 )
+        {
+            break;
+        }
+    }
+
+    return lEvents;
+}
+
+} // namespace leddartech
+
+// End of file EventLoop.cpp
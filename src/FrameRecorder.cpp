@@ -0,0 +1,407 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    FrameRecorder.cpp
+///
+/// \brief   Record the processed frames to files, off the publisher thread.
+// *****************************************************************************
+
+#include "leddartech/FrameRecorder.h"
+
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+
+#include <algorithm>
+
+#include "leddartech/PipelineStats.h"
+#include "leddartech/RecordFormat.h"
+
+namespace leddartech
+{
+
+RecorderSettings::RecorderSettings( void )
+    : mPrefix( "leddar" ),
+      mCompression( 1 ),
+      mMaxSize( 100 ),
+      mMaxDuration( 0 ),
+      mBufferSize( 256 ),
+      mFlushPeriod( 1.0 )
+{
+}
+
+// *****************************************************************************
+// Function: RecorderSettings::Read
+//
+/// \brief   Read the record/ parameters of a namespace, settings without a
+///          parameter keep their value.
+// *****************************************************************************
+
+void
+RecorderSettings::Read( const ros::NodeHandle &aPrivate, RecorderSettings &aSettings )
+{
+    const ros::NodeHandle lNode( aPrivate, "record" );
+
+    lNode.param( "directory", aSettings.mDirectory, aSettings.mDirectory );
+    lNode.param( "prefix", aSettings.mPrefix, aSettings.mPrefix );
+    lNode.param( "compression", aSettings.mCompression, aSettings.mCompression );
+    lNode.param( "max_size", aSettings.mMaxSize, aSettings.mMaxSize );
+    lNode.param( "max_duration", aSettings.mMaxDuration, aSettings.mMaxDuration );
+    lNode.param( "buffer_size", aSettings.mBufferSize, aSettings.mBufferSize );
+    lNode.param( "flush_period", aSettings.mFlushPeriod, aSettings.mFlushPeriod );
+}
+
+FrameRecorder::FrameRecorder( void )
+    : mSegmentCount( 0 ),
+      mActive( false ),
+      mFill( NULL ),
+      mFull( NULL ),
+      mStop( false ),
+      mFile( NULL ),
+      mFileSize( 0 ),
+      mFileStart( 0 ),
+      mFrames( 0 ),
+      mDropped( 0 ),
+      mRawBytes( 0 ),
+      mStoredBytes( 0 ),
+      mWriteSeconds( 0 ),
+      mFiles( 0 )
+{
+    mHandOffTime.SetBinWidth( 1e-6 );
+}
+
+FrameRecorder::~FrameRecorder( void )
+{
+    Close();
+}
+
+// *****************************************************************************
+// Function: FrameRecorder::Open
+//
+/// \brief   Allocate the buffers, create the first file and start the
+///          writer thread.
+///
+/// \param   aSettings      Where and how to record.
+/// \param   aSegmentCount  Number of segments of the sensor.
+///
+/// \return  False if the file could not be created.
+// *****************************************************************************
+
+bool
+FrameRecorder::Open( const RecorderSettings &aSettings, unsigned int aSegmentCount )
+{
+    Close();
+
+    mSettings = aSettings;
+    mSegmentCount = aSegmentCount;
+
+    // A buffer holds at least one frame.
+    const size_t lSize = std::max<size_t>( aSettings.mBufferSize * 1024, kRecordMaxFrameSize );
+
+    for( unsigned int i=0; i<2; ++i )
+    {
+        mBuffers[i].mData.resize( lSize );
+        mBuffers[i].mSize = 0;
+        mBuffers[i].mFrames = 0;
+        mBuffers[i].mFirst = 0;
+    }
+
+    mCompressed.resize( compressBound( lSize ) );
+    mFill = &mBuffers[0];
+    mFull = NULL;
+    mStop = false;
+
+    if ( !OpenFile() )
+    {
+        return false;
+    }
+
+    mWriter = std::thread( &FrameRecorder::WriterThread, this );
+    mActive = true;
+    return true;
+}
+
+// *****************************************************************************
+// Function: FrameRecorder::Add
+//
+/// \brief   Encode a frame into the fill buffer, handing it to the writer
+///          when full or old enough. Never waits for the writer.
+///
+/// \param   aFrame  Stamped, segment-binned frame.
+// *****************************************************************************
+
+void
+FrameRecorder::Add( const SegmentFrame &aFrame )
+{
+    const double                lStart = MonotonicSeconds();
+    std::lock_guard<std::mutex> lLock( mFillMutex );
+
+    if ( !mActive.load() )
+    {
+        return;
+    }
+
+    if ( ( mFill->mSize + kRecordMaxFrameSize > mFill->mData.size() ) && !HandOff() )
+    {
+        // Both buffers busy, the disk does not keep up.
+        mDropped.fetch_add( 1 );
+        return;
+    }
+
+    if ( mFill->mFrames == 0 )
+    {
+        mFill->mFirst = lStart;
+    }
+
+    mFill->mSize += EncodeFrame( aFrame, &mFill->mData[ mFill->mSize ] );
+    ++mFill->mFrames;
+    mFrames.fetch_add( 1 );
+
+    if ( lStart - mFill->mFirst >= mSettings.mFlushPeriod )
+    {
+        HandOff();
+    }
+
+    mHandOffTime.Add( MonotonicSeconds() - lStart );
+}
+
+// *****************************************************************************
+// Function: FrameRecorder::HandOff
+//
+/// \brief   Give the fill buffer to the writer and fill the other one.
+///          Called with mFillMutex held.
+///
+/// \return  False if the writer still has the other one.
+// *****************************************************************************
+
+bool
+FrameRecorder::HandOff( void )
+{
+    {
+        std::lock_guard<std::mutex> lLock( mMutex );
+
+        if ( mFull != NULL )
+        {
+            return false;
+        }
+
+        mFull = mFill;
+    }
+
+    mWake.notify_one();
+
+    mFill = ( mFill == &mBuffers[0] ) ? &mBuffers[1] : &mBuffers[0];
+    mFill->mSize = 0;
+    mFill->mFrames = 0;
+    return true;
+}
+
+// *****************************************************************************
+// Function: FrameRecorder::Close
+//
+/// \brief   Write the frames still buffered, stop the writer and close the
+///          file. Add is only held up while the fill buffer is taken, not
+///          while the writer catches up.
+// *****************************************************************************
+
+void
+FrameRecorder::Close( void )
+{
+    Buffer *lLast;
+
+    {
+        std::lock_guard<std::mutex> lFillLock( mFillMutex );
+
+        if ( !mActive.exchange( false ) )
+        {
+            return;
+        }
+
+        // Add leaves it alone once inactive.
+        lLast = ( mFill->mFrames > 0 ) ? mFill : NULL;
+    }
+
+    {
+        std::unique_lock<std::mutex> lLock( mMutex );
+
+        // The writer empties mFull before taking the last buffer.
+        mWake.wait( lLock, [this]{ return mFull == NULL; } );
+
+        mFull = lLast;
+        mStop = true;
+    }
+
+    mWake.notify_all();
+    mWriter.join();
+    CloseFile();
+}
+
+std::string
+FrameRecorder::FileName( void ) const
+{
+    std::lock_guard<std::mutex> lLock( mMutex );
+
+    return mFileName;
+}
+
+// *****************************************************************************
+// Function: FrameRecorder::WriterThread
+//
+/// \brief   Write the buffers handed off until stopped.
+// *****************************************************************************
+
+void
+FrameRecorder::WriterThread( void )
+{
+    std::unique_lock<std::mutex> lLock( mMutex );
+
+    for( ;; )
+    {
+        mWake.wait( lLock, [this]{ return ( mFull != NULL ) || mStop; } );
+
+        if ( mFull == NULL )
+        {
+            return;
+        }
+
+        Buffer *lBuffer = mFull;
+
+        lLock.unlock();
+        WriteBlock( *lBuffer );
+        lLock.lock();
+
+        mFull = NULL;
+        mWake.notify_all();
+    }
+}
+
+// *****************************************************************************
+// Function: FrameRecorder::WriteBlock
+//
+/// \brief   Compress a buffer and write it as one block, rotating the file
+///          first if the block would make it too large or it is too old.
+// *****************************************************************************
+
+void
+FrameRecorder::WriteBlock( const Buffer &aBuffer )
+{
+    const double      lStart = MonotonicSeconds();
+    RecordBlockHeader lHeader;
+    const uint8_t    *lData = &aBuffer.mData[0];
+    uLongf            lStoredSize = aBuffer.mSize;
+
+    memcpy( lHeader.mMagic, kRecordBlockMagic, sizeof( lHeader.mMagic ) );
+    lHeader.mCodec = RECORD_CODEC_NONE;
+
+    if ( mSettings.mCompression > 0 )
+    {
+        lStoredSize = mCompressed.size();
+
+        if ( compress2( &mCompressed[0], &lStoredSize, lData, aBuffer.mSize,
+                        std::min( mSettings.mCompression, 9 ) ) == Z_OK )
+        {
+            lHeader.mCodec = RECORD_CODEC_ZLIB;
+            lData = &mCompressed[0];
+        }
+        else
+        {
+            lStoredSize = aBuffer.mSize;
+        }
+    }
+
+    lHeader.mFrameCount = aBuffer.mFrames;
+    lHeader.mRawSize = aBuffer.mSize;
+    lHeader.mStoredSize = lStoredSize;
+
+    const size_t lBlockSize = sizeof( lHeader ) + lStoredSize;
+
+    if (    ( mFile != NULL ) && ( mFileSize > sizeof( RecordFileHeader ) )
+         && (    ( ( mSettings.mMaxSize > 0 ) && ( mFileSize + lBlockSize > mSettings.mMaxSize * 1e6 ) )
+              || ( ( mSettings.mMaxDuration > 0 ) && ( lStart - mFileStart >= mSettings.mMaxDuration ) ) ) )
+    {
+        CloseFile();
+        OpenFile();
+    }
+
+    if ( mFile == NULL )
+    {
+        mDropped.fetch_add( aBuffer.mFrames );
+        return;
+    }
+
+    if (    ( fwrite( &lHeader, sizeof( lHeader ), 1, mFile ) != 1 )
+         || ( fwrite( lData, 1, lStoredSize, mFile ) != lStoredSize ) )
+    {
+        ROS_ERROR_THROTTLE( 10, "Failed to write %s.", mFileName.c_str() );
+        mDropped.fetch_add( aBuffer.mFrames );
+        return;
+    }
+
+    mFileSize += lBlockSize;
+    mRawBytes.fetch_add( aBuffer.mSize );
+    mStoredBytes.fetch_add( lBlockSize );
+    mWriteSeconds = mWriteSeconds.load() + MonotonicSeconds() - lStart;
+}
+
+// *****************************************************************************
+// Function: FrameRecorder::OpenFile
+//
+/// \brief   Create the next file, named after the prefix, the local time and
+///          a sequence number, and write its header.
+// *****************************************************************************
+
+bool
+FrameRecorder::OpenFile( void )
+{
+    const time_t lNow = time( NULL );
+    struct tm    lLocal;
+    char         lName[64];
+
+    localtime_r( &lNow, &lLocal );
+    snprintf( lName, sizeof( lName ), "_%04d%02d%02d_%02d%02d%02d_%03u.ldrec",
+              lLocal.tm_year + 1900, lLocal.tm_mon + 1, lLocal.tm_mday, lLocal.tm_hour,
+              lLocal.tm_min, lLocal.tm_sec, mFiles.load() );
+
+    const std::string lFileName = mSettings.mDirectory + "/" + mSettings.mPrefix + lName;
+
+    {
+        std::lock_guard<std::mutex> lLock( mMutex );
+
+        mFileName = lFileName;
+    }
+
+    mFile = fopen( lFileName.c_str(), "wb" );
+
+    if ( mFile == NULL )
+    {
+        ROS_ERROR( "Failed to create record %s.", lFileName.c_str() );
+        return false;
+    }
+
+    RecordFileHeader lHeader;
+
+    memcpy( lHeader.mMagic, kRecordMagic, sizeof( lHeader.mMagic ) );
+    lHeader.mVersion = kRecordVersion;
+    lHeader.mSegmentCount = mSegmentCount;
+    lHeader.mReserved = 0;
+    fwrite( &lHeader, sizeof( lHeader ), 1, mFile );
+
+    mFileSize = sizeof( lHeader );
+    mFileStart = MonotonicSeconds();
+    mFiles.fetch_add( 1 );
+    return true;
+}
+
+void
+FrameRecorder::CloseFile( void )
+{
+    if ( mFile != NULL )
+    {
+        fclose( mFile );
+        mFile = NULL;
+    }
+}
+
+} // namespace leddartech
+
+// End of file FrameRecorder.cpp
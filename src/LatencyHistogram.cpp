@@ -0,0 +1,171 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    LatencyHistogram.cpp
+///
+/// \brief   Fixed-bin histogram of latencies with percentile queries.
+// *****************************************************************************
+
+#include "leddartech/LatencyHistogram.h"
+
+namespace leddartech
+{
+
+// Min of an empty histogram, so that any sample is smaller.
+static const uint64_t kNoMin = ~static_cast<uint64_t>( 0 );
+
+// *****************************************************************************
+// Function: LatencyHistogram::Clear
+//
+/// \brief   Remove every sample. Samples added concurrently may be lost,
+///          use Take to reset a histogram that is still being written.
+// *****************************************************************************
+
+void
+LatencyHistogram::Clear( void )
+{
+    for( unsigned int i=0; i<kBinCount; ++i )
+    {
+        mBins[i].store( 0, std::memory_order_relaxed );
+    }
+
+    mCount.store( 0, std::memory_order_relaxed );
+    mSum.store( 0, std::memory_order_relaxed );
+    mMin.store( kNoMin, std::memory_order_relaxed );
+    mMax.store( 0, std::memory_order_relaxed );
+}
+
+// *****************************************************************************
+// Function: LatencyHistogram::Add
+//
+/// \brief   Add a sample. Negative values (clock adjustments) count as 0.
+///          Lock-free, may be called from several threads.
+///
+/// \param   aSeconds  Latency in seconds.
+// *****************************************************************************
+
+void
+LatencyHistogram::Add( double aSeconds )
+{
+    if ( aSeconds < 0 )
+    {
+        aSeconds = 0;
+    }
+
+    unsigned int lBin = static_cast<unsigned int>( aSeconds / mBinWidth );
+
+    if ( lBin >= kBinCount )
+    {
+        lBin = kBinCount - 1;
+    }
+
+    const uint64_t lNs = static_cast<uint64_t>( aSeconds * 1e9 );
+
+    mBins[ lBin ].fetch_add( 1, std::memory_order_relaxed );
+    mCount.fetch_add( 1, std::memory_order_relaxed );
+    mSum.fetch_add( lNs, std::memory_order_relaxed );
+
+    // The extremes rarely change, so these loops almost never iterate.
+    uint64_t lMin = mMin.load( std::memory_order_relaxed );
+
+    while( ( lNs < lMin )
+           && !mMin.compare_exchange_weak( lMin, lNs, std::memory_order_relaxed ) )
+    {
+    }
+
+    uint64_t lMax = mMax.load( std::memory_order_relaxed );
+
+    while( ( lNs > lMax )
+           && !mMax.compare_exchange_weak( lMax, lNs, std::memory_order_relaxed ) )
+    {
+    }
+}
+
+// *****************************************************************************
+// Function: LatencyHistogram::Take
+//
+/// \brief   Move the samples (and bin width) of another histogram into this
+///          one, which must not be written concurrently. Each bin of the
+///          source is swapped with zero so no sample added concurrently to
+///          the source is lost or counted twice; the count is the sum of the
+///          bins taken.
+///
+/// \param   aSource  Histogram to take from, left empty.
+// *****************************************************************************
+
+void
+LatencyHistogram::Take( LatencyHistogram &aSource )
+{
+    uint64_t lCount = 0;
+
+    mBinWidth = aSource.mBinWidth;
+
+    for( unsigned int i=0; i<kBinCount; ++i )
+    {
+        const uint32_t lBin = aSource.mBins[i].exchange( 0, std::memory_order_relaxed );
+
+        mBins[i].store( lBin, std::memory_order_relaxed );
+        lCount += lBin;
+    }
+
+    aSource.mCount.store( 0, std::memory_order_relaxed );
+
+    mCount.store( lCount, std::memory_order_relaxed );
+    mSum.store( aSource.mSum.exchange( 0, std::memory_order_relaxed ), std::memory_order_relaxed );
+    mMin.store( aSource.mMin.exchange( kNoMin, std::memory_order_relaxed ),
+                std::memory_order_relaxed );
+    mMax.store( aSource.mMax.exchange( 0, std::memory_order_relaxed ), std::memory_order_relaxed );
+}
+
+double
+LatencyHistogram::Min( void ) const
+{
+    const uint64_t lMin = mMin.load( std::memory_order_relaxed );
+
+    return lMin == kNoMin ? 0 : lMin * 1e-9;
+}
+
+double
+LatencyHistogram::Max( void ) const
+{
+    return mMax.load( std::memory_order_relaxed ) * 1e-9;
+}
+
+double
+LatencyHistogram::Mean( void ) const
+{
+    const uint64_t lCount = Count();
+
+    return lCount ? mSum.load( std::memory_order_relaxed ) * 1e-9 / lCount : 0;
+}
+
+// *****************************************************************************
+// Function: LatencyHistogram::Percentile
+//
+/// \param   aFraction  Percentile as a fraction, 0.5 for the median.
+///
+/// \return  Upper bound of the bin containing the percentile, in seconds.
+// *****************************************************************************
+
+double
+LatencyHistogram::Percentile( double aFraction ) const
+{
+    const uint64_t lTarget = static_cast<uint64_t>( aFraction * Count() );
+    uint64_t       lSum = 0;
+
+    for( unsigned int i=0; i<kBinCount; ++i )
+    {
+        lSum += mBins[i].load( std::memory_order_relaxed );
+
+        if ( lSum > lTarget )
+        {
+            return ( i + 1 ) * mBinWidth;
+        }
+    }
+
+    return Max();
+}
+
+} // namespace leddartech
+
+// End of file LatencyHistogram.cpp
@@ -0,0 +1,394 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    LeddarAnalyze.cpp
+///
+/// \brief   Per-segment statistics over directories of records.
+///
+/// Every LeddarC record (.ltl) and driver record (.ldrec) found under the
+/// paths given, or named directly, is read by a pool of workers, largest
+/// files first. Each worker owns a LeddarC handle and its statistics, so
+/// nothing is shared while reading; the partial statistics are merged at
+/// the end. Writes the detection rates and drop-out map of every segment
+/// to <prefix>_segments.csv and the distance and amplitude histograms to
+/// <prefix>_histograms.csv, and reports the throughput.
+///
+///   rosrun leddartech leddartech_analyze -j 8 -o stats ~/records
+///
+/// No ROS master is needed.
+// *****************************************************************************
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LeddarC.h"
+#include "LeddarProperties.h"
+#include "LeddarResults.h"
+#include "leddartech/LeddarDevice.h"
+#include "leddartech/LeddarFrame.h"
+#include "leddartech/PipelineStats.h"
+#include "leddartech/RecordReader.h"
+#include "leddartech/RecordStats.h"
+#include "leddartech/SegmentFrame.h"
+
+using leddartech::Device;
+using leddartech::LeddarFrame;
+using leddartech::MonotonicSeconds;
+using leddartech::RecordReader;
+using leddartech::RecordStats;
+using leddartech::Result;
+using leddartech::SegmentFrame;
+using leddartech::StatsSettings;
+
+struct RecordFile
+{
+    std::string mPath;
+    off_t       mSize;
+
+    bool operator<( const RecordFile &aOther ) const { return mSize > aOther.mSize; }
+};
+
+struct Worker
+{
+    std::thread  mThread;
+    RecordStats  mStats;
+    uint64_t     mBytes;
+    unsigned int mFailed;
+    double       mBusy;     ///< s, reading records.
+};
+
+// Shared by the workers, set before they start.
+static std::vector<RecordFile> gFiles;
+static std::atomic<size_t>     gNext( 0 );
+static float                   gMinAmplitude = 0;
+
+static bool
+EndsWith( const std::string &aString, const char *aSuffix )
+{
+    const size_t lLength = strlen( aSuffix );
+
+    return ( aString.size() > lLength )
+           && ( aString.compare( aString.size() - lLength, lLength, aSuffix ) == 0 );
+}
+
+// *****************************************************************************
+// Function: FindRecords
+//
+/// \brief   Add a record, or the records found under a directory.
+///
+/// \param   aPath      File or directory.
+/// \param   aExplicit  Named on the command line: added whatever its
+///                     extension.
+// *****************************************************************************
+
+static void
+FindRecords( const std::string &aPath, bool aExplicit )
+{
+    struct stat lStat;
+
+    if ( stat( aPath.c_str(), &lStat ) != 0 )
+    {
+        fprintf( stderr, "Cannot access %s.\n", aPath.c_str() );
+        return;
+    }
+
+    if ( S_ISREG( lStat.st_mode ) )
+    {
+        if ( aExplicit || RecordReader::IsRecord( aPath ) || EndsWith( aPath, ".ltl" ) )
+        {
+            RecordFile lFile = { aPath, lStat.st_size };
+
+            gFiles.push_back( lFile );
+        }
+
+        return;
+    }
+
+    if ( !S_ISDIR( lStat.st_mode ) )
+    {
+        return;
+    }
+
+    DIR *lDirectory = opendir( aPath.c_str() );
+
+    if ( lDirectory == NULL )
+    {
+        fprintf( stderr, "Cannot read %s.\n", aPath.c_str() );
+        return;
+    }
+
+    while( struct dirent *lEntry = readdir( lDirectory ) )
+    {
+        if ( lEntry->d_name[0] != '.' )
+        {
+            FindRecords( aPath + "/" + lEntry->d_name, false );
+        }
+    }
+
+    closedir( lDirectory );
+}
+
+/// \brief   Segment count of the loaded LeddarC record, probed like
+///          LeddarSensor does.
+static unsigned int
+GetSegmentCount( const Device &aDevice )
+{
+    double       lValue;
+    unsigned int lCount = 0;
+
+    while( ( lCount < LEDDAR_MAX_SEGMENTS )
+           && aDevice.Get<PID_SEGMENT_LEFT>( lValue, lCount ).Ok() )
+    {
+        ++lCount;
+    }
+
+    return lCount > 0 ? lCount : 16;
+}
+
+// *****************************************************************************
+// Function: AnalyzeLeddarC
+//
+/// \brief   Step through a LeddarC record, reading the frames as they load.
+///
+/// \return  False if it could not be read to the end.
+// *****************************************************************************
+
+static bool
+AnalyzeLeddarC( Device &aDevice, const std::string &aPath, RecordStats &aStats )
+{
+    if ( !aDevice.LoadRecord( aPath ).Ok() )
+    {
+        return false;
+    }
+
+    LeddarFrame  lFrame;
+    SegmentFrame lBinned;
+    Result       lResult = aDevice.MoveRecordTo( 0 );
+
+    while( ( lResult.Code() == LD_INVALID_ARGUMENT ) && aDevice.RecordLoading() )
+    {
+        ros::WallDuration( 0.001 ).sleep();
+        lResult = aDevice.MoveRecordTo( 0 );
+    }
+
+    // This record's own count: a worker's statistics may hold larger ones.
+    const unsigned int lSegmentCount = GetSegmentCount( aDevice );
+
+    aStats.BeginRecord( lSegmentCount );
+    lFrame.mRecordIndex = 0;
+
+    while( lResult.Ok() )
+    {
+        lFrame.mCount = aDevice.Detections( lFrame.mDetections ).Size();
+        BinDetections( lFrame, lSegmentCount, lBinned, gMinAmplitude );
+        aStats.Add( lBinned );
+
+        lResult = aDevice.StepForward();
+
+        // Caught up with the loader.
+        while( ( lResult.Code() == LD_END_OF_FILE ) && aDevice.RecordLoading() )
+        {
+            ros::WallDuration( 0.001 ).sleep();
+            lResult = aDevice.StepForward();
+        }
+    }
+
+    aStats.EndRecord();
+    aDevice.Disconnect();
+    return lResult.Code() == LD_END_OF_FILE;
+}
+
+// *****************************************************************************
+// Function: AnalyzeRecord
+//
+/// \brief   Read a record written by FrameRecorder, the frames already
+///          indexed while the rest is indexed.
+///
+/// \return  False if it could not be read to the end.
+// *****************************************************************************
+
+static bool
+AnalyzeRecord( RecordReader &aReader, const std::string &aPath, RecordStats &aStats )
+{
+    if ( !aReader.Open( aPath ) )
+    {
+        return false;
+    }
+
+    SegmentFrame lFrame;
+    bool         lResult = true;
+
+    aStats.BeginRecord( aReader.SegmentCount() );
+
+    for( uint64_t i=0; lResult; )
+    {
+        if ( i < aReader.KnownFrames() )
+        {
+            lResult = aReader.Read( i++, lFrame );
+
+            if ( lResult )
+            {
+                aStats.Add( lFrame );
+            }
+        }
+        else if ( aReader.Indexing() )
+        {
+            ros::WallDuration( 0.001 ).sleep();
+        }
+        else if ( i >= aReader.KnownFrames() )
+        {
+            break;
+        }
+    }
+
+    aStats.EndRecord();
+    aReader.Close();
+    return lResult;
+}
+
+static void
+WorkerThread( Worker *aWorker )
+{
+    Device       lDevice;
+    RecordReader lReader;
+
+    for( size_t i=gNext++; i<gFiles.size(); i=gNext++ )
+    {
+        const RecordFile &lFile = gFiles[i];
+        const double      lStart = MonotonicSeconds();
+        const bool        lResult = RecordReader::IsRecord( lFile.mPath )
+                                    ? AnalyzeRecord( lReader, lFile.mPath, aWorker->mStats )
+                                    : AnalyzeLeddarC( lDevice, lFile.mPath, aWorker->mStats );
+
+        aWorker->mBusy += MonotonicSeconds() - lStart;
+        aWorker->mBytes += lFile.mSize;
+
+        if ( !lResult )
+        {
+            fprintf( stderr, "Failed to read %s to the end.\n", lFile.mPath.c_str() );
+            ++aWorker->mFailed;
+        }
+    }
+}
+
+static void
+Usage( const char *aName )
+{
+    fprintf( stderr,
+             "Usage: %s [options] record|directory...\n"
+             "  -j workers     Worker threads (default: one per core).\n"
+             "  -o prefix      Output files prefix (default: leddar_stats).\n"
+             "  -d width       Distance bin width, m (default: 0.1).\n"
+             "  -D max         Distance of the last bin, m (default: 50).\n"
+             "  -a width       Amplitude bin width (default: 1).\n"
+             "  -A max         Amplitude of the last bin (default: 200).\n"
+             "  -m amplitude   Ignore weaker detections (default: 0).\n", aName );
+}
+
+int main( int argc, char **argv )
+{
+    StatsSettings lSettings;
+    unsigned int  lWorkerCount = std::thread::hardware_concurrency();
+    std::string   lPrefix = "leddar_stats";
+    int           lOption;
+
+    while( ( lOption = getopt( argc, argv, "j:o:d:D:a:A:m:h" ) ) != -1 )
+    {
+        switch( lOption )
+        {
+            case 'j': lWorkerCount = atoi( optarg ); break;
+            case 'o': lPrefix = optarg; break;
+            case 'd': lSettings.mDistanceBin = atof( optarg ); break;
+            case 'D': lSettings.mMaxDistance = atof( optarg ); break;
+            case 'a': lSettings.mAmplitudeBin = atof( optarg ); break;
+            case 'A': lSettings.mMaxAmplitude = atof( optarg ); break;
+            case 'm': gMinAmplitude = atof( optarg ); break;
+            default:
+                Usage( argv[0] );
+                return 1;
+        }
+    }
+
+    if ( ( optind == argc ) || ( lSettings.mDistanceBin <= 0 ) || ( lSettings.mAmplitudeBin <= 0 ) )
+    {
+        Usage( argv[0] );
+        return 1;
+    }
+
+    for( int i=optind; i<argc; ++i )
+    {
+        FindRecords( argv[i], true );
+    }
+
+    if ( gFiles.empty() )
+    {
+        fprintf( stderr, "No record found.\n" );
+        return 1;
+    }
+
+    // Largest first, so that the last files handed out are short.
+    std::sort( gFiles.begin(), gFiles.end() );
+    lWorkerCount = std::max( 1u, std::min<unsigned int>( lWorkerCount, gFiles.size() ) );
+
+    std::vector<Worker> lWorkers( lWorkerCount );
+    const double        lStart = MonotonicSeconds();
+
+    for( unsigned int i=0; i<lWorkerCount; ++i )
+    {
+        lWorkers[i].mStats.Reset( lSettings );
+        lWorkers[i].mBytes = 0;
+        lWorkers[i].mFailed = 0;
+        lWorkers[i].mBusy = 0;
+        lWorkers[i].mThread = std::thread( WorkerThread, &lWorkers[i] );
+    }
+
+    RecordStats  lTotal;
+    uint64_t     lBytes = 0;
+    unsigned int lFailed = 0;
+
+    lTotal.Reset( lSettings );
+
+    for( unsigned int i=0; i<lWorkerCount; ++i )
+    {
+        lWorkers[i].mThread.join();
+        lTotal.Merge( lWorkers[i].mStats );
+        lBytes += lWorkers[i].mBytes;
+        lFailed += lWorkers[i].mFailed;
+    }
+
+    const double lElapsed = MonotonicSeconds() - lStart;
+
+    for( unsigned int i=0; i<lWorkerCount; ++i )
+    {
+        printf( "Worker %-2u           : %u records, %llu frames, %.0f frames/s while busy\n", i,
+                lWorkers[i].mStats.Records(), (unsigned long long) lWorkers[i].mStats.Frames(),
+                lWorkers[i].mBusy > 0 ? lWorkers[i].mStats.Frames() / lWorkers[i].mBusy : 0 );
+    }
+
+    printf( "Records             : %u (%u failed), %.1f MB\n", lTotal.Records(), lFailed,
+            lBytes * 1e-6 );
+    printf( "Throughput          : %llu frames in %.2f s, %.0f frames/s with %u workers\n",
+            (unsigned long long) lTotal.Frames(), lElapsed, lTotal.Frames() / lElapsed,
+            lWorkerCount );
+
+    if (    !lTotal.WriteSegments( lPrefix + "_segments.csv" )
+         || !lTotal.WriteHistograms( lPrefix + "_histograms.csv" ) )
+    {
+        fprintf( stderr, "Failed to write %s_*.csv.\n", lPrefix.c_str() );
+        return 1;
+    }
+
+    return lFailed > 0 ? 2 : 0;
+}
+
+// End of file LeddarAnalyze.cpp
@@ -0,0 +1,346 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    LeddarBenchmark.cpp
+///
+/// \brief   End-to-end benchmark of the driver pipeline.
+///
+/// Drives one sensor (the mock LeddarC when built with LEDDARTECH_MOCK) for
+/// a fixed time and subscribes to its scans in the same process, then
+/// reports the throughput, the CPU time per frame and the percentiles of
+/// the latency from the acquisition stamp to the subscriber. Sensor
+/// settings are read from the private namespace like the node does.
+///
+/// When recording (record/directory set), the time the recorder takes on
+/// the publisher thread is reported, then record_frames synthetic frames
+/// are pushed to a recorder as fast as possible to measure the sustained
+/// write throughput.
+///
+/// When replaying (replay_file set), the time from opening the record to
+/// the first scan is reported as well; replay_wait_loaded:=true gives the
+/// time when the whole record is loaded first.
+///
+/// When writing the shared memory ring (shm_name set), a thread reads it
+/// like an outside process would and the latency from the acquisition
+/// stamp to that reader is reported next to the subscriber latency, with
+/// the time taken by one read.
+///
+///   rosrun leddartech leddartech_benchmark _duration:=10
+// *****************************************************************************
+
+#include <ros/ros.h>
+#include <sensor_msgs/LaserScan.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include <atomic>
+#include <thread>
+
+#include "leddartech/FrameRecorder.h"
+#include "leddartech/LatencyHistogram.h"
+#include "leddartech/LeddarSensor.h"
+#include "leddartech/LeddarShm.h"
+#include "leddartech/PipelineStats.h"
+
+using leddartech::FrameRecorder;
+using leddartech::LatencyHistogram;
+using leddartech::LeddarSensor;
+using leddartech::LeddarSensorOptions;
+using leddartech::MonotonicSeconds;
+using leddartech::RecorderSettings;
+using leddartech::SegmentFrame;
+
+// Only touched by the single spinner thread.
+static LatencyHistogram gLatency;
+static uint64_t         gReceived = 0;
+static uint64_t         gGaps = 0;
+static uint32_t         gLastSequence = 0;
+static double           gFirstScan = 0;     ///< Monotonic.
+
+// Only touched by the shared memory reader thread until it is joined.
+static LatencyHistogram  gShmLatency;
+static LatencyHistogram  gShmRead;
+static uint64_t          gShmReceived = 0;
+static uint64_t          gShmLost = 0;
+static std::atomic<bool> gShmStop( false );
+
+static void
+ScanCallback( const sensor_msgs::LaserScan::ConstPtr &aScan )
+{
+    gLatency.Add( ( ros::Time::now() - aScan->header.stamp ).toSec() );
+
+    if ( gReceived == 0 )
+    {
+        gFirstScan = MonotonicSeconds();
+    }
+
+    if ( ( gReceived > 0 ) && ( aScan->header.seq != gLastSequence + 1 ) )
+    {
+        ++gGaps;
+    }
+
+    gLastSequence = aScan->header.seq;
+    ++gReceived;
+}
+
+// *****************************************************************************
+// Function: ShmReader
+//
+/// \brief   Follow the shared memory ring frame by frame until stopped and
+///          collect the latency of each frame, measured as the subscriber
+///          does, and the time a read of it takes.
+///
+/// \param   aShm  Ring, opened.
+// *****************************************************************************
+
+static void
+ShmReader( LeddarShm *aShm )
+{
+    LeddarShmFrame lFrame;
+    uint64_t       lIndex = LeddarShmWritten( aShm );
+
+    while( !gShmStop )
+    {
+        const int lResult = LeddarShmWait( aShm, lIndex, &lFrame, 0.1 );
+
+        if ( lResult == LEDDAR_SHM_OK )
+        {
+            struct timespec lNow;
+
+            clock_gettime( CLOCK_REALTIME, &lNow );
+            gShmLatency.Add( ( lNow.tv_sec - lFrame.mStamp * 1e-9 ) + lNow.tv_nsec * 1e-9 );
+
+            // Once more, written this time: the cost of the copy alone.
+            const double lStart = MonotonicSeconds();
+
+            LeddarShmRead( aShm, lIndex, &lFrame );
+            gShmRead.Add( MonotonicSeconds() - lStart );
+            ++gShmReceived;
+            ++lIndex;
+        }
+        else if ( lResult != LEDDAR_SHM_NOT_YET )
+        {
+            // Lapped: go on from the oldest frame still in the ring.
+            const uint64_t lOldest = LeddarShmWritten( aShm ) - LeddarShmSlotCount( aShm ) + 1;
+
+            gShmLost += lOldest - lIndex;
+            lIndex = lOldest;
+        }
+    }
+}
+
+// *****************************************************************************
+// Function: CpuSeconds
+//
+/// \brief   User and system time used by the process so far.
+// *****************************************************************************
+
+static double
+CpuSeconds( void )
+{
+    struct rusage lUsage;
+
+    getrusage( RUSAGE_SELF, &lUsage );
+
+    return lUsage.ru_utime.tv_sec + lUsage.ru_utime.tv_usec * 1e-6
+           + lUsage.ru_stime.tv_sec + lUsage.ru_stime.tv_usec * 1e-6;
+}
+
+// *****************************************************************************
+// Function: RecorderThroughput
+//
+/// \brief   Push synthetic frames to a recorder without pause and report the
+///          rate it sustains, the frames it had to drop and the time taken
+///          by each hand-off.
+///
+/// \param   aSettings  Where and how to record.
+/// \param   aFrames    Number of frames to push.
+// *****************************************************************************
+
+static void
+RecorderThroughput( const RecorderSettings &aSettings, int aFrames )
+{
+    const unsigned int kSegments = 16;
+    FrameRecorder      lRecorder;
+    SegmentFrame       lFrame = SegmentFrame();
+
+    if ( !lRecorder.Open( aSettings, kSegments ) )
+    {
+        return;
+    }
+
+    lFrame.mSegmentCount = kSegments;
+
+    const double lStart = MonotonicSeconds();
+
+    for( int i=0; i<aFrames; ++i )
+    {
+        lFrame.mRecordIndex = i;
+        lFrame.mArrival.fromSec( lStart + i * 0.01 );
+        lFrame.mStamp = lFrame.mArrival;
+
+        // A still scene with a little noise, one or two echoes.
+        for( unsigned int s=0; s<kSegments; ++s )
+        {
+            lFrame.mEchoCount[s] = 1 + ( ( i + s ) % 2 );
+            lFrame.mDistance[0][s] = 5.0f + ( ( i * 7 + s ) % 11 ) * 1e-3f;
+            lFrame.mAmplitude[0][s] = 100.0f + s;
+            lFrame.mFlags[0][s] = 1;
+            lFrame.mDistance[1][s] = 12.0f;
+            lFrame.mAmplitude[1][s] = 20.0f;
+            lFrame.mFlags[1][s] = 1;
+        }
+
+        lRecorder.Add( lFrame );
+    }
+
+    lRecorder.Close();
+
+    const double lElapsed = MonotonicSeconds() - lStart;
+    const LatencyHistogram &lHandOff = lRecorder.HandOffTime();
+
+    printf( "Recorder throughput : %.0f frames/s, %.1f MB/s raw, %.1f MB/s written "
+            "(%d pushed, %llu dropped, %u files)\n",
+            lRecorder.Frames() / lElapsed, lRecorder.RawBytes() * 1e-6 / lElapsed,
+            lRecorder.StoredBytes() * 1e-6 / lElapsed, aFrames,
+            (unsigned long long) lRecorder.Dropped(), lRecorder.Files() );
+    printf( "Recorder hand-off   : mean %.2f p99 %.2f max %.2f us\n", lHandOff.Mean() * 1e6,
+            lHandOff.Percentile( 0.99 ) * 1e6, lHandOff.Max() * 1e6 );
+}
+
+int main( int argc, char **argv )
+{
+    ros::init( argc, argv, "leddartech_benchmark" );
+
+    ros::NodeHandle lNode;
+    ros::NodeHandle lPrivate( "~" );
+
+    LeddarSensorOptions lOptions;
+    double              lDuration;
+    int                 lRecordFrames;
+
+    lOptions.Read( lPrivate );
+    lOptions.mAutostart = false;
+    lOptions.mLatencyReportPeriod = 0;
+    lPrivate.param( "duration", lDuration, 10.0 );
+    lPrivate.param( "record_frames", lRecordFrames, 100000 );
+
+    LeddarSensor lSensor( std::string(), lOptions, lNode, lPrivate );
+
+    // Same process: the scans are handed over as shared pointers.
+    ros::Subscriber lSubscriber = lNode.subscribe( "leddar_scan", 1000, ScanCallback );
+    ros::AsyncSpinner lSpinner( 1 );
+
+    lSpinner.start();
+
+    const double lOpenStart = MonotonicSeconds();
+
+    if ( !lSensor.Open() )
+    {
+        return 1;
+    }
+
+    lSensor.Activate();
+
+    LeddarShm  *lShm = NULL;
+    std::thread lShmThread;
+
+    if ( !lOptions.mShmName.empty() )
+    {
+        lShm = LeddarShmOpen( lOptions.mShmName.c_str() );
+    }
+
+    if ( lShm != NULL )
+    {
+        gShmLatency.SetBinWidth( 10e-6 );
+        gShmRead.SetBinWidth( 10e-9 );
+        lShmThread = std::thread( ShmReader, lShm );
+    }
+
+    const double        lCpuStart = CpuSeconds();
+    const ros::WallTime lStart = ros::WallTime::now();
+
+    if ( !lSensor.StartStreaming() )
+    {
+        return 1;
+    }
+
+    ros::WallDuration( lDuration ).sleep();
+    lSensor.StopStreaming();
+
+    const double lElapsed = ( ros::WallTime::now() - lStart ).toSec();
+    const double lCpu = CpuSeconds() - lCpuStart;
+
+    // Let the last frames reach the subscriber.
+    ros::WallDuration( 0.2 ).sleep();
+    lSpinner.stop();
+
+    if ( lShmThread.joinable() )
+    {
+        gShmStop = true;
+        lShmThread.join();
+        LeddarShmClose( lShm );
+    }
+
+    lSensor.Close();
+
+    if ( gReceived == 0 )
+    {
+        fprintf( stderr, "No scan received.\n" );
+        return 1;
+    }
+
+    printf( "Frames received     : %llu in %.2f s (%.1f frames/s), %llu sequence gaps\n",
+            (unsigned long long) gReceived, lElapsed, gReceived / lElapsed,
+            (unsigned long long) gGaps );
+    printf( "CPU per frame       : %.1f us (%.1f %% of a core, includes frame generation)\n",
+            lCpu / gReceived * 1e6, lCpu / lElapsed * 100 );
+    printf( "Latency (ms)        : min %.3f mean %.3f p50 %.3f p95 %.3f p99 %.3f max %.3f\n",
+            gLatency.Min() * 1e3, gLatency.Mean() * 1e3, gLatency.Percentile( 0.5 ) * 1e3,
+            gLatency.Percentile( 0.95 ) * 1e3, gLatency.Percentile( 0.99 ) * 1e3,
+            gLatency.Max() * 1e3 );
+
+    if ( gShmReceived > 0 )
+    {
+        printf( "Shm latency (ms)    : min %.3f mean %.3f p50 %.3f p95 %.3f p99 %.3f max %.3f "
+                "(%llu frames, %llu lost)\n", gShmLatency.Min() * 1e3, gShmLatency.Mean() * 1e3,
+                gShmLatency.Percentile( 0.5 ) * 1e3, gShmLatency.Percentile( 0.95 ) * 1e3,
+                gShmLatency.Percentile( 0.99 ) * 1e3, gShmLatency.Max() * 1e3,
+                (unsigned long long) gShmReceived, (unsigned long long) gShmLost );
+        printf( "Shm read (us)       : mean %.2f p99 %.2f max %.2f\n", gShmRead.Mean() * 1e6,
+                gShmRead.Percentile( 0.99 ) * 1e6, gShmRead.Max() * 1e6 );
+    }
+    else if ( !lOptions.mShmName.empty() )
+    {
+        fprintf( stderr, "No frame read from the shared memory %s.\n", lOptions.mShmName.c_str() );
+    }
+
+    if ( !lOptions.mReplayFile.empty() )
+    {
+        printf( "Time to first scan  : %.1f ms from opening the record\n",
+                ( gFirstScan - lOpenStart ) * 1e3 );
+    }
+
+    if ( !lOptions.mRecord.mDirectory.empty() )
+    {
+        FrameRecorder          &lRecorder = lSensor.Recorder();
+        const LatencyHistogram &lHandOff = lRecorder.HandOffTime();
+
+        printf( "Recording           : %llu frames, %llu dropped, %.1f MB (%.1f MB raw), "
+                "%.1f ms writing\n", (unsigned long long) lRecorder.Frames(),
+                (unsigned long long) lRecorder.Dropped(), lRecorder.StoredBytes() * 1e-6,
+                lRecorder.RawBytes() * 1e-6, lRecorder.WriteSeconds() * 1e3 );
+        printf( "Recording per frame : mean %.2f p99 %.2f max %.2f us on the publisher thread\n",
+                lHandOff.Mean() * 1e6, lHandOff.Percentile( 0.99 ) * 1e6, lHandOff.Max() * 1e6 );
+
+        if ( lRecordFrames > 0 )
+        {
+            RecorderThroughput( lOptions.mRecord, lRecordFrames );
+        }
+    }
+
+    return 0;
+}
+
+// End of file LeddarBenchmark.cpp
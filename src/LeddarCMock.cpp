@@ -0,0 +1,791 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    LeddarCMock.cpp
+///
+/// \brief   Stand-in for libLeddarC that synthesizes frames, so the driver
+///          can be run, tested and profiled without a sensor.
+///
+/// Implements the whole LeddarC.h API. Connecting to any address succeeds
+/// and starting the data transfer generates frames on a worker thread at
+/// PID_MEASUREMENT_RATE. Loading any file name gives a synthetic record
+/// stepped like a real one. Properties are kept per handle so they can be
+/// read back, written and restored.
+///
+/// The synthetic sensor is set with environment variables:
+///   LEDDAR_MOCK_RATE           Frames per second (default 50).
+///   LEDDAR_MOCK_SEGMENTS       Segment count (default 16).
+///   LEDDAR_MOCK_ECHOES         Echoes per segment (default 1).
+///   LEDDAR_MOCK_RECORD_FRAMES  Frames of a loaded record (default 1000).
+///   LEDDAR_MOCK_SENSORS        Sensors listed by LeddarListSensors
+///                              (default 1).
+// *****************************************************************************
+
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "LeddarC.h"
+#include "LeddarProperties.h"
+#include "LeddarResults.h"
+
+#define MOCK_MAX_SEGMENTS   64
+#define MOCK_MAX_ECHOES     6
+
+namespace
+{
+
+typedef std::pair<unsigned int, unsigned int> PropertyKey;
+typedef std::map<PropertyKey, double>         PropertyMap;
+
+struct MockDevice
+{
+    MockDevice( void )
+        : mConnected( false ), mRecord( false ), mRecordSize( 0 ), mRecordIndex( 0 ),
+          mTransfer( false ), mFrame( 0 ), mCount( 0 ) {}
+
+    // Protects the properties, state and callbacks. Held while the
+    // callbacks run so that a removed callback is never called again once
+    // LeddarRemoveCallback returns.
+    std::recursive_mutex mMutex;
+
+    bool        mConnected;
+    bool        mRecord;
+    size_t      mRecordSize;
+    size_t      mRecordIndex;
+    PropertyMap mProperties;
+    PropertyMap mSaved;         ///< Last written configuration.
+    std::string mName;
+
+    std::vector< std::pair<LdCallback, void *> > mCallbacks;
+
+    std::atomic<bool> mTransfer;
+    std::thread       mWorker;
+
+    // Current frame.
+    unsigned long long mFrame;
+    unsigned int       mCount;
+    LdDetection        mDetections[ MOCK_MAX_SEGMENTS * MOCK_MAX_ECHOES ];
+};
+
+// *****************************************************************************
+// Function: EnvValue
+//
+/// \brief   Read a numeric setting from the environment.
+// *****************************************************************************
+
+double
+EnvValue( const char *aName, double aDefault )
+{
+    const char *lValue = getenv( aName );
+
+    return ( lValue != NULL ) && ( *lValue != 0 ) ? atof( lValue ) : aDefault;
+}
+
+unsigned int
+SegmentCount( void )
+{
+    const int lCount = (int) EnvValue( "LEDDAR_MOCK_SEGMENTS", 16 );
+
+    return lCount < 1 ? 1 : ( lCount > MOCK_MAX_SEGMENTS ? MOCK_MAX_SEGMENTS : lCount );
+}
+
+unsigned int
+EchoCount( void )
+{
+    const int lCount = (int) EnvValue( "LEDDAR_MOCK_ECHOES", 1 );
+
+    return lCount < 1 ? 1 : ( lCount > MOCK_MAX_ECHOES ? MOCK_MAX_ECHOES : lCount );
+}
+
+// *****************************************************************************
+// Function: SetDefaults
+//
+/// \brief   Properties of a freshly connected sensor: a uniform 45 degrees
+///          field of view and the usual acquisition settings.
+// *****************************************************************************
+
+void
+SetDefaults( MockDevice &aDevice )
+{
+    const unsigned int lSegments = SegmentCount();
+    const double       lWidth = 45.0 / lSegments;
+    PropertyMap       &lProperties = aDevice.mProperties;
+
+    lProperties.clear();
+
+    for( unsigned int i=0; i<lSegments; ++i )
+    {
+        lProperties[ PropertyKey( PID_SEGMENT_LEFT, i ) ] = -22.5 + i * lWidth;
+        lProperties[ PropertyKey( PID_SEGMENT_RIGHT, i ) ] = -22.5 + ( i + 1 ) * lWidth;
+        lProperties[ PropertyKey( PID_SEGMENT_TOP, i ) ] = 1.5;
+        lProperties[ PropertyKey( PID_SEGMENT_BOTTOM, i ) ] = -1.5;
+        lProperties[ PropertyKey( PID_ZONE_SEGMENT_ENABLED, i ) ] = 1;
+    }
+
+    for( unsigned int i=0; i<16; ++i )
+    {
+        lProperties[ PropertyKey( PID_GLOBAL_TRANSFORM, i ) ] = ( i % 5 == 0 ) ? 1 : 0;
+        lProperties[ PropertyKey( PID_INVERSE_TRANSFORM, i ) ] = ( i % 5 == 0 ) ? 1 : 0;
+    }
+
+    lProperties[ PropertyKey( PID_LED_INTENSITY, 0 ) ] = 100;
+    lProperties[ PropertyKey( PID_OVERSAMPLING_EXPONENT, 0 ) ] = 2;
+    lProperties[ PropertyKey( PID_OVERSAMPLING, 0 ) ] = 4;
+    lProperties[ PropertyKey( PID_ACCUMULATION_EXPONENT, 0 ) ] = 5;
+    lProperties[ PropertyKey( PID_ACCUMULATION, 0 ) ] = 32;
+    lProperties[ PropertyKey( PID_BASE_POINT_COUNT, 0 ) ] = 6;
+    lProperties[ PropertyKey( PID_THRESHOLD_OFFSET, 0 ) ] = 0;
+    lProperties[ PropertyKey( PID_SENSOR_HEIGHT, 0 ) ] = 0;
+    lProperties[ PropertyKey( PID_ZONE_NEAR_LIMIT, 0 ) ] = 0;
+    lProperties[ PropertyKey( PID_ZONE_FAR_LIMIT, 0 ) ] = 10;
+    lProperties[ PropertyKey( PID_ZONE_ENABLED, 0 ) ] = 1;
+    lProperties[ PropertyKey( PID_ZONE_RISING_DEBOUNCE, 0 ) ] = 1;
+    lProperties[ PropertyKey( PID_ZONE_FALLING_DEBOUNCE, 0 ) ] = 1;
+    lProperties[ PropertyKey( PID_AUTOMATIC_LED_INTENSITY, 0 ) ] = 1;
+    lProperties[ PropertyKey( PID_CHANGE_DELAY, 0 ) ] = 0;
+    lProperties[ PropertyKey( PID_OBJECT_DEMERGING, 0 ) ] = 0;
+    lProperties[ PropertyKey( PID_MEASUREMENT_RATE, 0 ) ] = EnvValue( "LEDDAR_MOCK_RATE", 50 );
+
+    aDevice.mSaved = lProperties;
+    aDevice.mName = "Leddar mock";
+}
+
+// *****************************************************************************
+// Function: Generate
+//
+/// \brief   Synthesize the detections of a frame: every echo of every
+///          segment, slowly moving so that consecutive frames differ.
+///
+/// \param   aDevice  Receives the detections.
+/// \param   aFrame   Index of the frame, the content depends only on it.
+// *****************************************************************************
+
+void
+Generate( MockDevice &aDevice, unsigned long long aFrame )
+{
+    const unsigned int lSegments = SegmentCount();
+    const unsigned int lEchoes = EchoCount();
+    unsigned int       lCount = 0;
+
+    for( unsigned int s=0; s<lSegments; ++s )
+    {
+        for( unsigned int e=0; e<lEchoes; ++e )
+        {
+            LdDetection &lDetection = aDevice.mDetections[lCount++];
+
+            lDetection.mDistance = 2.0f + 0.25f * s + 3.0f * e
+                                   + 0.5f * (float) sin( aFrame * 0.05 + s * 0.3 );
+            lDetection.mAmplitude = 200.0f / ( 1.0f + lDetection.mDistance );
+            lDetection.mSegment = s;
+            lDetection.mFlags = 1;
+        }
+    }
+
+    aDevice.mFrame = aFrame;
+    aDevice.mCount = lCount;
+}
+
+// *****************************************************************************
+// Function: Notify
+//
+/// \brief   Call every callback for a new frame, removing those that return
+///          zero. The device mutex must be held.
+// *****************************************************************************
+
+void
+Notify( MockDevice &aDevice )
+{
+    for( size_t i=0; i<aDevice.mCallbacks.size(); )
+    {
+        if ( aDevice.mCallbacks[i].first( aDevice.mCallbacks[i].second, LDDL_DETECTIONS ) == 0 )
+        {
+            aDevice.mCallbacks.erase( aDevice.mCallbacks.begin() + i );
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+// *****************************************************************************
+// Function: Worker
+//
+/// \brief   Generate frames at the measurement rate while the data transfer
+///          is started, on absolute deadlines so the rate does not drift.
+// *****************************************************************************
+
+void
+Worker( MockDevice *aDevice )
+{
+    typedef std::chrono::steady_clock Clock;
+
+    Clock::time_point  lNext = Clock::now();
+    unsigned long long lFrame = 0;
+
+    while( aDevice->mTransfer.load() )
+    {
+        double lRate;
+
+        {
+            std::lock_guard<std::recursive_mutex> lLock( aDevice->mMutex );
+
+            lRate = aDevice->mProperties[ PropertyKey( PID_MEASUREMENT_RATE, 0 ) ];
+            Generate( *aDevice, lFrame++ );
+            Notify( *aDevice );
+        }
+
+        lNext += std::chrono::duration_cast<Clock::duration>(
+                     std::chrono::duration<double>( 1.0 / lRate ) );
+        std::this_thread::sleep_until( lNext );
+    }
+}
+
+void
+StopWorker( MockDevice &aDevice )
+{
+    aDevice.mTransfer = false;
+
+    if ( aDevice.mWorker.joinable() && ( aDevice.mWorker.get_id() != std::this_thread::get_id() ) )
+    {
+        aDevice.mWorker.join();
+    }
+}
+
+MockDevice *
+Device( LeddarHandle aHandle )
+{
+    return static_cast<MockDevice *>( aHandle );
+}
+
+// *****************************************************************************
+// Function: StepTo
+//
+/// \brief   Move to a frame of the loaded record and call the callbacks
+///          from the calling thread, like the SDK does when replaying.
+// *****************************************************************************
+
+int
+StepTo( LeddarHandle aHandle, long long aIndex )
+{
+    MockDevice                           *lDevice = Device( aHandle );
+    std::lock_guard<std::recursive_mutex> lLock( lDevice->mMutex );
+
+    if ( !lDevice->mRecord )
+    {
+        return LD_NO_RECORD;
+    }
+
+    if ( aIndex < 0 )
+    {
+        return LD_START_OF_FILE;
+    }
+
+    if ( aIndex >= (long long) lDevice->mRecordSize )
+    {
+        return LD_END_OF_FILE;
+    }
+
+    lDevice->mRecordIndex = aIndex;
+    Generate( *lDevice, aIndex );
+    Notify( *lDevice );
+
+    return LD_SUCCESS;
+}
+
+} // namespace
+
+void
+LeddarGetVersion( char *aBuffer, size_t aLength )
+{
+    snprintf( aBuffer, aLength, "mock" );
+}
+
+LeddarHandle
+LeddarCreate( void )
+{
+    return new MockDevice;
+}
+
+void
+LeddarDestroy( LeddarHandle aHandle )
+{
+    LeddarDisconnect( aHandle );
+    delete Device( aHandle );
+}
+
+int
+LeddarGetConnected( LeddarHandle aHandle )
+{
+    return Device( aHandle )->mConnected;
+}
+
+int
+LeddarGetConfigurationModified( LeddarHandle aHandle )
+{
+    MockDevice                           *lDevice = Device( aHandle );
+    std::lock_guard<std::recursive_mutex> lLock( lDevice->mMutex );
+
+    return lDevice->mProperties != lDevice->mSaved;
+}
+
+size_t
+LeddarGetRecordSize( LeddarHandle aHandle )
+{
+    return Device( aHandle )->mRecordSize;
+}
+
+int
+LeddarGetRecordLoading( LeddarHandle )
+{
+    return 0;
+}
+
+size_t
+LeddarGetCurrentRecordIndex( LeddarHandle aHandle )
+{
+    return Device( aHandle )->mRecordIndex;
+}
+
+unsigned int
+LeddarGetDetectionCount( LeddarHandle aHandle )
+{
+    return Device( aHandle )->mCount;
+}
+
+int
+LeddarGetRecording( LeddarHandle )
+{
+    return 0;
+}
+
+int
+LeddarGetRecordingDirectory( LtChar *aValue, LeddarU32 aLength )
+{
+    if ( aLength > 0 )
+    {
+        aValue[0] = 0;
+    }
+
+    return LD_SUCCESS;
+}
+
+LeddarU32
+LeddarGetMaxRecordFileSize( void )
+{
+    return 0;
+}
+
+LeddarU32
+LeddarGetRecordingLevels( void )
+{
+    return 0;
+}
+
+int
+LeddarGetProperty( LeddarHandle aHandle, unsigned int aId, unsigned int aIndex, double *aValue )
+{
+    MockDevice                           *lDevice = Device( aHandle );
+    std::lock_guard<std::recursive_mutex> lLock( lDevice->mMutex );
+
+    if ( !lDevice->mConnected )
+    {
+        return LD_NOT_CONNECTED;
+    }
+
+    PropertyMap::const_iterator lIt = lDevice->mProperties.find( PropertyKey( aId, aIndex ) );
+
+    if ( lIt == lDevice->mProperties.end() )
+    {
+        return LD_INVALID_ARGUMENT;
+    }
+
+    *aValue = lIt->second;
+    return LD_SUCCESS;
+}
+
+int
+LeddarGetTextProperty( LeddarHandle aHandle, unsigned int aId, unsigned int aIndex,
+                       char *aValue, size_t aValueLen )
+{
+    MockDevice                           *lDevice = Device( aHandle );
+    std::lock_guard<std::recursive_mutex> lLock( lDevice->mMutex );
+
+    if ( !lDevice->mConnected )
+    {
+        return LD_NOT_CONNECTED;
+    }
+
+    if ( ( aId != PID_NAME ) || ( aIndex != 0 ) )
+    {
+        return LD_INVALID_ARGUMENT;
+    }
+
+    snprintf( aValue, aValueLen, "%s", lDevice->mName.c_str() );
+    return LD_SUCCESS;
+}
+
+int
+LeddarSetProperty( LeddarHandle aHandle, unsigned int aId, unsigned int aIndex, double aValue )
+{
+    MockDevice                           *lDevice = Device( aHandle );
+    std::lock_guard<std::recursive_mutex> lLock( lDevice->mMutex );
+
+    if ( !lDevice->mConnected )
+    {
+        return LD_NOT_CONNECTED;
+    }
+
+    PropertyMap::iterator lIt = lDevice->mProperties.find( PropertyKey( aId, aIndex ) );
+
+    if ( ( lIt == lDevice->mProperties.end() )
+         || ( ( aId == PID_MEASUREMENT_RATE ) && ( aValue <= 0 ) ) )
+    {
+        return LD_INVALID_ARGUMENT;
+    }
+
+    lIt->second = aValue;
+    return LD_SUCCESS;
+}
+
+int
+LeddarSetTextProperty( LeddarHandle aHandle, unsigned aId, unsigned int aIndex,
+                       const char *aValue )
+{
+    MockDevice                           *lDevice = Device( aHandle );
+    std::lock_guard<std::recursive_mutex> lLock( lDevice->mMutex );
+
+    if ( !lDevice->mConnected )
+    {
+        return LD_NOT_CONNECTED;
+    }
+
+    if ( ( aId != PID_NAME ) || ( aIndex != 0 ) )
+    {
+        return LD_INVALID_ARGUMENT;
+    }
+
+    lDevice->mName = aValue;
+    return LD_SUCCESS;
+}
+
+int
+LeddarGetDetections( LeddarHandle aHandle, LdDetection *aDetections, unsigned int aLength )
+{
+    MockDevice        *lDevice = Device( aHandle );
+    const unsigned int lCount = lDevice->mCount;
+
+    memcpy( aDetections, lDevice->mDetections,
+            ( lCount < aLength ? lCount : aLength ) * sizeof( LdDetection ) );
+
+    return lCount > aLength ? LD_NOT_ENOUGH_SPACE : LD_SUCCESS;
+}
+
+int
+LeddarGetResult( LeddarHandle aHandle, unsigned int aId, unsigned int, double *aValue )
+{
+    MockDevice *lDevice = Device( aHandle );
+
+    if ( !lDevice->mConnected )
+    {
+        return LD_NOT_CONNECTED;
+    }
+
+    switch( aId )
+    {
+        case RID_TEMPERATURE:
+            *aValue = 35.0 + 0.5 * sin( lDevice->mFrame * 0.001 );
+            return LD_SUCCESS;
+        case RID_LED_INTENSITY:
+            *aValue = 100;
+            return LD_SUCCESS;
+        default:
+            *aValue = 0;
+            return LD_SUCCESS;
+    }
+}
+
+int
+LeddarExecuteCommand( LeddarHandle aHandle, unsigned int, ... )
+{
+    return Device( aHandle )->mConnected ? LD_SUCCESS : LD_NOT_CONNECTED;
+}
+
+int
+LeddarListSensors( char *aAddresses, unsigned int *aSize, unsigned int )
+{
+    const int    lSensors = (int) EnvValue( "LEDDAR_MOCK_SENSORS", 1 );
+    unsigned int lUsed = 0;
+
+    for( int i=0; i<lSensors; ++i )
+    {
+        char lAddress[32];
+        int  lLength = snprintf( lAddress, sizeof(lAddress), "MOCK%d", i ) + 1;
+
+        // Keep room for the final empty string.
+        if ( lUsed + lLength + 1 > *aSize )
+        {
+            return LD_NOT_ENOUGH_SPACE;
+        }
+
+        memcpy( aAddresses + lUsed, lAddress, lLength );
+        lUsed += lLength;
+    }
+
+    aAddresses[lUsed] = 0;
+    *aSize = lUsed + 1;
+
+    return LD_SUCCESS;
+}
+
+int
+LeddarConnect( LeddarHandle aHandle, const char * )
+{
+    MockDevice                           *lDevice = Device( aHandle );
+    std::lock_guard<std::recursive_mutex> lLock( lDevice->mMutex );
+
+    if ( lDevice->mConnected )
+    {
+        return LD_ERROR;
+    }
+
+    SetDefaults( *lDevice );
+    lDevice->mConnected = true;
+
+    return LD_SUCCESS;
+}
+
+void
+LeddarDisconnect( LeddarHandle aHandle )
+{
+    MockDevice *lDevice = Device( aHandle );
+
+    StopWorker( *lDevice );
+
+    std::lock_guard<std::recursive_mutex> lLock( lDevice->mMutex );
+
+    lDevice->mConnected = false;
+    lDevice->mRecord = false;
+    lDevice->mRecordSize = 0;
+    lDevice->mRecordIndex = 0;
+}
+
+int
+LeddarLoadRecord( LeddarHandle aHandle, const LtChar * )
+{
+    MockDevice                           *lDevice = Device( aHandle );
+    std::lock_guard<std::recursive_mutex> lLock( lDevice->mMutex );
+
+    SetDefaults( *lDevice );
+    lDevice->mConnected = true;
+    lDevice->mRecord = true;
+    lDevice->mRecordSize = (size_t) EnvValue( "LEDDAR_MOCK_RECORD_FRAMES", 1000 );
+    lDevice->mRecordIndex = 0;
+
+    return LD_SUCCESS;
+}
+
+int
+LeddarPing( LeddarHandle aHandle )
+{
+    return Device( aHandle )->mConnected ? LD_SUCCESS : LD_NOT_CONNECTED;
+}
+
+int
+LeddarStartDataTransfer( LeddarHandle aHandle, LeddarU32 )
+{
+    MockDevice                           *lDevice = Device( aHandle );
+    std::lock_guard<std::recursive_mutex> lLock( lDevice->mMutex );
+
+    if ( !lDevice->mConnected )
+    {
+        return LD_NOT_CONNECTED;
+    }
+
+    if ( lDevice->mTransfer.load() )
+    {
+        return LD_ALREADY_STARTED;
+    }
+
+    // A record is stepped by the caller, there is nothing to generate.
+    if ( !lDevice->mRecord )
+    {
+        if ( lDevice->mWorker.joinable() )
+        {
+            lDevice->mWorker.join();
+        }
+
+        lDevice->mTransfer = true;
+        lDevice->mWorker = std::thread( Worker, lDevice );
+    }
+
+    return LD_SUCCESS;
+}
+
+void
+LeddarStopDataTransfer( LeddarHandle aHandle )
+{
+    StopWorker( *Device( aHandle ) );
+}
+
+int
+LeddarAddCallback( LeddarHandle aHandle, LdCallback aCallback, void *aUserData )
+{
+    MockDevice                           *lDevice = Device( aHandle );
+    std::lock_guard<std::recursive_mutex> lLock( lDevice->mMutex );
+
+    lDevice->mCallbacks.push_back( std::make_pair( aCallback, aUserData ) );
+    return LD_SUCCESS;
+}
+
+int
+LeddarRemoveCallback( LeddarHandle aHandle, LdCallback aCallback, void *aUserData )
+{
+    MockDevice                           *lDevice = Device( aHandle );
+    std::lock_guard<std::recursive_mutex> lLock( lDevice->mMutex );
+
+    for( size_t i=0; i<lDevice->mCallbacks.size(); ++i )
+    {
+        if ( ( lDevice->mCallbacks[i].first == aCallback )
+             && ( lDevice->mCallbacks[i].second == aUserData ) )
+        {
+            lDevice->mCallbacks.erase( lDevice->mCallbacks.begin() + i );
+            return LD_SUCCESS;
+        }
+    }
+
+    return LD_INVALID_ARGUMENT;
+}
+
+int
+LeddarWriteConfiguration( LeddarHandle aHandle )
+{
+    MockDevice                           *lDevice = Device( aHandle );
+    std::lock_guard<std::recursive_mutex> lLock( lDevice->mMutex );
+
+    if ( !lDevice->mConnected )
+    {
+        return LD_NOT_CONNECTED;
+    }
+
+    lDevice->mSaved = lDevice->mProperties;
+    return LD_SUCCESS;
+}
+
+int
+LeddarRestoreConfiguration( LeddarHandle aHandle )
+{
+    MockDevice                           *lDevice = Device( aHandle );
+    std::lock_guard<std::recursive_mutex> lLock( lDevice->mMutex );
+
+    if ( !lDevice->mConnected )
+    {
+        return LD_NOT_CONNECTED;
+    }
+
+    lDevice->mProperties = lDevice->mSaved;
+    return LD_SUCCESS;
+}
+
+int
+LeddarConfigureRecording( const LtChar *, unsigned int, LeddarU32 )
+{
+    return LD_SUCCESS;
+}
+
+int
+LeddarStartRecording( LeddarHandle aHandle )
+{
+    return Device( aHandle )->mConnected ? LD_SUCCESS : LD_NOT_CONNECTED;
+}
+
+void
+LeddarStopRecording( LeddarHandle )
+{
+}
+
+int
+LeddarStepForward( LeddarHandle aHandle )
+{
+    return StepTo( aHandle, (long long) Device( aHandle )->mRecordIndex + 1 );
+}
+
+int
+LeddarStepBackward( LeddarHandle aHandle )
+{
+    return StepTo( aHandle, (long long) Device( aHandle )->mRecordIndex - 1 );
+}
+
+int
+LeddarMoveRecordTo( LeddarHandle aHandle, unsigned int aIndex )
+{
+    const int lResult = StepTo( aHandle, aIndex );
+
+    return ( lResult == LD_START_OF_FILE ) || ( lResult == LD_END_OF_FILE )
+           ? LD_INVALID_ARGUMENT : lResult;
+}
+
+int
+LeddarGetErrorMessage( int aCode, LtChar *aBuffer, size_t aLength )
+{
+    const char *lMessage;
+
+    switch( aCode )
+    {
+        case LD_SUCCESS:           lMessage = "Success"; break;
+        case LD_NOT_ENOUGH_SPACE:  lMessage = "Not enough space"; break;
+        case LD_ERROR:             lMessage = "Error"; break;
+        case LD_INVALID_ARGUMENT:  lMessage = "Invalid argument"; break;
+        case LD_NOT_CONNECTED:     lMessage = "Not connected"; break;
+        case LD_NO_DATA_TRANSFER:  lMessage = "No data transfer"; break;
+        case LD_ALREADY_STARTED:   lMessage = "Already started"; break;
+        case LD_NO_RECORD:         lMessage = "No record"; break;
+        case LD_END_OF_FILE:       lMessage = "End of file"; break;
+        case LD_START_OF_FILE:     lMessage = "Start of file"; break;
+        default:                   lMessage = "Unknown error"; break;
+    }
+
+    snprintf( aBuffer, aLength, "%s", lMessage );
+    return LD_SUCCESS;
+}
+
+LeddarBool
+LeddarKeyPressed( void )
+{
+    fd_set         lSet;
+    struct timeval lTimeout = { 0, 0 };
+
+    FD_ZERO( &lSet );
+    FD_SET( 0, &lSet );
+
+    return select( 1, &lSet, NULL, NULL, &lTimeout ) > 0;
+}
+
+int
+LeddarGetKey( void )
+{
+    return getchar();
+}
+
+void
+LeddarSleep( double aSeconds )
+{
+    std::this_thread::sleep_for( std::chrono::duration<double>( aSeconds ) );
+}
+
+// End of file LeddarCMock.cpp
@@ -0,0 +1,226 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    LeddarDriver.cpp
+///
+/// \brief   Headless driver: the set of sensors configured by parameters.
+// *****************************************************************************
+
+#include "leddartech/LeddarDriver.h"
+
+#include <stdio.h>
+
+#include "leddartech/LeddarDevice.h"
+
+namespace leddartech
+{
+
+// *****************************************************************************
+// Function: LeddarDriver::LeddarDriver
+//
+/// \brief   Create the sensors listed by the parameters. Nothing is opened
+///          until Start.
+///
+///          The sensors are listed by name in ~sensors, each one reading its
+///          settings from ~<name>/ (falling back to the node settings) and
+///          publishing under <name>/. With ~discover the sensors found by
+///          LeddarListSensors are named leddar0, leddar1... Otherwise a
+///          single sensor is driven with the node settings and topics.
+///
+/// \param   aNode         Node handle for the topics.
+/// \param   aPrivate      Node handle in the private namespace of the node.
+/// \param   aDefaults     Settings read from the private namespace.
+/// \param   aAllFinished  Called once every sensor is finished or failed to
+///                        open, from a sensor thread. May be empty.
+// *****************************************************************************
+
+LeddarDriver::LeddarDriver( ros::NodeHandle &aNode, ros::NodeHandle &aPrivate,
+                            const LeddarSensorOptions &aDefaults,
+                            const std::function<void( void )> &aAllFinished )
+    : mAllFinished( aAllFinished ),
+      mFinishedCount( 0 )
+{
+    std::vector<std::string> lNames, lAddresses;
+    bool                     lDiscover;
+
+    aPrivate.param( "discover", lDiscover, false );
+
+    if ( aPrivate.getParam( "sensors", lNames ) )
+    {
+        ROS_INFO( "Driving %d sensors.", (int) lNames.size() );
+    }
+    else if ( lDiscover )
+    {
+        DiscoverSensors( lAddresses );
+
+        for( size_t i=0; i<lAddresses.size(); ++i )
+        {
+            char lName[32];
+
+            snprintf( lName, sizeof(lName), "leddar%d", (int) i );
+            lNames.push_back( lName );
+        }
+    }
+    else
+    {
+        lNames.push_back( std::string() );
+    }
+
+    for( size_t i=0; i<lNames.size(); ++i )
+    {
+        LeddarSensorOptions lOptions = aDefaults;
+
+        // Named sensors get their own frames unless set explicitly.
+        if ( !lNames[i].empty() )
+        {
+            lOptions.mFrameId = lNames[i] + "_base_link";
+            lOptions.mCloudFrameId.clear();
+            lOptions.Read( ros::NodeHandle( aPrivate, lNames[i] ) );
+        }
+
+        if ( i < lAddresses.size() )
+        {
+            lOptions.mAddress = lAddresses[i];
+        }
+
+        mSensors.push_back( std::unique_ptr<LeddarSensor>(
+                                new LeddarSensor( lNames[i], lOptions, aNode, aPrivate ) ) );
+        mSensors.back()->SetFinishedCallback( std::bind( &LeddarDriver::SensorFinished, this, i ) );
+    }
+
+    mOpened.assign( mSensors.size(), 0 );
+    mFinished.assign( mSensors.size(), 0 );
+}
+
+// *****************************************************************************
+// Function: LeddarDriver::~LeddarDriver
+//
+/// \brief   Abort the connections still being attempted, then close every
+///          sensor.
+// *****************************************************************************
+
+LeddarDriver::~LeddarDriver( void )
+{
+    for( size_t i=0; i<mSensors.size(); ++i )
+    {
+        mSensors[i]->AbortOpen();
+    }
+
+    WaitOpened();
+    mSensors.clear();
+}
+
+// *****************************************************************************
+// Function: LeddarDriver::DiscoverSensors
+//
+/// \brief   List the address of all sensors available, once for all sensors.
+///
+/// \param   aAddresses  Receives the addresses found.
+// *****************************************************************************
+
+void
+LeddarDriver::DiscoverSensors( std::vector<std::string> &aAddresses )
+{
+    const Result lResult = Device::ListSensors( aAddresses, 2000 );
+
+    if ( !lResult.Ok() )
+    {
+        ROS_ERROR( "Could not list the Leddar sensors (%d).", lResult.Code() );
+    }
+
+    ROS_INFO( "Found %d sensors.", (int) aAddresses.size() );
+}
+
+// *****************************************************************************
+// Function: LeddarDriver::Start
+//
+/// \brief   Open the sensors concurrently in the background: each one starts
+///          streaming as soon as it is connected. Returns right away.
+// *****************************************************************************
+
+void
+LeddarDriver::Start( void )
+{
+    for( size_t i=0; i<mSensors.size(); ++i )
+    {
+        mOpeners.push_back( std::thread( &LeddarDriver::OpenSensor, this, i ) );
+    }
+}
+
+void
+LeddarDriver::OpenSensor( size_t aIndex )
+{
+    if ( mSensors[aIndex]->Open() )
+    {
+        mSensors[aIndex]->Activate();
+        mOpened[aIndex] = 1;
+    }
+    else
+    {
+        SensorFinished( aIndex );
+    }
+}
+
+// *****************************************************************************
+// Function: LeddarDriver::SensorFinished
+//
+/// \brief   Count a sensor stopped for good (or never opened), once, and
+///          call the all finished callback with the last one.
+///
+/// \param   aIndex  Index of the sensor.
+// *****************************************************************************
+
+void
+LeddarDriver::SensorFinished( size_t aIndex )
+{
+    {
+        std::lock_guard<std::mutex> lLock( mFinishedMutex );
+
+        if ( mFinished[aIndex] )
+        {
+            return;
+        }
+
+        mFinished[aIndex] = 1;
+
+        if ( ++mFinishedCount < mSensors.size() )
+        {
+            return;
+        }
+    }
+
+    if ( mAllFinished )
+    {
+        mAllFinished();
+    }
+}
+
+// *****************************************************************************
+// Function: LeddarDriver::WaitOpened
+//
+/// \brief   Wait until every sensor is opened or has given up.
+///
+/// \return  The number of sensors opened.
+// *****************************************************************************
+
+size_t
+LeddarDriver::WaitOpened( void )
+{
+    size_t lOpenedCount = 0;
+
+    for( size_t i=0; i<mOpeners.size(); ++i )
+    {
+        if ( mOpeners[i].joinable() )
+        {
+            mOpeners[i].join();
+        }
+
+        lOpenedCount += mOpened[i];
+    }
+
+    return lOpenedCount;
+}
+
+} // namespace leddartech
+
+// End of file LeddarDriver.cpp
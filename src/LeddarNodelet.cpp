@@ -0,0 +1,57 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    LeddarNodelet.cpp
+///
+/// \brief   Nodelet running the headless driver inside a nodelet manager.
+///
+/// The scans and clouds are published as shared pointers, so consumers
+/// loaded in the same manager receive them without serialization or copy.
+// *****************************************************************************
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include <memory>
+
+#include "leddartech/LeddarDriver.h"
+
+namespace leddartech
+{
+
+class LeddarNodelet : public nodelet::Nodelet
+{
+public:
+    virtual ~LeddarNodelet( void )
+    {
+        mDriver.reset();
+    }
+
+private:
+    // *************************************************************************
+    /// \brief   Create the sensors and start opening them in the background,
+    ///          so the manager is not blocked while they connect. The
+    ///          multi-threaded node handles let the timers of each sensor
+    ///          run concurrently.
+    // *************************************************************************
+    virtual void onInit( void )
+    {
+        ros::NodeHandle &lNode = getMTNodeHandle();
+        ros::NodeHandle &lPrivate = getMTPrivateNodeHandle();
+
+        LeddarSensorOptions lOptions;
+
+        lOptions.Read( lPrivate );
+
+        mDriver.reset( new LeddarDriver( lNode, lPrivate, lOptions ) );
+        mDriver->Start();
+    }
+
+    std::unique_ptr<LeddarDriver> mDriver;
+};
+
+} // namespace leddartech
+
+PLUGINLIB_EXPORT_CLASS( leddartech::LeddarNodelet, nodelet::Nodelet )
+
+// End of file LeddarNodelet.cpp
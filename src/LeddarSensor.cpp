@@ -0,0 +1,2270 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    LeddarSensor.cpp
+///
+/// \brief   One Leddar sensor (or record) driven by the node.
+// *****************************************************************************
+
+#include "leddartech/LeddarSensor.h"
+
+#include <boost/bind.hpp>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/MultiEchoLaserScan.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <std_msgs/UInt64.h>
+
+#include <errno.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "LeddarProperties.h"
+#include "LeddarResults.h"
+#include "leddartech/RayTable.h"
+
+namespace leddartech
+{
+
+// *****************************************************************************
+// Function: LogError
+//
+/// \brief   Log the message of a LeddarC result code if it is not success.
+///
+/// \param   aName  Name of the sensor, for the log.
+/// \param   aCode  The result code to verify.
+// *****************************************************************************
+
+static void
+LogError( const std::string &aName, Result aResult )
+{
+    if ( !aResult.Ok() )
+    {
+        ROS_ERROR( "[%s] LeddarC error (%d): %s", aName.c_str(), aResult.Code(),
+                   aResult.Message().c_str() );
+    }
+}
+
+LeddarSensorOptions::LeddarSensorOptions( void )
+    : mReplayRate( 1 ),
+      mReplayStartStamp( 0 ),
+      mReplayWaitLoaded( false ),
+      mExitAtEnd( false ),
+      mFrameId( "leddar_base_link" ),
+      mCloudEchoes( 1 ),
+      mApplyTransform( false ),
+      mQueueSize( 8 ),
+      mDataLevels( LDDL_DETECTIONS ),
+      mAutostart( true ),
+      mPingPeriod( 0.5 ),
+      mStallTimeout( 1.0 ),
+      mReconnect( true ),
+      mReconnectBackoffMin( 0.1 ),
+      mReconnectBackoffMax( 5.0 ),
+      mConnectRetryPeriod( 0.1 ),
+      mConnectTimeout( 0 ),
+      mLatencyOffset( 0 ),
+      mLatencyReportPeriod( 10 ),
+      mDiagnosticsPeriod( 1 ),
+      mReconfigure( true ),
+      mFilter( "none" ),
+      mFilterWindow( 5 ),
+      mFilterAlpha( 0.3 ),
+      mFilterProcessNoise( 2.0 ),
+      mFilterMeasurementNoise( 0.05 ),
+      mFilterMinAmplitude( 0 ),
+      mBatchFrames( 0 ),
+      mBatchMaxLatency( 0 ),
+      mBatchEchoes( 1 ),
+      mPublishOnChange( false ),
+      mChangeDistanceDeadband( 1, 0.02 ),
+      mKeepAliveRate( 1.0 ),
+      mSensorZone( true ),
+      mShmSlots( 64 ),
+      mStartTime( ros::WallTime::now() )
+{
+}
+
+// *****************************************************************************
+// Function: ReadPerSegment
+//
+/// \brief   Read a parameter given either per segment, as a list, or as a
+///          single value for all segments. Kept when not set.
+// *****************************************************************************
+
+static void
+ReadPerSegment( const ros::NodeHandle &aPrivate, const std::string &aName,
+                std::vector<double> &aValues )
+{
+    double lValue;
+
+    if ( aPrivate.getParam( aName, lValue ) )
+    {
+        aValues.assign( 1, lValue );
+    }
+    else
+    {
+        aPrivate.getParam( aName, aValues );
+    }
+}
+
+// *****************************************************************************
+// Function: LeddarSensorOptions::Read
+//
+/// \brief   Override the options with the parameters set in a namespace,
+///          options without a parameter keep their current value.
+///
+/// \param   aPrivate  Namespace to read from.
+// *****************************************************************************
+
+void
+LeddarSensorOptions::Read( const ros::NodeHandle &aPrivate )
+{
+    aPrivate.param( "address", mAddress, mAddress );
+    aPrivate.param( "replay_file", mReplayFile, mReplayFile );
+    aPrivate.param( "replay_rate", mReplayRate, mReplayRate );
+    aPrivate.param( "replay_start_stamp", mReplayStartStamp, mReplayStartStamp );
+    aPrivate.param( "replay_wait_loaded", mReplayWaitLoaded, mReplayWaitLoaded );
+    aPrivate.param( "bag_file", mBagFile, mBagFile );
+    aPrivate.param( "exit_at_end", mExitAtEnd, mExitAtEnd );
+    aPrivate.param( "frame_id", mFrameId, mFrameId );
+    aPrivate.param( "cloud_frame_id", mCloudFrameId, mCloudFrameId );
+    aPrivate.param( "point_cloud_echoes", mCloudEchoes, mCloudEchoes );
+    aPrivate.param( "apply_global_transform", mApplyTransform, mApplyTransform );
+    aPrivate.param( "queue_size", mQueueSize, mQueueSize );
+    aPrivate.param( "data_levels", mDataLevels, mDataLevels );
+    aPrivate.param( "autostart", mAutostart, mAutostart );
+    aPrivate.param( "ping_period", mPingPeriod, mPingPeriod );
+    aPrivate.param( "stall_timeout", mStallTimeout, mStallTimeout );
+    aPrivate.param( "reconnect", mReconnect, mReconnect );
+    aPrivate.param( "reconnect_backoff_min", mReconnectBackoffMin, mReconnectBackoffMin );
+    aPrivate.param( "reconnect_backoff_max", mReconnectBackoffMax, mReconnectBackoffMax );
+    aPrivate.param( "connect_retry_period", mConnectRetryPeriod, mConnectRetryPeriod );
+    aPrivate.param( "connect_timeout", mConnectTimeout, mConnectTimeout );
+    aPrivate.param( "latency_offset", mLatencyOffset, mLatencyOffset );
+    aPrivate.param( "latency_report_period", mLatencyReportPeriod, mLatencyReportPeriod );
+    aPrivate.param( "diagnostics_period", mDiagnosticsPeriod, mDiagnosticsPeriod );
+    aPrivate.param( "reconfigure", mReconfigure, mReconfigure );
+    aPrivate.param( "filter", mFilter, mFilter );
+    aPrivate.param( "filter_window", mFilterWindow, mFilterWindow );
+    aPrivate.param( "filter_alpha", mFilterAlpha, mFilterAlpha );
+    aPrivate.param( "filter_process_noise", mFilterProcessNoise, mFilterProcessNoise );
+    aPrivate.param( "filter_measurement_noise", mFilterMeasurementNoise, mFilterMeasurementNoise );
+    aPrivate.param( "filter_min_amplitude", mFilterMinAmplitude, mFilterMinAmplitude );
+    aPrivate.param( "batch_frames", mBatchFrames, mBatchFrames );
+    aPrivate.param( "batch_max_latency", mBatchMaxLatency, mBatchMaxLatency );
+    aPrivate.param( "batch_echoes", mBatchEchoes, mBatchEchoes );
+    aPrivate.param( "publish_on_change", mPublishOnChange, mPublishOnChange );
+    ReadPerSegment( aPrivate, "change_distance_deadband", mChangeDistanceDeadband );
+    ReadPerSegment( aPrivate, "change_amplitude_deadband", mChangeAmplitudeDeadband );
+    aPrivate.param( "keep_alive_rate", mKeepAliveRate, mKeepAliveRate );
+    aPrivate.param( "sensor_zone", mSensorZone, mSensorZone );
+    ZoneMonitor::ReadZones( aPrivate, mZones );
+    AutoTuner::ReadSettings( aPrivate, mAutoTune );
+    RecorderSettings::Read( aPrivate, mRecord );
+    aPrivate.param( "shm_name", mShmName, mShmName );
+    aPrivate.param( "shm_slots", mShmSlots, mShmSlots );
+}
+
+// *****************************************************************************
+// Function: ConfigFromProperties
+//
+/// \brief   Fill a dynamic_reconfigure configuration from the cache. Fields
+///          for properties the sensor does not have keep their value.
+// *****************************************************************************
+
+static void
+ConfigFromProperties( const PropertyCache &aProperties, LeddarConfig &aConfig )
+{
+    aProperties.GetText( PID_NAME, 0, aConfig.name );
+    aConfig.led_intensity = aProperties.Value( PID_LED_INTENSITY, 0, aConfig.led_intensity );
+    aConfig.automatic_led_intensity = aProperties.Value( PID_AUTOMATIC_LED_INTENSITY, 0,
+                                                         aConfig.automatic_led_intensity ) != 0;
+    aConfig.oversampling_exponent = aProperties.Value( PID_OVERSAMPLING_EXPONENT, 0,
+                                                       aConfig.oversampling_exponent );
+    aConfig.accumulation_exponent = aProperties.Value( PID_ACCUMULATION_EXPONENT, 0,
+                                                       aConfig.accumulation_exponent );
+    aConfig.base_point_count = aProperties.Value( PID_BASE_POINT_COUNT, 0, aConfig.base_point_count );
+    aConfig.threshold_offset = aProperties.Value( PID_THRESHOLD_OFFSET, 0, aConfig.threshold_offset );
+    aConfig.change_delay = aProperties.Value( PID_CHANGE_DELAY, 0, aConfig.change_delay );
+    aConfig.object_demerging = aProperties.Value( PID_OBJECT_DEMERGING, 0,
+                                                  aConfig.object_demerging ) != 0;
+    aConfig.measurement_rate = aProperties.Value( PID_MEASUREMENT_RATE, 0, aConfig.measurement_rate );
+    aConfig.zone_enabled = aProperties.Value( PID_ZONE_ENABLED, 0, aConfig.zone_enabled ) != 0;
+    aConfig.zone_near_limit = aProperties.Value( PID_ZONE_NEAR_LIMIT, 0, aConfig.zone_near_limit );
+    aConfig.zone_far_limit = aProperties.Value( PID_ZONE_FAR_LIMIT, 0, aConfig.zone_far_limit );
+    aConfig.zone_rising_debounce = aProperties.Value( PID_ZONE_RISING_DEBOUNCE, 0,
+                                                      aConfig.zone_rising_debounce );
+    aConfig.zone_falling_debounce = aProperties.Value( PID_ZONE_FALLING_DEBOUNCE, 0,
+                                                       aConfig.zone_falling_debounce );
+}
+
+/// \brief   Queue a write if the sensor has the property and aValue differs.
+static void
+AddChanged( const PropertyCache &aProperties, unsigned int aId, double aValue,
+            std::vector<PropertyWrite> &aWrites )
+{
+    double lCurrent;
+
+    if ( aProperties.Get( aId, 0, lCurrent ) && ( lCurrent != aValue ) )
+    {
+        aWrites.push_back( PropertyWrite( aId, 0, aValue ) );
+    }
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::LeddarSensor
+//
+/// \brief   Create the handle, advertise the topics and start the publisher
+///          thread. Nothing is connected yet.
+///
+/// \param   aName     Name of the sensor, used as namespace for its topics
+///                    and parameters. Empty to use the node namespace.
+/// \param   aOptions  Settings of the sensor.
+/// \param   aNode     Node handle for the topics.
+/// \param   aPrivate  Private node handle of the node.
+// *****************************************************************************
+
+LeddarSensor::LeddarSensor( const std::string &aName, const LeddarSensorOptions &aOptions,
+                            ros::NodeHandle &aNode, ros::NodeHandle &aPrivate )
+    : mName( aName ),
+      mLabel( aName.empty() ? "leddar" : aName ),
+      mOptions( aOptions ),
+      mDataHandler( this ),
+      mTopics( aNode, aName ),
+      mPrivate( aPrivate, aName ),
+      mStreaming( false ),
+      mWantStreaming( false ),
+      mFirstFrame( true ),
+      mMeasurementRate( LD_MEASUREMENT_RATE_12_5 ),
+      mAbortOpen( false ),
+      mPropertiesWritten( false ),
+      mWatchdogStop( false ),
+      mWatchdogState( WATCHDOG_OFF ),
+      mReconnects( 0 ),
+      mLastDowntime( 0 ),
+      mTotalDowntime( 0 ),
+      mReplaying( false ),
+      mReplayRunning( false ),
+      mReplayStartCount( 0 ),
+      mReplayIndex( 0 ),
+      mKnownRecordSize( 0 ),
+      mTuning( false ),
+      mTuneAbort( false ),
+      mFrameLoop( NULL ),
+      mFrameEvents( 0 ),
+      mRing( aOptions.mQueueSize ),
+      mRunning( true ),
+      mPublished( 0 ),
+      mPublishedWaiters( 0 ),
+      mSuppressed( 0 ),
+      mKeepAlives( 0 ),
+      mTruncated( 0 ),
+      mLastDropped( 0 ),
+      mLastMonotonic( 0 ),
+      mDiagnosticsPublished( 0 ),
+      mDiagnosticsDropped( 0 ),
+      mDiagnosticsSuppressed( 0 ),
+      mSequence( 0 ),
+      mBagOpen( false )
+{
+    mStampFilter.SetLatencyOffset( mOptions.mLatencyOffset );
+
+    mScanPublisher = mTopics.advertise<sensor_msgs::LaserScan>( "leddar_scan", 1 );
+    mMultiEchoPublisher = mTopics.advertise<sensor_msgs::MultiEchoLaserScan>( "leddar_multi_echo_scan", 1 );
+    mCloudPublisher = mTopics.advertise<sensor_msgs::PointCloud2>( "leddar_cloud", 1 );
+    mDroppedPublisher = mPrivate.advertise<std_msgs::UInt64>( "dropped_frames", 1, true );
+
+    if ( !mOptions.mReplayFile.empty() )
+    {
+        mRecordSizePublisher = mPrivate.advertise<std_msgs::UInt64>( "record_size", 1, true );
+    }
+    mZonePublisher = mTopics.advertise<leddartech::ZoneEvent>( "leddar_zone_events", 16, true );
+
+    if ( ( mOptions.mBatchFrames > 0 ) || ( mOptions.mBatchMaxLatency > 0 ) )
+    {
+        mBatchPublisher = mTopics.advertise<leddartech::ScanBatch>( "leddar_scan_batch", 4 );
+    }
+
+    mOverflowTimer = mPrivate.createWallTimer( ros::WallDuration( 1.0 ),
+                                               &LeddarSensor::OverflowTimer, this );
+
+    if ( mOptions.mDiagnosticsPeriod > 0 )
+    {
+        mDiagnosticsPublisher = aNode.advertise<diagnostic_msgs::DiagnosticArray>( "/diagnostics", 1 );
+        mDiagnosticsTime = ros::WallTime::now();
+        mDiagnosticsTimer = mPrivate.createWallTimer( ros::WallDuration( mOptions.mDiagnosticsPeriod ),
+                                                      &LeddarSensor::DiagnosticsTimer, this );
+    }
+
+    sem_init( &mFrameReady, 0, 0 );
+    mPublisherThread = std::thread( &LeddarSensor::PublisherThread, this );
+}
+
+LeddarSensor::~LeddarSensor( void )
+{
+    Close();
+
+    mRunning = false;
+    sem_post( &mFrameReady );
+    mPublisherThread.join();
+    sem_destroy( &mFrameReady );
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::Open
+//
+/// \brief   Load the replay file if one is set, otherwise connect to the
+///          sensor address. The connection is retried quickly until the
+///          timeout since the sensor may still be enumerating on a cold
+///          boot; no LeddarListSensors scan is needed.
+///
+///          AbortOpen makes it give up from another thread.
+///
+/// \return  True if connected (or loaded).
+// *****************************************************************************
+
+bool
+LeddarSensor::Open( void )
+{
+    if ( !mOptions.mReplayFile.empty() )
+    {
+        // Both kinds of record are indexed in the background, frames can be
+        // replayed as soon as the first ones are known.
+        const bool lOpened = RecordReader::IsRecord( mOptions.mReplayFile )
+                             ? mReader.Open( mOptions.mReplayFile )
+                             : mDevice.LoadRecord( mOptions.mReplayFile ).Ok();
+
+        if ( !lOpened )
+        {
+            ROS_FATAL( "[%s] Failed to load record %s.", mLabel.c_str(),
+                       mOptions.mReplayFile.c_str() );
+            return false;
+        }
+
+        if ( mOptions.mReplayWaitLoaded )
+        {
+            mReader.WaitIndexed();
+
+            while( mDevice.RecordLoading() )
+            {
+                ros::WallDuration( 0.01 ).sleep();
+            }
+        }
+
+        ROS_INFO( "[%s] Record %s opened, %llu frames known %.3f s after startup.", mLabel.c_str(),
+                  mOptions.mReplayFile.c_str(), (unsigned long long) RecordSize(),
+                  ( ros::WallTime::now() - mOptions.mStartTime ).toSec() );
+
+        return true;
+    }
+
+    const ros::WallTime lDeadline = ros::WallTime::now()
+                                    + ros::WallDuration( mOptions.mConnectTimeout );
+
+    while( !mDevice.Connect( mOptions.mAddress ).Ok() )
+    {
+        if ( !ros::ok() || mAbortOpen.load()
+             || ( ( mOptions.mConnectTimeout > 0 ) && ( ros::WallTime::now() > lDeadline ) ) )
+        {
+            ROS_FATAL( "[%s] Could not connect to Leddar sensor \"%s\".", mLabel.c_str(),
+                       mOptions.mAddress.c_str() );
+            return false;
+        }
+
+        ros::WallDuration( mOptions.mConnectRetryPeriod ).sleep();
+    }
+
+    ROS_INFO( "[%s] Connected to Leddar sensor \"%s\" %.3f s after startup.", mLabel.c_str(),
+              mOptions.mAddress.c_str(), ( ros::WallTime::now() - mOptions.mStartTime ).toSec() );
+
+    return true;
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::Activate
+//
+/// \brief   Headless operation once opened: configure, advertise the start
+///          and stop services, start supervising the connection (or stepping
+///          through the record) and start streaming if autostart is set.
+// *****************************************************************************
+
+void
+LeddarSensor::Activate( void )
+{
+    Configure();
+
+    mStartServer = mPrivate.advertiseService( "start", &LeddarSensor::StartService, this );
+    mStopServer = mPrivate.advertiseService( "stop", &LeddarSensor::StopService, this );
+    mStartRecordingServer = mPrivate.advertiseService( "start_recording",
+                                                       &LeddarSensor::StartRecordingService, this );
+    mStopRecordingServer = mPrivate.advertiseService( "stop_recording",
+                                                      &LeddarSensor::StopRecordingService, this );
+
+    if ( !mOptions.mRecord.mDirectory.empty() )
+    {
+        StartRecording();
+    }
+
+    // Before streaming starts: the publisher thread writes to it unlocked.
+    if ( !mOptions.mShmName.empty()
+         && mShm.Open( mOptions.mShmName, std::max( mOptions.mShmSlots, 2 ),
+                       mScanBuilder.SegmentCount() ) )
+    {
+        ROS_INFO( "[%s] Writing the frames to the shared memory %s (%d frames).", mLabel.c_str(),
+                  mShm.Name().c_str(), std::max( mOptions.mShmSlots, 2 ) );
+    }
+
+    if ( !mOptions.mReplayFile.empty() )
+    {
+        if ( !mOptions.mBagFile.empty() )
+        {
+            OpenBag();
+        }
+
+        // The record can be replayed while it is loading, so we step at a
+        // multiple of the rate it was recorded at instead of waiting for the
+        // load to end. As fast as possible is throttled by the ring only.
+        if ( mOptions.mReplayRate > 0 )
+        {
+            mTimer = mPrivate.createWallTimer(
+                         ros::WallDuration( 1.0 / ( mMeasurementRate * mOptions.mReplayRate ) ),
+                         &LeddarSensor::ReplayTimer, this );
+        }
+        else
+        {
+            mReplayRunning = true;
+            mReplayThread = std::thread( &LeddarSensor::ReplayThread, this );
+        }
+    }
+    else
+    {
+        mWatchdogState = WATCHDOG_CONNECTED;
+        mWatchdogThread = std::thread( &LeddarSensor::WatchdogThread, this );
+        mAutoTuneServer = mPrivate.advertiseService( "auto_tune", &LeddarSensor::AutoTuneService,
+                                                     this );
+
+        if ( mOptions.mReconfigure )
+        {
+            LeddarConfig lConfig;
+
+            ConfigFromProperties( mProperties, lConfig );
+            mReconfigureServer.reset( new ReconfigureServer( mReconfigureMutex, mPrivate ) );
+            mReconfigureServer->updateConfig( lConfig );
+            mReconfigureServer->setCallback( boost::bind( &LeddarSensor::ReconfigureCallback,
+                                                          this, _1, _2 ) );
+        }
+    }
+
+    if ( mOptions.mAutostart )
+    {
+        StartStreaming();
+    }
+
+    if ( mOptions.mAutoTune.mAtStart && mOptions.mReplayFile.empty() )
+    {
+        StartAutoTune();
+    }
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::Close
+//
+/// \brief   Stop streaming, flush the bag and disconnect (or close the
+///          record).
+// *****************************************************************************
+
+void
+LeddarSensor::Close( void )
+{
+    mTimer.stop();
+    mTuneAbort = true;
+    WakeTuner();
+
+    if ( mTuneThread.joinable() )
+    {
+        mTuneThread.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lLock( mWatchdogMutex );
+        mWatchdogStop = true;
+    }
+
+    mWatchdogWake.notify_all();
+
+    if ( mWatchdogThread.joinable() )
+    {
+        mWatchdogThread.join();
+    }
+
+    mWatchdogState = WATCHDOG_OFF;
+    mReplayRunning = false;
+
+    if ( mReplayThread.joinable() )
+    {
+        mReplayThread.join();
+    }
+
+    StopStreaming();
+    WaitPublished();
+    StopRecording();
+    mShm.Close();
+    FlushBatch();
+    CloseBag();
+    mReader.Close();
+    mDevice.Disconnect();
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::GetSegmentCount
+//
+/// \brief   Find the number of segments of the connected sensor (or record)
+///          by probing the indexed PID_SEGMENT_LEFT property.
+///
+/// \return  The segment count, 16 if it could not be determined.
+// *****************************************************************************
+
+unsigned int
+LeddarSensor::GetSegmentCount( void )
+{
+    double       lValue;
+    unsigned int lCount = 0;
+
+    if ( mReader.IsOpen() && ( mReader.SegmentCount() > 0 ) )
+    {
+        return mReader.SegmentCount();
+    }
+
+    while( ( lCount < LEDDAR_MAX_SEGMENTS )
+           && mDevice.GetProperty( PID_SEGMENT_LEFT, lCount, lValue ).Ok() )
+    {
+        ++lCount;
+    }
+
+    return lCount > 0 ? lCount : 16;
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::Configure
+//
+/// \brief   Read the properties and segment geometry of the connected
+///          sensor, allocate the messages and reset the stamp estimation.
+///          Must be called before the data transfer is started.
+///          Runs under mControlMutex: the watchdog and property writes use
+///          the device, and the publisher thread applies written properties
+///          under it too.
+// *****************************************************************************
+
+void
+LeddarSensor::Configure( void )
+{
+    std::lock_guard<std::mutex> lLock( mControlMutex );
+
+    const unsigned int lSegmentCount = GetSegmentCount();
+
+    mProperties.Load( mDevice, lSegmentCount );
+    mPropertiesWritten = false;
+
+    // Replayed frames are stamped from their index in the record since the
+    // time they are stepped at has nothing to do with their acquisition.
+    mReplaying = !mOptions.mReplayFile.empty() || ( mDevice.RecordSize() != 0 );
+    mReplayIndex = 0;
+    mReplayOrigin = ( mOptions.mReplayStartStamp > 0 ) ? ros::Time( mOptions.mReplayStartStamp )
+                                                       : ros::Time::now();
+
+    RayTable lRays;
+
+    if ( !lRays.Load( mDevice, lSegmentCount, mOptions.mApplyTransform ) )
+    {
+        ROS_WARN( "[%s] Segment geometry not available, assuming a %g degrees field of view.",
+                  mLabel.c_str(), lRays.Model() != NULL ? lRays.Model()->mFieldOfView : 45.0 );
+    }
+    else if ( lRays.Model() != NULL )
+    {
+        ROS_INFO( "[%s] Sensor model %s, %u segments over %g degrees.", mLabel.c_str(),
+                  lRays.Model()->mName, lSegmentCount, lRays.Model()->mFieldOfView );
+    }
+
+    mScanBuilder.Configure( lRays, mOptions.mFrameId,
+                            mOptions.mCloudFrameId.empty() ? mOptions.mFrameId
+                                                           : mOptions.mCloudFrameId,
+                            mOptions.mCloudEchoes );
+
+    // Grows to the most zone transitions of a frame held by subscribers.
+    mZoneEvents.Reset( ZoneEvent(), 4 );
+
+    ApplyProperties();
+
+    // Without a frame count, size the batches for the latency window.
+    unsigned int lBatchFrames = std::max( mOptions.mBatchFrames, 0 );
+
+    if ( ( lBatchFrames == 0 ) && ( mOptions.mBatchMaxLatency > 0 ) )
+    {
+        lBatchFrames = std::ceil( mOptions.mBatchMaxLatency * mMeasurementRate ) + 1;
+    }
+
+    mBatcher.Configure( lRays, mOptions.mFrameId, mOptions.mBatchEchoes, lBatchFrames,
+                        mOptions.mBatchMaxLatency );
+
+    mChangeGate.Configure( mOptions.mPublishOnChange, mOptions.mChangeDistanceDeadband,
+                           mOptions.mChangeAmplitudeDeadband, mOptions.mKeepAliveRate );
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::ApplyProperties
+//
+/// \brief   Update what depends on writable properties from the cache: the
+///          measurement rate (stamp estimation and temporal filter) and the
+///          detection zone of the sensor. Called by Configure, and by the
+///          publisher thread after a write so streaming goes on, always with
+///          mControlMutex held.
+// *****************************************************************************
+
+void
+LeddarSensor::ApplyProperties( void )
+{
+    double lRate = mProperties.Value( PID_MEASUREMENT_RATE, 0, 0 );
+
+    // Our records do not have the properties, the stamps give the rate.
+    if ( mReader.IsOpen() && ( mReader.Rate() > 0 ) )
+    {
+        lRate = mReader.Rate();
+    }
+
+    if ( lRate <= 0 )
+    {
+        lRate = LD_MEASUREMENT_RATE_12_5;
+    }
+
+    mMeasurementRate = lRate;
+    mStampFilter.Reset( 1.0 / lRate );
+
+    TemporalFilter::Mode lFilterMode;
+
+    if ( !TemporalFilter::ParseMode( mOptions.mFilter, lFilterMode ) )
+    {
+        ROS_WARN( "[%s] Unknown filter \"%s\", not filtering.", mLabel.c_str(),
+                  mOptions.mFilter.c_str() );
+        lFilterMode = TemporalFilter::FILTER_NONE;
+    }
+
+    mFilter.Configure( lFilterMode, mOptions.mFilterWindow, mOptions.mFilterAlpha,
+                       mOptions.mFilterProcessNoise, mOptions.mFilterMeasurementNoise,
+                       1.0 / lRate );
+
+    std::vector<ZoneSettings> lZones( mOptions.mZones );
+    ZoneSettings              lSensorZone;
+
+    if (    mOptions.mSensorZone && ( lZones.size() < ZoneMonitor::kMaxZones )
+         && ZoneMonitor::ReadSensorZone( mProperties, mScanBuilder.SegmentCount(), lSensorZone ) )
+    {
+        lZones.push_back( lSensorZone );
+    }
+
+    mZoneMonitor.Configure( lZones );
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::SetFrameEvents
+//
+/// \brief   Post events to a loop when a frame is received. Posts of an
+///          event still pending are merged, so the loop wakes up at most
+///          once per frame and the data callback rarely makes a system call.
+///
+/// \param   aLoop    Loop to wake up, null to stop.
+/// \param   aEvents  Events to post. Only changed along with the loop.
+// *****************************************************************************
+
+void
+LeddarSensor::SetFrameEvents( EventLoop *aLoop, uint32_t aEvents )
+{
+    if ( aLoop != NULL )
+    {
+        mFrameEvents = aEvents;
+    }
+
+    mFrameLoop.store( aLoop, std::memory_order_release );
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::WriteProperties
+//
+/// \brief   Set a batch of properties and write the configuration once,
+///          rolling back on failure (see PropertyCache::Write). Streaming
+///          goes on: the publisher thread picks up the new rate and zone
+///          before its next frame.
+///
+/// \param   aWrites  Properties to set.
+///
+/// \return  LD_SUCCESS or the LeddarC error, LD_NOT_CONNECTED while
+///          reconnecting (Reconnect reloads the properties).
+// *****************************************************************************
+
+int
+LeddarSensor::WriteProperties( const std::vector<PropertyWrite> &aWrites )
+{
+    Result lResult;
+
+    {
+        std::lock_guard<std::mutex> lLock( mControlMutex );
+
+        if ( mWatchdogState.load() == WATCHDOG_RECONNECTING )
+        {
+            return LD_NOT_CONNECTED;
+        }
+
+        lResult = mProperties.Write( mDevice, aWrites );
+        mPropertiesWritten = true;
+    }
+
+    LogError( mLabel, lResult );
+    sem_post( &mFrameReady );
+
+    return lResult.Code();
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::ReconfigureCallback
+//
+/// \brief   Write the properties changed in a dynamic_reconfigure request as
+///          one batch, then report what the sensor actually has, so values
+///          it clamped or a rolled back batch show up in the client. Requests
+///          are ignored while auto-tuning.
+// *****************************************************************************
+
+void
+LeddarSensor::ReconfigureCallback( LeddarConfig &aConfig, uint32_t )
+{
+    std::vector<PropertyWrite> lWrites;
+    std::string                lName;
+
+    if ( mProperties.GetText( PID_NAME, 0, lName ) && ( lName != aConfig.name ) )
+    {
+        lWrites.push_back( PropertyWrite( PID_NAME, 0, aConfig.name ) );
+    }
+
+    AddChanged( mProperties, PID_LED_INTENSITY, aConfig.led_intensity, lWrites );
+    AddChanged( mProperties, PID_AUTOMATIC_LED_INTENSITY, aConfig.automatic_led_intensity, lWrites );
+    AddChanged( mProperties, PID_OVERSAMPLING_EXPONENT, aConfig.oversampling_exponent, lWrites );
+    AddChanged( mProperties, PID_ACCUMULATION_EXPONENT, aConfig.accumulation_exponent, lWrites );
+    AddChanged( mProperties, PID_BASE_POINT_COUNT, aConfig.base_point_count, lWrites );
+    AddChanged( mProperties, PID_THRESHOLD_OFFSET, aConfig.threshold_offset, lWrites );
+    AddChanged( mProperties, PID_CHANGE_DELAY, aConfig.change_delay, lWrites );
+    AddChanged( mProperties, PID_OBJECT_DEMERGING, aConfig.object_demerging, lWrites );
+    AddChanged( mProperties, PID_MEASUREMENT_RATE, aConfig.measurement_rate, lWrites );
+    AddChanged( mProperties, PID_ZONE_ENABLED, aConfig.zone_enabled, lWrites );
+    AddChanged( mProperties, PID_ZONE_NEAR_LIMIT, aConfig.zone_near_limit, lWrites );
+    AddChanged( mProperties, PID_ZONE_FAR_LIMIT, aConfig.zone_far_limit, lWrites );
+    AddChanged( mProperties, PID_ZONE_RISING_DEBOUNCE, aConfig.zone_rising_debounce, lWrites );
+    AddChanged( mProperties, PID_ZONE_FALLING_DEBOUNCE, aConfig.zone_falling_debounce, lWrites );
+
+    if ( !lWrites.empty() && ( mWatchdogState == WATCHDOG_CONNECTED ) && !mTuning.load() )
+    {
+        WriteProperties( lWrites );
+    }
+
+    ConfigFromProperties( mProperties, aConfig );
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::StartStreaming
+//
+/// \brief   Register the data callback and start the data transfer with the
+///          configured data levels.
+///
+/// \return  True if the transfer is started.
+// *****************************************************************************
+
+bool
+LeddarSensor::StartStreaming( void )
+{
+    std::lock_guard<std::mutex> lLock( mControlMutex );
+
+    mWantStreaming = true;
+    return StartTransfer();
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::StartTransfer
+//
+/// \brief   StartStreaming without changing what the user asked for, used
+///          to restore streaming after a reconnection. mControlMutex must be
+///          held.
+///
+/// \return  True if the transfer is started.
+// *****************************************************************************
+
+bool
+LeddarSensor::StartTransfer( void )
+{
+    if ( mStreaming )
+    {
+        return true;
+    }
+
+    // Frames of our records are pushed by StepRecord, not by the SDK.
+    Result lResult = mReader.IsOpen() ? Result() : mDevice.AddCallback( mDataHandler );
+
+    if ( lResult.Ok() && !mReader.IsOpen() )
+    {
+        lResult = mDevice.StartDataTransfer( mOptions.mDataLevels );
+
+        if ( !lResult.Ok() )
+        {
+            mDevice.RemoveCallback( mDataHandler );
+        }
+    }
+
+    LogError( mLabel, lResult );
+    mStreaming = lResult.Ok();
+    mReplayStartTime = ros::WallTime::now();
+    mReplayStartCount = mPublished.load();
+
+    return mStreaming;
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::StopStreaming
+//
+/// \brief   Stop the data transfer and unregister the data callback.
+// *****************************************************************************
+
+void
+LeddarSensor::StopStreaming( void )
+{
+    std::lock_guard<std::mutex> lLock( mControlMutex );
+
+    mWantStreaming = false;
+    StopTransfer();
+}
+
+/// \brief   StopStreaming without changing what the user asked for.
+///          mControlMutex must be held.
+void
+LeddarSensor::StopTransfer( void )
+{
+    if ( mStreaming )
+    {
+        if ( !mReader.IsOpen() )
+        {
+            mDevice.StopDataTransfer();
+            mDevice.RemoveCallback( mDataHandler );
+        }
+
+        mStreaming = false;
+    }
+}
+
+bool
+LeddarSensor::StartService( std_srvs::Empty::Request &, std_srvs::Empty::Response & )
+{
+    return StartStreaming();
+}
+
+bool
+LeddarSensor::StopService( std_srvs::Empty::Request &, std_srvs::Empty::Response & )
+{
+    StopStreaming();
+    return true;
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::StartRecording
+//
+/// \brief   Record the processed frames (see FrameRecorder), to the record
+///          directory or the current one if it is not set.
+///
+/// \return  False if the record could not be created.
+// *****************************************************************************
+
+bool
+LeddarSensor::StartRecording( void )
+{
+    RecorderSettings lSettings = mOptions.mRecord;
+
+    if ( lSettings.mDirectory.empty() )
+    {
+        lSettings.mDirectory = ".";
+    }
+
+    if ( !mRecorder.Open( lSettings, mScanBuilder.SegmentCount() ) )
+    {
+        return false;
+    }
+
+    ROS_INFO( "[%s] Recording to %s.", mLabel.c_str(), mRecorder.FileName().c_str() );
+    return true;
+}
+
+void
+LeddarSensor::StopRecording( void )
+{
+    if ( mRecorder.Active() )
+    {
+        mRecorder.Close();
+        ROS_INFO( "[%s] Recorded %llu frames (%llu dropped) in %u files, %.1f MB.", mLabel.c_str(),
+                  (unsigned long long) mRecorder.Frames(), (unsigned long long) mRecorder.Dropped(),
+                  mRecorder.Files(), mRecorder.StoredBytes() * 1e-6 );
+    }
+}
+
+bool
+LeddarSensor::StartRecordingService( std_srvs::Empty::Request &, std_srvs::Empty::Response & )
+{
+    return mRecorder.Active() || StartRecording();
+}
+
+bool
+LeddarSensor::StopRecordingService( std_srvs::Empty::Request &, std_srvs::Empty::Response & )
+{
+    StopRecording();
+    return true;
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::OnData
+//
+/// \brief   Called by LeddarC when a new set of data is available. It runs on
+///          the LeddarC worker thread of this sensor (or on the thread
+///          stepping the record) so it only fetches the detections straight
+///          into a slot of the ring and wakes up the publisher thread.
+///
+/// \param   aLevels  A bitmask of the data levels received in that frame.
+///
+/// \return  True to be called again.
+// *****************************************************************************
+
+bool
+LeddarSensor::OnData( LeddarU32 aLevels )
+{
+    // Taken first so the stamp only includes the SDK delivery latency.
+    const ros::Time lArrival = ros::Time::now();
+    const double    lStart = MonotonicSeconds();
+
+    if ( mFirstFrame )
+    {
+        mFirstFrame = false;
+        ROS_INFO( "[%s] First frame received %.3f s after startup.", mLabel.c_str(),
+                  ( ros::WallTime::now() - mOptions.mStartTime ).toSec() );
+    }
+
+    LeddarFrame *lFrame = mRing.BeginPush();
+
+    // The publisher thread is lagging behind: drop the frame (the ring
+    // counts it) rather than delaying the SDK.
+    if ( lFrame == NULL )
+    {
+        return true;
+    }
+
+    lFrame->mArrival = lArrival;
+    lFrame->mMonotonic = lStart;
+    lFrame->mLevels = aLevels;
+    lFrame->mRecordIndex = ( mDevice.RecordSize() != 0 ) ? mDevice.RecordIndex() : 0;
+
+    const double lFetch = MonotonicSeconds();
+
+    // A frame can only hold every echo of every segment.
+    if ( mDevice.DetectionCount() > LEDDAR_MAX_DETECTIONS )
+    {
+        mTruncated.fetch_add( 1 );
+    }
+
+    lFrame->mCount = mDevice.Detections( lFrame->mDetections ).Size();
+
+    const double lFetched = MonotonicSeconds();
+
+    mRing.EndPush();
+    sem_post( &mFrameReady );
+
+    EventLoop *lLoop = mFrameLoop.load( std::memory_order_acquire );
+
+    if ( lLoop != NULL )
+    {
+        lLoop->Post( mFrameEvents );
+    }
+
+    mStats.mStages[STAGE_FETCH].Add( lFetched - lFetch );
+    mStats.mStages[STAGE_CALLBACK].Add( MonotonicSeconds() - lStart );
+
+    return true;
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::PublisherThread
+//
+/// \brief   Drain the ring and publish every frame, off the SDK thread.
+///          Sleeps on the semaphore posted by OnData.
+// *****************************************************************************
+
+void
+LeddarSensor::PublisherThread( void )
+{
+    while( mRunning.load() )
+    {
+        if ( ( sem_wait( &mFrameReady ) != 0 ) && ( errno == EINTR ) )
+        {
+            continue;
+        }
+
+        if ( mPropertiesWritten.load() )
+        {
+            std::lock_guard<std::mutex> lLock( mControlMutex );
+
+            // Configure (on reconnection) may have applied them meanwhile.
+            if ( mPropertiesWritten.exchange( false ) )
+            {
+                ApplyProperties();
+            }
+        }
+
+        LeddarFrame *lFrame;
+
+        while( ( lFrame = mRing.Front() ) != NULL )
+        {
+            PublishFrame( *lFrame );
+            mRing.Pop();
+            mPublished.fetch_add( 1 );
+
+            // Only a system call when someone waits for room in the ring.
+            if ( mPublishedWaiters.load() > 0 )
+            {
+                std::lock_guard<std::mutex> lLock( mPublishedMutex );
+
+                mPublishedWake.notify_all();
+            }
+        }
+    }
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::PublishFrame
+//
+/// \brief   Bin the detections of a frame by segment, stamp and publish them
+///          (or write them to the bag), timing each stage.
+///          The messages come from the pools of the scan builder and are
+///          published as shared pointers, so nothing is allocated here and
+///          subscribers in the same process (nodelets) get them without copy.
+///
+/// \param   aFrame  Frame taken from the ring.
+// *****************************************************************************
+
+void
+LeddarSensor::PublishFrame( const LeddarFrame &aFrame )
+{
+    const double lDequeued = MonotonicSeconds();
+
+    mStats.mStages[STAGE_QUEUE].Add( lDequeued - aFrame.mMonotonic );
+
+    if ( mLastMonotonic > 0 )
+    {
+        mStats.mStages[STAGE_FRAME_GAP].Add( aFrame.mMonotonic - mLastMonotonic );
+    }
+
+    mLastMonotonic = aFrame.mMonotonic;
+
+    BinDetections( aFrame, mScanBuilder.SegmentCount(), mSegmentFrame,
+                   mOptions.mFilterMinAmplitude );
+
+    // Binning is part of the build, the messages are added to it.
+    double lBuildTime = MonotonicSeconds() - lDequeued;
+    double lPublishTime = 0;
+
+    // The tuner measures the sensor noise, before the temporal filter.
+    mTuner.Add( mSegmentFrame, aFrame.mMonotonic );
+
+    if ( mTuning.load() )
+    {
+        WakeTuner();
+    }
+
+    const double lFilterStart = MonotonicSeconds();
+
+    mFilter.Apply( mSegmentFrame );
+
+    const double lFilterTime = MonotonicSeconds() - lFilterStart;
+
+    if ( mReader.IsOpen() )
+    {
+        // Our records keep the stamps, shifted to start at the origin.
+        mSegmentFrame.mStamp = mReplayOrigin + ( aFrame.mArrival - mReader.FirstStamp() );
+    }
+    else if ( mReplaying )
+    {
+        mSegmentFrame.mStamp = mReplayOrigin
+                               + ros::Duration( aFrame.mRecordIndex / mMeasurementRate );
+    }
+    else
+    {
+        mSegmentFrame.mStamp = mStampFilter.Update( aFrame.mArrival );
+    }
+
+    mStats.mStages[STAGE_FILTER].Add( lFilterTime );
+
+    // Every output counts as publishing, the shared memory and the recorder
+    // included.
+    const double lPublishStart = MonotonicSeconds();
+
+    // Shared memory readers first, nothing to wait for on their side.
+    if ( mShm.Active() )
+    {
+        mShm.Write( mSegmentFrame );
+    }
+
+    if ( mRecorder.Active() )
+    {
+        mRecorder.Add( mSegmentFrame );
+    }
+
+    // Zone events go out before the scans: their consumers react to them.
+    if ( mZoneMonitor.ZoneCount() > 0 )
+    {
+        PublishZoneEvents();
+    }
+
+    // Batches get every frame, whether or not it is published on its own.
+    if ( mBatcher.Enabled() )
+    {
+        PublishBatch();
+    }
+
+    lPublishTime += MonotonicSeconds() - lPublishStart;
+
+    switch( mChangeGate.Check( mSegmentFrame ) )
+    {
+        case ChangeGate::GATE_SUPPRESSED:
+            mSuppressed.fetch_add( 1 );
+            mStats.mStages[STAGE_BUILD].Add( lBuildTime );
+            mStats.mStages[STAGE_PUBLISH].Add( lPublishTime );
+            return;
+        case ChangeGate::GATE_KEEP_ALIVE:
+            mKeepAlives.fetch_add( 1 );
+            break;
+        default:
+            break;
+    }
+
+    PublishMessage<sensor_msgs::LaserScan>( mScanPublisher, true, &ScanBuilder::Build,
+                                            lBuildTime, lPublishTime );
+    PublishMessage<sensor_msgs::MultiEchoLaserScan>( mMultiEchoPublisher, false,
+                                                     &ScanBuilder::BuildMultiEcho,
+                                                     lBuildTime, lPublishTime );
+    PublishMessage<sensor_msgs::PointCloud2>( mCloudPublisher, false, &ScanBuilder::BuildCloud,
+                                              lBuildTime, lPublishTime );
+
+    ++mSequence;
+
+    mStats.mStages[STAGE_BUILD].Add( lBuildTime );
+    mStats.mStages[STAGE_PUBLISH].Add( lPublishTime );
+    mStats.mStages[STAGE_TOTAL].Add( MonotonicSeconds() - aFrame.mMonotonic );
+
+    // Replayed stamps are reconstructed (or recorded, for .ldrec files), only
+    // the processing time since the frame was taken is meaningful then.
+    if ( mReplaying )
+    {
+        mLatency.Add( MonotonicSeconds() - aFrame.mMonotonic );
+    }
+    else
+    {
+        mLatency.Add( ( ros::Time::now() - mSegmentFrame.mStamp ).toSec() );
+    }
+
+    if ( mOptions.mLatencyReportPeriod > 0 )
+    {
+        const ros::WallTime lNow = ros::WallTime::now();
+
+        if ( lNow > mLatencyReportTime )
+        {
+            ReportLatency();
+            mLatencyReportTime = lNow + ros::WallDuration( mOptions.mLatencyReportPeriod );
+        }
+    }
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::PublishMessage
+//
+/// \brief   Build one message of the current frame and publish it, or write
+///          it to the bag under the topic it would be published on. On a
+///          bag error the bag is closed and the frames are published
+///          instead.
+///
+/// \param   aPublisher    Publisher of the message.
+/// \param   aAlways       Build it even without subscribers.
+/// \param   aBuild        ScanBuilder method building the message.
+/// \param   aBuildTime    Time spent building is added to it.
+/// \param   aPublishTime  Time spent publishing is added to it.
+// *****************************************************************************
+
+template< typename M >
+void
+LeddarSensor::PublishMessage( ros::Publisher &aPublisher, bool aAlways,
+                              boost::shared_ptr<const M> ( ScanBuilder::*aBuild )( const SegmentFrame &,
+                                                                                 uint32_t ),
+                              double &aBuildTime, double &aPublishTime )
+{
+    if ( !mBagOpen && !aAlways && ( aPublisher.getNumSubscribers() == 0 ) )
+    {
+        return;
+    }
+
+    const double                     lStart = MonotonicSeconds();
+    const boost::shared_ptr<const M> lMessage = ( mScanBuilder.*aBuild )( mSegmentFrame, mSequence );
+    const double                     lBuilt = MonotonicSeconds();
+
+    if ( mBagOpen )
+    {
+        try
+        {
+            mBag.write( aPublisher.getTopic(), mSegmentFrame.mStamp, lMessage );
+        }
+        catch( const rosbag::BagException &aException )
+        {
+            ROS_ERROR( "[%s] Failed to write to bag %s: %s", mLabel.c_str(),
+                       mOptions.mBagFile.c_str(), aException.what() );
+            CloseBag();
+        }
+    }
+    else
+    {
+        aPublisher.publish( lMessage );
+    }
+
+    aBuildTime += lBuilt - lStart;
+    aPublishTime += MonotonicSeconds() - lBuilt;
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::PublishZoneEvents
+//
+/// \brief   Evaluate the zones on the current frame and publish (or write to
+///          the bag) one event per confirmed change. Nothing is sent while
+///          the occupancy does not change. The events come from a pool, as
+///          the scans do.
+// *****************************************************************************
+
+void
+LeddarSensor::PublishZoneEvents( void )
+{
+    ZoneTransition     lTransitions[ ZoneMonitor::kMaxZones ];
+    const unsigned int lCount = mZoneMonitor.Update( mSegmentFrame, lTransitions );
+
+    for( unsigned int i=0; i<lCount; ++i )
+    {
+        const ZoneTransition &lTransition = lTransitions[i];
+        const ZoneEventPtr    lEvent = mZoneEvents.Acquire( ZoneEvent() );
+
+        lEvent->header.stamp = mSegmentFrame.mStamp;
+        lEvent->header.frame_id = mOptions.mFrameId;
+        lEvent->zone = mZoneMonitor.Zone( lTransition.mZone ).mName;
+        lEvent->event = lTransition.mEnter ? ZoneEvent::ENTER : ZoneEvent::LEAVE;
+        lEvent->occupied = mZoneMonitor.Occupied();
+        lEvent->segment = lTransition.mSegment;
+        lEvent->distance = lTransition.mDistance;
+
+        Send<ZoneEvent>( mZonePublisher, lEvent );
+    }
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::PublishBatch
+//
+/// \brief   Add the current frame to the batch and publish the batch once
+///          complete. Nothing is batched without subscribers or a bag.
+// *****************************************************************************
+
+void
+LeddarSensor::PublishBatch( void )
+{
+    if ( !mBagOpen && ( mBatchPublisher.getNumSubscribers() == 0 ) )
+    {
+        mBatcher.Discard();
+        return;
+    }
+
+    const ScanBatch::ConstPtr lBatch = mBatcher.Add( mSegmentFrame );
+
+    if ( lBatch )
+    {
+        Send<ScanBatch>( mBatchPublisher, lBatch );
+    }
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::FlushBatch
+//
+/// \brief   Publish the frames batched so far. Only called while the
+///          publisher thread is idle, before the bag is closed.
+// *****************************************************************************
+
+void
+LeddarSensor::FlushBatch( void )
+{
+    const ScanBatch::ConstPtr lBatch = mBatcher.Flush();
+
+    if ( lBatch )
+    {
+        Send<ScanBatch>( mBatchPublisher, lBatch );
+    }
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::Send
+//
+/// \brief   Publish a message, or write it to the bag under its topic when
+///          replaying into one. On a bag error the bag is closed.
+// *****************************************************************************
+
+template< typename M >
+void
+LeddarSensor::Send( ros::Publisher &aPublisher, const boost::shared_ptr<const M> &aMessage )
+{
+    if ( !mBagOpen )
+    {
+        aPublisher.publish( aMessage );
+        return;
+    }
+
+    try
+    {
+        mBag.write( aPublisher.getTopic(), mSegmentFrame.mStamp, aMessage );
+    }
+    catch( const rosbag::BagException &aException )
+    {
+        ROS_ERROR( "[%s] Failed to write to bag %s: %s", mLabel.c_str(),
+                   mOptions.mBagFile.c_str(), aException.what() );
+        CloseBag();
+    }
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::ReportLatency
+//
+/// \brief   Log the frame rate and the acquisition-to-publish latency
+///          distribution collected since the last report (processing time
+///          when replaying) and start a new one.
+// *****************************************************************************
+
+void
+LeddarSensor::ReportLatency( void )
+{
+    const ros::WallTime lNow = ros::WallTime::now();
+
+    if ( ( mLatency.Count() > 0 ) && !mLatencyReportStart.isZero() )
+    {
+        ROS_INFO( "[%s] %.1f frames/s, latency over %llu frames (ms): min %.1f mean %.1f "
+                  "p50 %.1f p95 %.1f p99 %.1f max %.1f, period %.3f ms", mLabel.c_str(),
+                  mLatency.Count() / ( lNow - mLatencyReportStart ).toSec(),
+                  (unsigned long long) mLatency.Count(), mLatency.Min() * 1e3,
+                  mLatency.Mean() * 1e3, mLatency.Percentile( 0.5 ) * 1e3,
+                  mLatency.Percentile( 0.95 ) * 1e3, mLatency.Percentile( 0.99 ) * 1e3,
+                  mLatency.Max() * 1e3, mStampFilter.Period() * 1e3 );
+    }
+
+    mLatency.Clear();
+    mLatencyReportStart = lNow;
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::WatchdogThread
+//
+/// \brief   Supervise a live sensor: every ping period, ping it and verify
+///          that frames still arrive while streaming. A failed ping or a
+///          stall longer than stall_timeout starts a reconnection (or
+///          finishes the sensor if reconnect is off: the node then exits so
+///          roslaunch respawns it).
+// *****************************************************************************
+
+void
+LeddarSensor::WatchdogThread( void )
+{
+    uint64_t lLastCount = 0;
+    double   lLastFrame = MonotonicSeconds();
+
+    while( WatchdogSleep( mOptions.mPingPeriod ) )
+    {
+        const double lNow = MonotonicSeconds();
+        bool         lLost;
+        bool         lStalled = false;
+
+        {
+            std::lock_guard<std::mutex> lLock( mControlMutex );
+
+            lLost = !mDevice.Ping().Ok();
+
+            // Dropped frames still prove the sensor is alive.
+            const uint64_t lCount = mRing.Pushed() + mRing.Dropped();
+
+            if ( ( lCount != lLastCount ) || !mStreaming )
+            {
+                lLastCount = lCount;
+                lLastFrame = lNow;
+            }
+            // Never less than a few periods at the slow measurement rates.
+            else if ( ( mOptions.mStallTimeout > 0 )
+                      && ( lNow - lLastFrame > std::max( mOptions.mStallTimeout,
+                                                         3 / mMeasurementRate ) ) )
+            {
+                lStalled = true;
+            }
+        }
+
+        if ( !lLost && !lStalled )
+        {
+            continue;
+        }
+
+        // The owner decides what to do: the node exits, a nodelet only
+        // loses this sensor.
+        if ( !mOptions.mReconnect )
+        {
+            ROS_ERROR( "[%s] Lost connection to the Leddar sensor, stopping.",
+                       mLabel.c_str() );
+            StopStreaming();
+
+            if ( mFinished )
+            {
+                mFinished();
+            }
+
+            return;
+        }
+
+        if ( lStalled )
+        {
+            ROS_WARN( "[%s] No frame for %.1f s, reconnecting.", mLabel.c_str(),
+                      lNow - lLastFrame );
+        }
+        else
+        {
+            ROS_WARN( "[%s] Lost connection to the Leddar sensor, reconnecting.",
+                      mLabel.c_str() );
+        }
+
+        Reconnect();
+        lLastFrame = MonotonicSeconds();
+    }
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::WatchdogSleep
+//
+/// \brief   Sleep on the watchdog, woken up early by Close.
+///
+/// \return  False if the sensor is closing.
+// *****************************************************************************
+
+bool
+LeddarSensor::WatchdogSleep( double aSeconds )
+{
+    std::unique_lock<std::mutex> lLock( mWatchdogMutex );
+
+    return !mWatchdogWake.wait_for( lLock, std::chrono::duration<double>( aSeconds ),
+                                    [this]() { return mWatchdogStop; } );
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::Reconnect
+//
+/// \brief   Tear down the link and reconnect with exponential backoff, then
+///          reconfigure, register the callback and restart the transfer if
+///          streaming was wanted. The downtime is logged and reported in the
+///          diagnostics.
+// *****************************************************************************
+
+void
+LeddarSensor::Reconnect( void )
+{
+    const double lLostAt = MonotonicSeconds();
+
+    // Auto-tuning pauses until reconnected.
+    mWatchdogState = WATCHDOG_RECONNECTING;
+    WakeTuner();
+
+    {
+        std::lock_guard<std::mutex> lLock( mControlMutex );
+
+        StopTransfer();
+        mDevice.Disconnect();
+    }
+
+    // Configure below touches what the publisher thread uses.
+    WaitPublished();
+
+    double   lBackoff = mOptions.mReconnectBackoffMin;
+    unsigned lAttempts = 1;
+
+    for( ;; ++lAttempts )
+    {
+        {
+            std::lock_guard<std::mutex> lLock( mControlMutex );
+
+            if ( mDevice.Connect( mOptions.mAddress ).Ok() )
+            {
+                break;
+            }
+        }
+
+        ROS_WARN_THROTTLE( 10, "[%s] Reconnection attempt %u failed, next in %.1f s.",
+                           mLabel.c_str(), lAttempts, lBackoff );
+
+        if ( !WatchdogSleep( lBackoff ) )
+        {
+            return;
+        }
+
+        lBackoff = std::min( lBackoff * 2, mOptions.mReconnectBackoffMax );
+    }
+
+    Configure();
+
+    // The sensor may have been reconfigured by someone else meanwhile.
+    if ( mReconfigureServer )
+    {
+        LeddarConfig lConfig;
+
+        ConfigFromProperties( mProperties, lConfig );
+        mReconfigureServer->updateConfig( lConfig );
+    }
+
+    {
+        std::lock_guard<std::mutex> lLock( mControlMutex );
+
+        if ( mWantStreaming )
+        {
+            StartTransfer();
+        }
+    }
+
+    const double lDowntime = MonotonicSeconds() - lLostAt;
+
+    mReconnects.fetch_add( 1 );
+    mLastDowntime = lDowntime;
+    mTotalDowntime = mTotalDowntime.load() + lDowntime;
+    mWatchdogState = WATCHDOG_CONNECTED;
+    WakeTuner();
+
+    ROS_WARN( "[%s] Reconnected after %.2f s (%u attempts).", mLabel.c_str(), lDowntime,
+              lAttempts );
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::StartAutoTune
+//
+/// \brief   Start searching the acquisition settings in the background (see
+///          AutoTuner). Streaming is started for the search if needed.
+///
+/// \return  False if a search is already running.
+// *****************************************************************************
+
+bool
+LeddarSensor::StartAutoTune( void )
+{
+    if ( mTuning.exchange( true ) )
+    {
+        ROS_WARN( "[%s] Auto-tuning already running.", mLabel.c_str() );
+        return false;
+    }
+
+    if ( mTuneThread.joinable() )
+    {
+        mTuneThread.join();
+    }
+
+    mTuneAbort = false;
+    mTuneThread = std::thread( &LeddarSensor::AutoTuneThread, this );
+    return true;
+}
+
+bool
+LeddarSensor::AutoTuneService( std_srvs::Empty::Request &, std_srvs::Empty::Response & )
+{
+    return StartAutoTune();
+}
+
+/// \brief   Wake up the auto-tuning thread: a frame was measured, the
+///          connection changed or the search is aborted.
+void
+LeddarSensor::WakeTuner( void )
+{
+    std::lock_guard<std::mutex> lLock( mTuneMutex );
+
+    mTuneWake.notify_all();
+}
+
+/// \brief   Sleep aSeconds, or until the tuner measured aFrames frames if not
+///          0. Returns false if the search is aborted or the sensor is
+///          reconnecting.
+bool
+LeddarSensor::TuneSleep( double aSeconds, unsigned int aFrames )
+{
+    std::unique_lock<std::mutex> lLock( mTuneMutex );
+
+    mTuneWake.wait_for( lLock, std::chrono::duration<double>( aSeconds ),
+                        [this, aFrames]()
+                        {
+                            return    mTuneAbort.load()
+                                   || ( mWatchdogState.load() == WATCHDOG_RECONNECTING )
+                                   || ( ( aFrames > 0 ) && ( mTuner.Frames() >= aFrames ) );
+                        } );
+
+    return !mTuneAbort.load() && ( mWatchdogState.load() != WATCHDOG_RECONNECTING );
+}
+
+/// \brief   Wait while the sensor is reconnecting. Returns false if the
+///          search is aborted.
+bool
+LeddarSensor::TuneResume( void )
+{
+    std::unique_lock<std::mutex> lLock( mTuneMutex );
+
+    mTuneWake.wait( lLock, [this]()
+                           {
+                               return    mTuneAbort.load()
+                                      || ( mWatchdogState.load() != WATCHDOG_RECONNECTING );
+                           } );
+
+    return !mTuneAbort.load();
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::AutoTuneThread
+//
+/// \brief   Write and measure every candidate, then keep the best one, or
+///          the initial settings if none achieves the target rate. The
+///          measured candidates are logged and written to the report.
+// *****************************************************************************
+
+void
+LeddarSensor::AutoTuneThread( void )
+{
+    const AutoTuneSettings    &lSettings = mOptions.mAutoTune;
+    const double               lTarget = AutoTuner::TargetRate( lSettings, mMeasurementRate );
+    std::vector<TuneCandidate> lCandidates;
+    std::vector<PropertyWrite> lWrites;
+
+    mTuner.Candidates( lSettings, mProperties, lCandidates );
+
+    if ( lCandidates.empty() )
+    {
+        ROS_WARN( "[%s] No acquisition setting to try reaches %.2f Hz.", mLabel.c_str(), lTarget );
+        mTuning = false;
+        return;
+    }
+
+    ROS_INFO( "[%s] Auto-tuning %u acquisition settings for %.2f Hz.", mLabel.c_str(),
+              unsigned( lCandidates.size() ), lTarget );
+
+    // The initial settings, to go back to if nothing qualifies.
+    TuneCandidate lInitial = TuneCandidate();
+
+    lInitial.mRate = mProperties.Value( PID_MEASUREMENT_RATE, 0, 0 );
+    lInitial.mOversampling = mProperties.Value( PID_OVERSAMPLING_EXPONENT, 0, 0 );
+    lInitial.mAccumulation = mProperties.Value( PID_ACCUMULATION_EXPONENT, 0, 0 );
+    lInitial.mBasePoints = mProperties.Value( PID_BASE_POINT_COUNT, 0, 0 );
+    lInitial.mLedIntensity = mProperties.Value( PID_LED_INTENSITY, 0, 0 );
+
+    const bool lManualLed = !lSettings.mLedIntensities.empty();
+    const bool lAutomaticLed = mProperties.Value( PID_AUTOMATIC_LED_INTENSITY, 0, 0 ) != 0;
+    bool       lStarted = false;
+
+    {
+        std::lock_guard<std::mutex> lLock( mControlMutex );
+
+        lStarted = !mWantStreaming;
+    }
+
+    if ( lStarted )
+    {
+        StartStreaming();
+    }
+
+    size_t i = 0;
+
+    // A reconnection interrupts the candidate, it is written and measured
+    // again once reconnected.
+    while( ( i < lCandidates.size() ) && TuneResume() )
+    {
+        TuneCandidate &lCandidate = lCandidates[i];
+
+        AutoTuner::Writes( lCandidate, mProperties, lManualLed, lWrites );
+        lCandidate.mResult = WriteProperties( lWrites );
+
+        if ( lCandidate.mResult == LD_SUCCESS )
+        {
+            if ( !TuneSleep( lSettings.mSettleTime ) )
+            {
+                continue;
+            }
+
+            // Twice the nominal duration, a candidate can be slower than asked.
+            const double lTimeout = 2.0 * lSettings.mMeasureFrames / lCandidate.mRate + 1;
+
+            mTuner.Begin( lSettings.mMinDetections );
+
+            const bool lMeasured = TuneSleep( lTimeout, unsigned( lSettings.mMeasureFrames ) );
+
+            mTuner.End( lCandidate );
+
+            if ( !lMeasured )
+            {
+                continue;
+            }
+
+            ROS_INFO( "[%s] Rate %g, oversampling 2^%g, accumulations 2^%g, %g base points, "
+                      "LED %g%%: %.2f Hz, noise %.1f mm on %.0f%% of the segments.", mLabel.c_str(),
+                      lCandidate.mRate, lCandidate.mOversampling, lCandidate.mAccumulation,
+                      lCandidate.mBasePoints, lCandidate.mLedIntensity, lCandidate.mAchievedRate,
+                      lCandidate.mNoise * 1e3, lCandidate.mDetectionRatio * 100 );
+        }
+        else if ( mWatchdogState.load() == WATCHDOG_RECONNECTING )
+        {
+            continue;
+        }
+
+        ++i;
+    }
+
+    const int lSelected = mTuneAbort.load() ? -1 : AutoTuner::Select( lCandidates, lTarget );
+
+    if ( lSelected >= 0 )
+    {
+        AutoTuner::Writes( lCandidates[lSelected], mProperties, lManualLed, lWrites );
+    }
+    else
+    {
+        AutoTuner::Writes( lInitial, mProperties, false, lWrites );
+
+        if ( lManualLed && lAutomaticLed )
+        {
+            lWrites.push_back( PropertyWrite( PID_AUTOMATIC_LED_INTENSITY, 0, 1 ) );
+        }
+    }
+
+    WriteProperties( lWrites );
+
+    if ( lSelected >= 0 )
+    {
+        const TuneCandidate &lBest = lCandidates[lSelected];
+
+        ROS_INFO( "[%s] Auto-tuning kept rate %g, oversampling 2^%g, accumulations 2^%g, "
+                  "%g base points, LED %g%% (noise %.1f mm).", mLabel.c_str(), lBest.mRate,
+                  lBest.mOversampling, lBest.mAccumulation, lBest.mBasePoints,
+                  lBest.mLedIntensity, lBest.mNoise * 1e3 );
+
+        mPrivate.setParam( "autotune/result/measurement_rate", lBest.mRate );
+        mPrivate.setParam( "autotune/result/oversampling_exponent", lBest.mOversampling );
+        mPrivate.setParam( "autotune/result/accumulation_exponent", lBest.mAccumulation );
+        mPrivate.setParam( "autotune/result/base_point_count", lBest.mBasePoints );
+        mPrivate.setParam( "autotune/result/led_intensity", lBest.mLedIntensity );
+        mPrivate.setParam( "autotune/result/achieved_rate", lBest.mAchievedRate );
+        mPrivate.setParam( "autotune/result/noise", lBest.mNoise );
+    }
+    else if ( !mTuneAbort.load() )
+    {
+        ROS_WARN( "[%s] No acquisition setting reached %.2f Hz, initial settings restored.",
+                  mLabel.c_str(), lTarget );
+    }
+
+    if ( !lSettings.mReport.empty() && !mTuneAbort.load() )
+    {
+        if ( AutoTuner::WriteReport( lSettings.mReport, lCandidates, lSelected, lTarget ) )
+        {
+            ROS_INFO( "[%s] Tradeoff curve written to %s.", mLabel.c_str(),
+                      lSettings.mReport.c_str() );
+        }
+        else
+        {
+            ROS_WARN( "[%s] Could not write %s.", mLabel.c_str(), lSettings.mReport.c_str() );
+        }
+    }
+
+    if ( mReconfigureServer )
+    {
+        LeddarConfig lConfig;
+
+        ConfigFromProperties( mProperties, lConfig );
+        mReconfigureServer->updateConfig( lConfig );
+    }
+
+    if ( lStarted )
+    {
+        StopStreaming();
+    }
+
+    mTuning = false;
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::StepRecord
+//
+/// \brief   Hand the next frame of a FrameRecorder record to the publisher
+///          thread, as OnData does for the SDK. The frame goes through
+///          binning (and filtering) again. Called with mControlMutex held.
+///
+/// \return  LD_SUCCESS, or LD_END_OF_FILE past the frames indexed so far.
+// *****************************************************************************
+
+int
+LeddarSensor::StepRecord( void )
+{
+    if ( !mReader.Read( mReplayIndex, mReplayFrame ) )
+    {
+        return LD_END_OF_FILE;
+    }
+
+    LeddarFrame *lFrame = mRing.BeginPush();
+
+    // The ring is full: try the same frame again on the next step.
+    if ( lFrame == NULL )
+    {
+        return LD_SUCCESS;
+    }
+
+    // Every echo of a decoded frame fits.
+    static_assert( LEDDAR_MAX_DETECTIONS >= LEDDAR_MAX_SEGMENTS * LEDDAR_MAX_ECHOES,
+                   "A raw frame must hold a whole segment frame" );
+
+    unsigned int lCount = 0;
+
+    for( unsigned int s=0; s<mReplayFrame.mSegmentCount; ++s )
+    {
+        for( unsigned int e=0; e<mReplayFrame.mEchoCount[s]; ++e )
+        {
+            LdDetection &lDetection = lFrame->mDetections[ lCount++ ];
+
+            lDetection.mSegment = s;
+            lDetection.mDistance = mReplayFrame.mDistance[e][s];
+            lDetection.mAmplitude = mReplayFrame.mAmplitude[e][s];
+            lDetection.mFlags = mReplayFrame.mFlags[e][s];
+        }
+    }
+
+    lFrame->mArrival = mReplayFrame.mStamp;
+    lFrame->mMonotonic = MonotonicSeconds();
+    lFrame->mLevels = LDDL_DETECTIONS;
+    lFrame->mCount = lCount;
+    lFrame->mRecordIndex = mReplayIndex++;
+
+    if ( mFirstFrame )
+    {
+        mFirstFrame = false;
+        ROS_INFO( "[%s] First frame replayed %.3f s after startup.", mLabel.c_str(),
+                  ( ros::WallTime::now() - mOptions.mStartTime ).toSec() );
+    }
+
+    mRing.EndPush();
+    sem_post( &mFrameReady );
+
+    return LD_SUCCESS;
+}
+
+/// \brief   Number of frames of the record known so far.
+uint64_t
+LeddarSensor::RecordSize( void )
+{
+    return mReader.IsOpen() ? mReader.KnownFrames() : mDevice.RecordSize();
+}
+
+/// \brief   Whether the record is still being loaded (indexed).
+bool
+LeddarSensor::RecordLoading( void )
+{
+    return mReader.IsOpen() ? mReader.Indexing() : mDevice.RecordLoading();
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::PublishRecordSize
+//
+/// \brief   Publish the number of frames known on record_size (latched)
+///          when it grew, so consumers can follow the loading.
+// *****************************************************************************
+
+void
+LeddarSensor::PublishRecordSize( void )
+{
+    const uint64_t lSize = RecordSize();
+
+    if ( lSize != mKnownRecordSize.exchange( lSize ) )
+    {
+        std_msgs::UInt64 lMessage;
+
+        lMessage.data = lSize;
+        mRecordSizePublisher.publish( lMessage );
+    }
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::StepReplay
+//
+/// \brief   Step forward in the loaded record. The callback is called from
+///          within LeddarStepForward when replaying.
+///
+/// \return  True if a frame was stepped, false if paused, at the end of
+///          the record or waiting for the loader.
+// *****************************************************************************
+
+bool
+LeddarSensor::StepReplay( void )
+{
+    int lResult;
+
+    {
+        std::lock_guard<std::mutex> lLock( mControlMutex );
+
+        if ( !mStreaming )
+        {
+            return false;
+        }
+
+        lResult = mReader.IsOpen() ? StepRecord() : mDevice.StepForward().Code();
+    }
+
+    PublishRecordSize();
+
+    // Reaching the end while the record is still loading only means we
+    // caught up with the loader, the next step will succeed.
+    if ( ( lResult == LD_END_OF_FILE ) && !RecordLoading() )
+    {
+        FinishReplay();
+    }
+    else if ( lResult != LD_END_OF_FILE )
+    {
+        LogError( mLabel, lResult );
+    }
+
+    return lResult == LD_SUCCESS;
+}
+
+void
+LeddarSensor::ReplayTimer( const ros::WallTimerEvent & )
+{
+    StepReplay();
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::ReplayThread
+//
+/// \brief   Replay as fast as possible: step whenever the ring has room, so
+///          the record is decoded on this thread while the previous frames
+///          are published on the publisher thread, and nothing is dropped.
+///          A full ring is waited on until the publisher thread takes a
+///          frame; paused or waiting for the loader, it polls.
+// *****************************************************************************
+
+void
+LeddarSensor::ReplayThread( void )
+{
+    while( mReplayRunning.load() )
+    {
+        const uint64_t lPublished = mPublished.load();
+
+        if ( mRing.Full() )
+        {
+            WaitPublishedCount( lPublished + 1 );
+        }
+        else if ( !StepReplay() )
+        {
+            ros::WallDuration( 0.01 ).sleep();
+        }
+    }
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::FinishReplay
+//
+/// \brief   End of the record: stop, let the publisher thread catch up,
+///          close the bag and report the replay throughput. With
+///          exit_at_end the sensor is finished.
+// *****************************************************************************
+
+void
+LeddarSensor::FinishReplay( void )
+{
+    StopStreaming();
+    WaitPublished();
+    FlushBatch();
+    CloseBag();
+
+    ros::WallTime lStart;
+    uint64_t      lStartCount;
+
+    {
+        std::lock_guard<std::mutex> lLock( mControlMutex );
+
+        lStart = mReplayStartTime;
+        lStartCount = mReplayStartCount;
+    }
+
+    const double   lElapsed = ( ros::WallTime::now() - lStart ).toSec();
+    const uint64_t lFrames = mPublished.load() - lStartCount;
+
+    ROS_INFO( "[%s] End of record reached after %d frames: %llu frames replayed in %.2f s "
+              "(%.1f frames/s).", mLabel.c_str(), (int) RecordSize(),
+              (unsigned long long) lFrames, lElapsed, lElapsed > 0 ? lFrames / lElapsed : 0 );
+
+    if ( mOptions.mExitAtEnd && mFinished )
+    {
+        mFinished();
+    }
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::WaitPublished
+//
+/// \brief   Wait until the publisher thread has taken every frame pushed in
+///          the ring. The data transfer must be stopped.
+// *****************************************************************************
+
+void
+LeddarSensor::WaitPublished( void )
+{
+    WaitPublishedCount( mRing.Pushed() );
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::WaitPublishedCount
+//
+/// \brief   Wait until the publisher thread has taken aCount frames from the
+///          ring in all, woken up by it as it takes them.
+///
+/// \param   aCount  Value of mPublished to reach.
+// *****************************************************************************
+
+void
+LeddarSensor::WaitPublishedCount( uint64_t aCount )
+{
+    // Registered before checking: either the publisher thread sees a waiter
+    // and notifies, or the count it updated is seen here.
+    mPublishedWaiters.fetch_add( 1 );
+
+    {
+        std::unique_lock<std::mutex> lLock( mPublishedMutex );
+
+        mPublishedWake.wait( lLock, [this, aCount]() { return mPublished.load() >= aCount; } );
+    }
+
+    mPublishedWaiters.fetch_sub( 1 );
+}
+
+void
+LeddarSensor::OpenBag( void )
+{
+    try
+    {
+        mBag.open( mOptions.mBagFile, rosbag::bagmode::Write );
+        mBagOpen = true;
+    }
+    catch( const rosbag::BagException &aException )
+    {
+        ROS_ERROR( "[%s] Failed to open bag %s, publishing instead: %s", mLabel.c_str(),
+                   mOptions.mBagFile.c_str(), aException.what() );
+    }
+}
+
+void
+LeddarSensor::CloseBag( void )
+{
+    if ( mBagOpen )
+    {
+        mBagOpen = false;
+        mBag.close();
+        ROS_INFO( "[%s] Bag %s written.", mLabel.c_str(), mOptions.mBagFile.c_str() );
+    }
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::OverflowTimer
+//
+/// \brief   Report frames dropped because the ring was full.
+// *****************************************************************************
+
+void
+LeddarSensor::OverflowTimer( const ros::WallTimerEvent & )
+{
+    const uint64_t lDropped = mRing.Dropped();
+
+    if ( lDropped != mLastDropped )
+    {
+        ROS_WARN( "[%s] Frame ring overflow: %llu frames dropped (%llu since last report).",
+                  mLabel.c_str(), (unsigned long long) lDropped,
+                  (unsigned long long) ( lDropped - mLastDropped ) );
+        mLastDropped = lDropped;
+    }
+
+    std_msgs::UInt64 lMessage;
+    lMessage.data = lDropped;
+    mDroppedPublisher.publish( lMessage );
+}
+
+// *****************************************************************************
+// Function: LeddarSensor::DiagnosticsTimer
+//
+/// \brief   Publish the frame rate, drop counters, sensor temperature and
+///          the timing of each stage since the last call on /diagnostics.
+// *****************************************************************************
+
+void
+LeddarSensor::DiagnosticsTimer( const ros::WallTimerEvent & )
+{
+    const ros::WallTime lNow = ros::WallTime::now();
+    const double        lElapsed = ( lNow - mDiagnosticsTime ).toSec();
+    const uint64_t      lPublished = mPublished.load();
+    const uint64_t      lDropped = mRing.Dropped();
+    char                lValue[128];
+
+    diagnostic_msgs::DiagnosticArray  lArray;
+    diagnostic_msgs::DiagnosticStatus lStatus;
+    diagnostic_msgs::KeyValue         lKeyValue;
+
+    lStatus.name = "leddartech: " + mLabel;
+    lStatus.hardware_id = mOptions.mReplayFile.empty() ? mOptions.mAddress : mOptions.mReplayFile;
+
+    if ( mWatchdogState.load() == WATCHDOG_RECONNECTING )
+    {
+        lStatus.level = diagnostic_msgs::DiagnosticStatus::ERROR;
+        lStatus.message = "Reconnecting";
+    }
+    else if ( lDropped != mDiagnosticsDropped )
+    {
+        lStatus.level = diagnostic_msgs::DiagnosticStatus::WARN;
+        lStatus.message = "Dropping frames";
+    }
+    else
+    {
+        lStatus.level = diagnostic_msgs::DiagnosticStatus::OK;
+        lStatus.message = "OK";
+    }
+
+    snprintf( lValue, sizeof(lValue), "%.2f",
+              lElapsed > 0 ? ( lPublished - mDiagnosticsPublished ) / lElapsed : 0 );
+    lKeyValue.key = "frame rate (Hz)";
+    lKeyValue.value = lValue;
+    lStatus.values.push_back( lKeyValue );
+
+    snprintf( lValue, sizeof(lValue), "%llu", (unsigned long long) lPublished );
+    lKeyValue.key = "frames";
+    lKeyValue.value = lValue;
+    lStatus.values.push_back( lKeyValue );
+
+    snprintf( lValue, sizeof(lValue), "%llu (%llu since last)", (unsigned long long) lDropped,
+              (unsigned long long) ( lDropped - mDiagnosticsDropped ) );
+    lKeyValue.key = "dropped frames";
+    lKeyValue.value = lValue;
+    lStatus.values.push_back( lKeyValue );
+
+    snprintf( lValue, sizeof(lValue), "%llu", (unsigned long long) mTruncated.load() );
+    lKeyValue.key = "truncated frames";
+    lKeyValue.value = lValue;
+    lStatus.values.push_back( lKeyValue );
+
+    if ( mChangeGate.Enabled() )
+    {
+        const uint64_t lSuppressed = mSuppressed.load();
+        const uint64_t lFrames = lPublished - mDiagnosticsPublished;
+
+        snprintf( lValue, sizeof(lValue), "%llu (%.1f %% since last), %llu keep-alives",
+                  (unsigned long long) lSuppressed,
+                  lFrames > 0 ? 100.0 * ( lSuppressed - mDiagnosticsSuppressed ) / lFrames : 0,
+                  (unsigned long long) mKeepAlives.load() );
+        lKeyValue.key = "suppressed frames";
+        lKeyValue.value = lValue;
+        lStatus.values.push_back( lKeyValue );
+        mDiagnosticsSuppressed = lSuppressed;
+    }
+
+    if ( mReplaying )
+    {
+        snprintf( lValue, sizeof(lValue), "%llu%s", (unsigned long long) RecordSize(),
+                  RecordLoading() ? " (loading)" : "" );
+        lKeyValue.key = "record frames";
+        lKeyValue.value = lValue;
+        lStatus.values.push_back( lKeyValue );
+    }
+
+    if ( mRecorder.Active() )
+    {
+        snprintf( lValue, sizeof(lValue), "%llu frames, %llu dropped, %.1f MB (%.1f MB raw)",
+                  (unsigned long long) mRecorder.Frames(), (unsigned long long) mRecorder.Dropped(),
+                  mRecorder.StoredBytes() * 1e-6, mRecorder.RawBytes() * 1e-6 );
+        lKeyValue.key = "recording";
+        lKeyValue.value = lValue;
+        lStatus.values.push_back( lKeyValue );
+        lKeyValue.key = "record file";
+        lKeyValue.value = mRecorder.FileName();
+        lStatus.values.push_back( lKeyValue );
+    }
+
+    if ( mShm.Active() )
+    {
+        snprintf( lValue, sizeof(lValue), "%s, %llu frames", mShm.Name().c_str(),
+                  (unsigned long long) mShm.Written() );
+        lKeyValue.key = "shared memory";
+        lKeyValue.value = lValue;
+        lStatus.values.push_back( lKeyValue );
+    }
+
+    snprintf( lValue, sizeof(lValue), "%llu", (unsigned long long) mReconnects.load() );
+    lKeyValue.key = "reconnections";
+    lKeyValue.value = lValue;
+    lStatus.values.push_back( lKeyValue );
+
+    snprintf( lValue, sizeof(lValue), "last %.2f total %.2f", mLastDowntime.load(),
+              mTotalDowntime.load() );
+    lKeyValue.key = "reconnection downtime (s)";
+    lKeyValue.value = lValue;
+    lStatus.values.push_back( lKeyValue );
+
+    double lTemperature;
+    bool   lHaveTemperature = false;
+
+    // Left out when the device is busy (reconnecting, stepping, writing),
+    // rather than holding up the timer.
+    {
+        std::unique_lock<std::mutex> lLock( mControlMutex, std::try_to_lock );
+
+        if ( lLock.owns_lock() )
+        {
+            lHaveTemperature = mDevice.GetResult( RID_TEMPERATURE, 0, lTemperature ).Ok();
+        }
+    }
+
+    if ( lHaveTemperature )
+    {
+        snprintf( lValue, sizeof(lValue), "%.1f", lTemperature );
+        lKeyValue.key = "temperature (C)";
+        lKeyValue.value = lValue;
+        lStatus.values.push_back( lKeyValue );
+    }
+
+    for( unsigned int i=0; i<STAGE_COUNT; ++i )
+    {
+        mDiagnosticsStage.Take( mStats.mStages[i] );
+
+        if ( mDiagnosticsStage.Count() > 0 )
+        {
+            snprintf( lValue, sizeof(lValue), "mean %.1f p50 %.0f p99 %.0f max %.0f",
+                      mDiagnosticsStage.Mean() * 1e6, mDiagnosticsStage.Percentile( 0.5 ) * 1e6,
+                      mDiagnosticsStage.Percentile( 0.99 ) * 1e6, mDiagnosticsStage.Max() * 1e6 );
+            lKeyValue.key = std::string( kStageNames[i] ) + " (us)";
+            lKeyValue.value = lValue;
+            lStatus.values.push_back( lKeyValue );
+        }
+    }
+
+    lArray.header.stamp = ros::Time::now();
+    lArray.status.push_back( lStatus );
+    mDiagnosticsPublisher.publish( lArray );
+
+    mDiagnosticsTime = lNow;
+    mDiagnosticsPublished = lPublished;
+    mDiagnosticsDropped = lDropped;
+}
+
+} // namespace leddartech
+
+// End of file LeddarSensor.cpp
@@ -0,0 +1,246 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    LeddarShm.cpp
+///
+/// \brief   Reader of the shared-memory frame ring.
+// *****************************************************************************
+
+#include "leddartech/LeddarShm.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+
+struct LeddarShm
+{
+    const LeddarShmHeader *mHeader;
+    const LeddarShmSlot   *mSlots;
+    size_t                 mSize;
+};
+
+// Copies of a slot tried before giving up on one the writer keeps
+// rewriting. A copy takes a small fraction of the frame period.
+static const unsigned int kReadAttempts = 16;
+
+static double
+Now( void )
+{
+    struct timespec lNow;
+
+    clock_gettime( CLOCK_MONOTONIC, &lNow );
+    return lNow.tv_sec + lNow.tv_nsec * 1e-9;
+}
+
+// *****************************************************************************
+// Function: LeddarShmOpen
+//
+/// \brief   Map the ring written by the driver, read-only.
+///
+/// \param   aName  shm_name of the driver, with or without the leading /.
+///
+/// \return  The ring, NULL if it does not exist (yet) or is not a ring of
+///          this version.
+// *****************************************************************************
+
+LeddarShm *
+LeddarShmOpen( const char *aName )
+{
+    const std::string lName = ( aName[0] == '/' ) ? aName : std::string( "/" ) + aName;
+    const int         lFd = shm_open( lName.c_str(), O_RDONLY, 0 );
+
+    if ( lFd < 0 )
+    {
+        return NULL;
+    }
+
+    struct stat lStat;
+    void       *lMap = MAP_FAILED;
+
+    if ( ( fstat( lFd, &lStat ) == 0 ) && ( size_t( lStat.st_size ) >= sizeof( LeddarShmHeader ) ) )
+    {
+        lMap = mmap( NULL, lStat.st_size, PROT_READ, MAP_SHARED, lFd, 0 );
+    }
+
+    close( lFd );
+
+    if ( lMap == MAP_FAILED )
+    {
+        return NULL;
+    }
+
+    const LeddarShmHeader *lHeader = static_cast<const LeddarShmHeader *>( lMap );
+
+    if (    ( __atomic_load_n( &lHeader->mMagic, __ATOMIC_ACQUIRE ) != LEDDAR_SHM_MAGIC )
+         || ( lHeader->mVersion != LEDDAR_SHM_VERSION )
+         || ( lHeader->mSlotSize != sizeof( LeddarShmSlot ) ) || ( lHeader->mSlotCount == 0 )
+         || ( sizeof( LeddarShmHeader ) + lHeader->mSlotCount * sizeof( LeddarShmSlot )
+              > size_t( lStat.st_size ) ) )
+    {
+        munmap( lMap, lStat.st_size );
+        return NULL;
+    }
+
+    LeddarShm *lShm = new LeddarShm;
+
+    lShm->mHeader = lHeader;
+    lShm->mSlots = reinterpret_cast<const LeddarShmSlot *>( lHeader + 1 );
+    lShm->mSize = lStat.st_size;
+    return lShm;
+}
+
+void
+LeddarShmClose( LeddarShm *aShm )
+{
+    if ( aShm != NULL )
+    {
+        munmap( const_cast<LeddarShmHeader *>( aShm->mHeader ), aShm->mSize );
+        delete aShm;
+    }
+}
+
+/// \brief   Whether the writer still writes to the ring. Once not, open it
+///          again to follow a restarted driver.
+int
+LeddarShmActive( const LeddarShm *aShm )
+{
+    return __atomic_load_n( &aShm->mHeader->mActive, __ATOMIC_ACQUIRE ) != 0;
+}
+
+uint32_t
+LeddarShmSlotCount( const LeddarShm *aShm )
+{
+    return aShm->mHeader->mSlotCount;
+}
+
+uint32_t
+LeddarShmSegmentCount( const LeddarShm *aShm )
+{
+    return aShm->mHeader->mSegmentCount;
+}
+
+/// \brief   Number of frames written, the index of the next one.
+uint64_t
+LeddarShmWritten( const LeddarShm *aShm )
+{
+    return __atomic_load_n( &aShm->mHeader->mWritten, __ATOMIC_ACQUIRE );
+}
+
+// *****************************************************************************
+// Function: LeddarShmRead
+//
+/// \brief   Copy a frame out of the ring.
+///
+/// \param   aShm    Ring.
+/// \param   aIndex  Index of the frame, the ring holds the last
+///                  LeddarShmSlotCount() before LeddarShmWritten().
+/// \param   aFrame  Receives the frame, undefined unless LEDDAR_SHM_OK.
+///
+/// \return  LEDDAR_SHM_OK, LEDDAR_SHM_NOT_YET, LEDDAR_SHM_OVERWRITTEN or
+///          LEDDAR_SHM_BUSY.
+// *****************************************************************************
+
+int
+LeddarShmRead( const LeddarShm *aShm, uint64_t aIndex, LeddarShmFrame *aFrame )
+{
+    const LeddarShmSlot &lSlot = aShm->mSlots[ aIndex % aShm->mHeader->mSlotCount ];
+
+    for( unsigned int i=0; i<kReadAttempts; ++i )
+    {
+        if ( aIndex >= LeddarShmWritten( aShm ) )
+        {
+            return LEDDAR_SHM_NOT_YET;
+        }
+
+        const uint32_t lBefore = __atomic_load_n( &lSlot.mSequence, __ATOMIC_ACQUIRE );
+
+        if ( lBefore & 1 )
+        {
+            continue;
+        }
+
+        memcpy( aFrame, &lSlot.mFrame, sizeof( *aFrame ) );
+
+        // The copy must be complete before the sequence is read again.
+        __atomic_thread_fence( __ATOMIC_ACQUIRE );
+
+        if ( __atomic_load_n( &lSlot.mSequence, __ATOMIC_RELAXED ) == lBefore )
+        {
+            return ( aFrame->mIndex == aIndex ) ? LEDDAR_SHM_OK : LEDDAR_SHM_OVERWRITTEN;
+        }
+    }
+
+    return LEDDAR_SHM_BUSY;
+}
+
+/// \brief   Copy the last frame written. LEDDAR_SHM_NOT_YET if none.
+int
+LeddarShmLatest( const LeddarShm *aShm, LeddarShmFrame *aFrame )
+{
+    int lResult = LEDDAR_SHM_OVERWRITTEN;
+
+    // Lapped while copying: the next last frame.
+    while( lResult == LEDDAR_SHM_OVERWRITTEN )
+    {
+        const uint64_t lWritten = LeddarShmWritten( aShm );
+
+        if ( lWritten == 0 )
+        {
+            return LEDDAR_SHM_NOT_YET;
+        }
+
+        lResult = LeddarShmRead( aShm, lWritten - 1, aFrame );
+    }
+
+    return lResult;
+}
+
+// *****************************************************************************
+// Function: LeddarShmWait
+//
+/// \brief   Read a frame, polling until it is written. Spins first, then
+///          sleeps 100 us between polls.
+///
+/// \param   aShm      Ring.
+/// \param   aIndex    Index of the frame.
+/// \param   aFrame    Receives the frame.
+/// \param   aTimeout  s, 0 to wait forever.
+///
+/// \return  As LeddarShmRead, LEDDAR_SHM_NOT_YET on timeout.
+// *****************************************************************************
+
+int
+LeddarShmWait( const LeddarShm *aShm, uint64_t aIndex, LeddarShmFrame *aFrame, double aTimeout )
+{
+    const double lStart = Now();
+
+    for( unsigned int i=0; ; ++i )
+    {
+        const int lResult = LeddarShmRead( aShm, aIndex, aFrame );
+
+        if ( lResult != LEDDAR_SHM_NOT_YET )
+        {
+            return lResult;
+        }
+
+        if ( ( aTimeout > 0 ) && ( Now() - lStart >= aTimeout ) )
+        {
+            return LEDDAR_SHM_NOT_YET;
+        }
+
+        if ( i >= 1000 )
+        {
+            const struct timespec lPause = { 0, 100000 };
+
+            nanosleep( &lPause, NULL );
+        }
+    }
+}
+
+// End of file LeddarShm.cpp
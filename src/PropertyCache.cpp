@@ -0,0 +1,286 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    PropertyCache.cpp
+///
+/// \brief   Mirror of the properties of a sensor.
+// *****************************************************************************
+
+#include "leddartech/PropertyCache.h"
+
+#include <set>
+
+#include "LeddarProperties.h"
+
+namespace leddartech
+{
+
+// *****************************************************************************
+// Function: IndexCount
+//
+/// \brief   Number of indexes of a property: one per segment for the
+///          per-segment ones, 12 for the 3x4 transforms, 1 otherwise.
+// *****************************************************************************
+
+static unsigned int
+IndexCount( unsigned int aId, unsigned int aSegmentCount )
+{
+    switch( aId )
+    {
+        case PID_SEGMENT_LEFT:
+        case PID_SEGMENT_RIGHT:
+        case PID_SEGMENT_TOP:
+        case PID_SEGMENT_BOTTOM:
+        case PID_ZONE_SEGMENT_ENABLED:
+            return aSegmentCount;
+        case PID_GLOBAL_TRANSFORM:
+        case PID_INVERSE_TRANSFORM:
+            return 12;
+        default:
+            return 1;
+    }
+}
+
+// *****************************************************************************
+// Function: AddDerived
+//
+/// \brief   Add the read-only properties the sensor derives from a writable
+///          one, as they change along with it.
+// *****************************************************************************
+
+static void
+AddDerived( unsigned int aId, std::set<unsigned int> &aIds )
+{
+    switch( aId )
+    {
+        case PID_OVERSAMPLING_EXPONENT:
+            aIds.insert( PID_OVERSAMPLING );
+            break;
+        case PID_ACCUMULATION_EXPONENT:
+            aIds.insert( PID_ACCUMULATION );
+            break;
+        case PID_ZONE_NEAR_LIMIT:
+        case PID_ZONE_FAR_LIMIT:
+        case PID_ZONE_ENABLED:
+        case PID_ZONE_SEGMENT_ENABLED:
+            for( unsigned int lId=PID_ZONE_MIN_DISTANCE; lId<=PID_ZONE_ACTIVE; ++lId )
+            {
+                aIds.insert( lId );
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// *****************************************************************************
+// Function: ReadProperty
+//
+/// \brief   Read every index of a property the sensor has.
+// *****************************************************************************
+
+static void
+ReadProperty( const Device &aDevice, unsigned int aId, unsigned int aSegmentCount,
+              std::map<uint32_t, double> &aValues, std::map<uint32_t, std::string> &aTexts )
+{
+    const unsigned int lCount = IndexCount( aId, aSegmentCount );
+    const LdProperties lProperty = static_cast<LdProperties>( aId );
+
+    for( unsigned int i=0; i<lCount; ++i )
+    {
+        if ( aId == PID_NAME )
+        {
+            std::string lText;
+
+            if ( aDevice.GetProperty( lProperty, i, lText ).Ok() )
+            {
+                aTexts[ PropertyCache::Key( aId, i ) ] = lText;
+            }
+        }
+        else
+        {
+            double lValue;
+
+            if ( aDevice.GetProperty( lProperty, i, lValue ).Ok() )
+            {
+                aValues[ PropertyCache::Key( aId, i ) ] = lValue;
+            }
+        }
+    }
+}
+
+PropertyCache::PropertyCache( void )
+    : mSegmentCount( 0 )
+{
+}
+
+// *****************************************************************************
+// Function: PropertyCache::Load
+//
+/// \brief   Read every property of the sensor. Properties it does not have
+///          are left out.
+///
+/// \param   aDevice        Connected sensor or loaded record.
+/// \param   aSegmentCount  Number of segments, for per-segment properties.
+// *****************************************************************************
+
+void
+PropertyCache::Load( const Device &aDevice, unsigned int aSegmentCount )
+{
+    std::map<uint32_t, double>      lValues;
+    std::map<uint32_t, std::string> lTexts;
+
+    for( unsigned int lId=PID_LED_INTENSITY; lId<=PID_NAME; ++lId )
+    {
+        ReadProperty( aDevice, lId, aSegmentCount, lValues, lTexts );
+    }
+
+    std::lock_guard<std::mutex> lLock( mMutex );
+
+    mSegmentCount = aSegmentCount;
+    mValues.swap( lValues );
+    mTexts.swap( lTexts );
+}
+
+void
+PropertyCache::Clear( void )
+{
+    std::lock_guard<std::mutex> lLock( mMutex );
+
+    mValues.clear();
+    mTexts.clear();
+}
+
+// *****************************************************************************
+// Function: PropertyCache::Get
+//
+/// \param   aId     LdProperties id.
+/// \param   aIndex  Index of the value, 0 except for per-segment properties.
+/// \param   aValue  Receives the value.
+///
+/// \return  False if the sensor does not have this property.
+// *****************************************************************************
+
+bool
+PropertyCache::Get( unsigned int aId, unsigned int aIndex, double &aValue ) const
+{
+    std::lock_guard<std::mutex> lLock( mMutex );
+
+    const std::map<uint32_t, double>::const_iterator lValue = mValues.find( Key( aId, aIndex ) );
+
+    if ( lValue == mValues.end() )
+    {
+        return false;
+    }
+
+    aValue = lValue->second;
+    return true;
+}
+
+/// \brief   The value of a property, aDefault if the sensor does not have it.
+double
+PropertyCache::Value( unsigned int aId, unsigned int aIndex, double aDefault ) const
+{
+    double lValue;
+
+    return Get( aId, aIndex, lValue ) ? lValue : aDefault;
+}
+
+bool
+PropertyCache::GetText( unsigned int aId, unsigned int aIndex, std::string &aValue ) const
+{
+    std::lock_guard<std::mutex> lLock( mMutex );
+
+    const std::map<uint32_t, std::string>::const_iterator lText = mTexts.find( Key( aId, aIndex ) );
+
+    if ( lText == mTexts.end() )
+    {
+        return false;
+    }
+
+    aValue = lText->second;
+    return true;
+}
+
+// *****************************************************************************
+// Function: PropertyCache::Write
+//
+/// \brief   Set a batch of properties and write the configuration once. On
+///          failure the configuration is restored. Either way the properties
+///          written, and the read-only ones derived from them, are read
+///          again: the sensor may adjust the values written. The others are
+///          left as loaded.
+///
+/// \param   aDevice  Connected sensor. Calls on it must be serialized by the
+///                   caller.
+/// \param   aWrites  Properties to set.
+///
+/// \return  LD_SUCCESS or the first LeddarC error.
+// *****************************************************************************
+
+Result
+PropertyCache::Write( Device &aDevice, const std::vector<PropertyWrite> &aWrites )
+{
+    Result lResult;
+
+    for( size_t i=0; lResult.Ok() && ( i<aWrites.size() ); ++i )
+    {
+        const PropertyWrite &lWrite = aWrites[i];
+        const LdProperties   lProperty = static_cast<LdProperties>( lWrite.mId );
+
+        lResult = lWrite.mIsText ? aDevice.SetProperty( lProperty, lWrite.mIndex, lWrite.mText )
+                                 : aDevice.SetProperty( lProperty, lWrite.mIndex, lWrite.mValue );
+    }
+
+    if ( lResult.Ok() )
+    {
+        lResult = aDevice.WriteConfiguration();
+    }
+
+    if ( !lResult.Ok() )
+    {
+        aDevice.RestoreConfiguration();
+    }
+
+    std::set<unsigned int> lIds;
+
+    for( size_t i=0; i<aWrites.size(); ++i )
+    {
+        lIds.insert( aWrites[i].mId );
+        AddDerived( aWrites[i].mId, lIds );
+    }
+
+    unsigned int lSegmentCount;
+
+    {
+        std::lock_guard<std::mutex> lLock( mMutex );
+        lSegmentCount = mSegmentCount;
+    }
+
+    std::map<uint32_t, double>      lValues;
+    std::map<uint32_t, std::string> lTexts;
+
+    for( std::set<unsigned int>::const_iterator lId=lIds.begin(); lId!=lIds.end(); ++lId )
+    {
+        ReadProperty( aDevice, *lId, lSegmentCount, lValues, lTexts );
+    }
+
+    std::lock_guard<std::mutex> lLock( mMutex );
+
+    // Every index of the properties read is replaced, one no longer
+    // readable is dropped.
+    for( std::set<unsigned int>::const_iterator lId=lIds.begin(); lId!=lIds.end(); ++lId )
+    {
+        mValues.erase( mValues.lower_bound( Key( *lId, 0 ) ), mValues.lower_bound( Key( *lId + 1, 0 ) ) );
+        mTexts.erase( mTexts.lower_bound( Key( *lId, 0 ) ), mTexts.lower_bound( Key( *lId + 1, 0 ) ) );
+    }
+
+    mValues.insert( lValues.begin(), lValues.end() );
+    mTexts.insert( lTexts.begin(), lTexts.end() );
+
+    return lResult;
+}
+
+} // namespace leddartech
+
+// End of file PropertyCache.cpp
@@ -0,0 +1,340 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    RayTable.cpp
+///
+/// \brief   Per-segment ray directions, computed once per connection.
+// *****************************************************************************
+
+#include "leddartech/RayTable.h"
+
+#include <angles/angles.h>
+#include <algorithm>
+#include <limits>
+#include <math.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "LeddarProperties.h"
+
+namespace leddartech
+{
+
+// Row-major 3x4 [R|t], the sensor frame itself.
+static const double kIdentity[ 12 ] = { 1, 0, 0, 0,
+                                        0, 1, 0, 0,
+                                        0, 0, 1, 0 };
+
+// *****************************************************************************
+// Class: ProjectKernel
+//
+/// \brief   RayTable::Project for a segment count known at compile time, 0
+///          for the count of the table. Project one echo row of a frame to
+///          3D points. Each point is 4 floats: x, y, z and the amplitude.
+///          Segments without that echo give NaN coordinates and a 0
+///          amplitude.
+// *****************************************************************************
+
+template< unsigned int tSegments >
+struct ProjectKernel
+{
+    typedef RayTable::ProjectFunction Function;
+
+    /// \param   aRays   Ray table.
+    /// \param   aFrame  Segment-binned frame.
+    /// \param   aEcho   Echo row to project.
+    /// \param   aOut    Receives 4 * SegmentCount() floats.
+    static void Run( const RayTable &aRays, const SegmentFrame &aFrame, unsigned int aEcho,
+                     float *aOut )
+    {
+        // The frame has the segments of the table unless it was binned
+        // before a reconfiguration, which takes the generic rows.
+        if ( ( tSegments > 0 ) && ( aFrame.mSegmentCount >= tSegments ) )
+        {
+            Rows( aRays, aFrame, aEcho, aOut, tSegments );
+        }
+        else
+        {
+            ProjectKernel< 0 >::Rows( aRays, aFrame, aEcho, aOut,
+                                      std::min( aRays.mSegmentCount, aFrame.mSegmentCount ) );
+        }
+    }
+
+    static void Rows( const RayTable &aRays, const SegmentFrame &aFrame, unsigned int aEcho,
+                      float *aOut, unsigned int aCount );
+};
+
+template< unsigned int tSegments >
+void
+ProjectKernel< tSegments >::Rows( const RayTable &aRays, const SegmentFrame &aFrame,
+                                  unsigned int aEcho, float *aOut, unsigned int aCount )
+{
+    const float        lNaN = std::numeric_limits<float>::quiet_NaN();
+    const float       *lDistance = aFrame.mDistance[ aEcho ];
+    const float       *lAmplitude = aFrame.mAmplitude[ aEcho ];
+    const unsigned int lSegmentCount = ( tSegments > 0 ) ? tSegments : aRays.mSegmentCount;
+    const unsigned int lCount = ( tSegments > 0 ) ? tSegments : aCount;
+    const float       *lRayX = aRays.mRayX;
+    const float       *lRayY = aRays.mRayY;
+    const float       *lRayZ = aRays.mRayZ;
+    const float       *lOrigin = aRays.mOrigin;
+    unsigned int       i = 0;
+
+#ifdef __SSE2__
+    const __m128  lOriginX = _mm_set1_ps( lOrigin[0] );
+    const __m128  lOriginY = _mm_set1_ps( lOrigin[1] );
+    const __m128  lOriginZ = _mm_set1_ps( lOrigin[2] );
+    const __m128  lInvalid = _mm_set1_ps( lNaN );
+    const __m128i lEcho = _mm_set1_epi32( aEcho );
+    const __m128i lZero = _mm_setzero_si128();
+
+    // 4 segments at a time: compute x, y, z and amplitude as vectors then
+    // transpose them to 4 interleaved points.
+    for( ; i < ( lCount & ~3u ); i += 4 )
+    {
+        int lEchoCounts;
+
+        memcpy( &lEchoCounts, &aFrame.mEchoCount[i], sizeof( lEchoCounts ) );
+
+        __m128i lCounts = _mm_cvtsi32_si128( lEchoCounts );
+        lCounts = _mm_unpacklo_epi16( _mm_unpacklo_epi8( lCounts, lZero ), lZero );
+
+        const __m128 lValid = _mm_castsi128_ps( _mm_cmpgt_epi32( lCounts, lEcho ) );
+        const __m128 lD = _mm_loadu_ps( lDistance + i );
+
+        __m128 lX = _mm_add_ps( lOriginX, _mm_mul_ps( lD, _mm_loadu_ps( lRayX + i ) ) );
+        __m128 lY = _mm_add_ps( lOriginY, _mm_mul_ps( lD, _mm_loadu_ps( lRayY + i ) ) );
+        __m128 lZ = _mm_add_ps( lOriginZ, _mm_mul_ps( lD, _mm_loadu_ps( lRayZ + i ) ) );
+        __m128 lA = _mm_and_ps( lValid, _mm_loadu_ps( lAmplitude + i ) );
+
+        lX = _mm_or_ps( _mm_and_ps( lValid, lX ), _mm_andnot_ps( lValid, lInvalid ) );
+        lY = _mm_or_ps( _mm_and_ps( lValid, lY ), _mm_andnot_ps( lValid, lInvalid ) );
+        lZ = _mm_or_ps( _mm_and_ps( lValid, lZ ), _mm_andnot_ps( lValid, lInvalid ) );
+
+        _MM_TRANSPOSE4_PS( lX, lY, lZ, lA );
+
+        _mm_storeu_ps( aOut + 4*i,      lX );
+        _mm_storeu_ps( aOut + 4*i + 4,  lY );
+        _mm_storeu_ps( aOut + 4*i + 8,  lZ );
+        _mm_storeu_ps( aOut + 4*i + 12, lA );
+    }
+#endif
+
+    for( ; i<lCount; ++i )
+    {
+        float *lPoint = aOut + 4*i;
+
+        if ( aFrame.mEchoCount[i] > aEcho )
+        {
+            lPoint[0] = lOrigin[0] + lDistance[i] * lRayX[i];
+            lPoint[1] = lOrigin[1] + lDistance[i] * lRayY[i];
+            lPoint[2] = lOrigin[2] + lDistance[i] * lRayZ[i];
+            lPoint[3] = lAmplitude[i];
+        }
+        else
+        {
+            lPoint[0] = lPoint[1] = lPoint[2] = lNaN;
+            lPoint[3] = 0;
+        }
+    }
+
+    // Segments the frame does not cover.
+    for( ; i<lSegmentCount; ++i )
+    {
+        float *lPoint = aOut + 4*i;
+
+        lPoint[0] = lPoint[1] = lPoint[2] = lNaN;
+        lPoint[3] = 0;
+    }
+}
+
+const float RayTable::kDefaultRangeMax = 50;
+
+RayTable::RayTable( void )
+{
+    SetUniform( LeddarEvaluationKit::kSegmentCount, LeddarEvaluationKit::kFieldOfView );
+}
+
+// *****************************************************************************
+// Function: RayTable::SetUniform
+//
+/// \brief   Spread the segments evenly over a horizontal field of view. Used
+///          when the sensor does not report its segment geometry. The rays
+///          of a known model are its compile-time tables.
+///
+/// \param   aSegmentCount  Number of segments.
+/// \param   aFieldOfView   Total horizontal field of view in degrees.
+// *****************************************************************************
+
+void
+RayTable::SetUniform( unsigned int aSegmentCount, double aFieldOfView )
+{
+    if ( aSegmentCount > LEDDAR_MAX_SEGMENTS )
+    {
+        aSegmentCount = LEDDAR_MAX_SEGMENTS;
+    }
+
+    const double lWidth = aFieldOfView / aSegmentCount;
+
+    mSegmentCount = aSegmentCount;
+    SelectModel( aFieldOfView );
+
+    if ( mModel == NULL )
+    {
+        for( unsigned int i=0; i<aSegmentCount; ++i )
+        {
+            mAzimuth[i] = angles::from_degrees( -aFieldOfView/2 + ( i + 0.5 ) * lWidth );
+            mElevation[i] = 0;
+        }
+
+        ComputeRays( kIdentity );
+        return;
+    }
+
+    for( unsigned int i=0; i<aSegmentCount; ++i )
+    {
+        mAzimuth[i] = mModel->mAzimuth[i];
+        mElevation[i] = 0;
+        mRayX[i] = mModel->mCos[i];
+        mRayY[i] = mModel->mSin[i];
+        mRayZ[i] = 0;
+    }
+
+    mOrigin[0] = mOrigin[1] = mOrigin[2] = 0;
+}
+
+// *****************************************************************************
+// Function: RayTable::SelectModel
+//
+/// \brief   Find the model of the segment count and field of view, and the
+///          projection kernel of the segment count.
+///
+/// \param   aFieldOfView  Horizontal field of view in degrees.
+// *****************************************************************************
+
+void
+RayTable::SelectModel( double aFieldOfView )
+{
+    mModel = FindSensorModel( mSegmentCount, aFieldOfView );
+    mProject = SelectKernel< ProjectKernel >( mSegmentCount );
+}
+
+// *****************************************************************************
+// Function: RayTable::Load
+//
+/// \brief   Read the segment geometry of the connected sensor (or record)
+///          and match it to a model. Falls back to the field of view of the
+///          first model with that segment count (45 degrees if none) when
+///          the segment properties are not available.
+///
+/// \param   aDevice          Connected sensor or loaded record.
+/// \param   aSegmentCount    Number of segments.
+/// \param   aApplyTransform  Express the rays in the global frame defined by
+///                           PID_GLOBAL_TRANSFORM instead of the sensor frame.
+///
+/// \return  True if the geometry was read from the sensor.
+// *****************************************************************************
+
+bool
+RayTable::Load( const Device &aDevice, unsigned int aSegmentCount, bool aApplyTransform )
+{
+    const SensorModelInfo *lDefault = DefaultSensorModel( aSegmentCount );
+    const double           lDefaultFieldOfView = ( lDefault != NULL ) ? lDefault->mFieldOfView : 45;
+    double                 lMinAngle = std::numeric_limits<double>::infinity();
+    double                 lMaxAngle = -std::numeric_limits<double>::infinity();
+
+    SetUniform( aSegmentCount, lDefaultFieldOfView );
+
+    for( unsigned int i=0; i<mSegmentCount; ++i )
+    {
+        double lLeft, lRight, lTop, lBottom;
+
+        if (    !aDevice.Get<PID_SEGMENT_LEFT>( lLeft, i ).Ok()
+             || !aDevice.Get<PID_SEGMENT_RIGHT>( lRight, i ).Ok() )
+        {
+            SetUniform( aSegmentCount, lDefaultFieldOfView );
+            return false;
+        }
+
+        lMinAngle = std::min( lMinAngle, std::min( lLeft, lRight ) );
+        lMaxAngle = std::max( lMaxAngle, std::max( lLeft, lRight ) );
+
+        if (    !aDevice.Get<PID_SEGMENT_TOP>( lTop, i ).Ok()
+             || !aDevice.Get<PID_SEGMENT_BOTTOM>( lBottom, i ).Ok() )
+        {
+            lTop = lBottom = 0;
+        }
+
+        mAzimuth[i] = angles::from_degrees( ( lLeft + lRight ) / 2 );
+        mElevation[i] = angles::from_degrees( ( lTop + lBottom ) / 2 );
+    }
+
+    SelectModel( lMaxAngle - lMinAngle );
+
+    double lTransform[ 12 ];
+
+    memcpy( lTransform, kIdentity, sizeof( lTransform ) );
+
+    if ( aApplyTransform )
+    {
+        bool lHaveTransform = true;
+
+        // First 3 rows of a row-major 4x4 homogeneous matrix.
+        for( unsigned int i=0; lHaveTransform && ( i<12 ); ++i )
+        {
+            lHaveTransform = aDevice.Get<PID_GLOBAL_TRANSFORM>( lTransform[i], i ).Ok();
+        }
+
+        if ( !lHaveTransform )
+        {
+            double lHeight = 0;
+
+            memcpy( lTransform, kIdentity, sizeof( lTransform ) );
+
+            if ( aDevice.Get<PID_SENSOR_HEIGHT>( lHeight ).Ok() )
+            {
+                lTransform[ 11 ] = lHeight;
+            }
+        }
+    }
+
+    ComputeRays( lTransform );
+
+    return true;
+}
+
+// *****************************************************************************
+// Function: RayTable::ComputeRays
+//
+/// \brief   Compute the unit vector of each segment from its angles, rotated
+///          by the transform, and the origin of the rays.
+///
+/// \param   aTransform  Row-major 3x4 [R|t] transform.
+// *****************************************************************************
+
+void
+RayTable::ComputeRays( const double aTransform[ 12 ] )
+{
+    for( unsigned int i=0; i<mSegmentCount; ++i )
+    {
+        // x forward, y left, z up (REP 103).
+        const double lX = cos( mElevation[i] ) * cos( mAzimuth[i] );
+        const double lY = cos( mElevation[i] ) * sin( mAzimuth[i] );
+        const double lZ = sin( mElevation[i] );
+
+        mRayX[i] = aTransform[0] * lX + aTransform[1] * lY + aTransform[2]  * lZ;
+        mRayY[i] = aTransform[4] * lX + aTransform[5] * lY + aTransform[6]  * lZ;
+        mRayZ[i] = aTransform[8] * lX + aTransform[9] * lY + aTransform[10] * lZ;
+    }
+
+    mOrigin[0] = aTransform[3];
+    mOrigin[1] = aTransform[7];
+    mOrigin[2] = aTransform[11];
+}
+
+} // namespace leddartech
+
+// End of file RayTable.cpp
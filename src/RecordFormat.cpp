@@ -0,0 +1,130 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    RecordFormat.cpp
+///
+/// \brief   Binary format of the frame records written by FrameRecorder.
+// *****************************************************************************
+
+#include "leddartech/RecordFormat.h"
+
+#include <string.h>
+
+namespace leddartech
+{
+
+// *****************************************************************************
+// Function: EncodeFrame
+//
+/// \brief   Write a frame in record format.
+///
+/// \param   aFrame   Segment-binned frame.
+/// \param   aBuffer  Receives the frame, at least kRecordMaxFrameSize bytes.
+///
+/// \return  Bytes written.
+// *****************************************************************************
+
+size_t
+EncodeFrame( const SegmentFrame &aFrame, uint8_t *aBuffer )
+{
+    RecordFrameHeader lHeader;
+    uint8_t          *lDetections = aBuffer + sizeof( lHeader );
+    unsigned int      lCount = 0;
+
+    for( unsigned int s=0; s<aFrame.mSegmentCount; ++s )
+    {
+        for( unsigned int e=0; e<aFrame.mEchoCount[s]; ++e )
+        {
+            RecordDetection lDetection;
+
+            lDetection.mSegment = s;
+            lDetection.mEcho = e;
+            lDetection.mFlags = aFrame.mFlags[e][s];
+            lDetection.mDistance = aFrame.mDistance[e][s];
+            lDetection.mAmplitude = aFrame.mAmplitude[e][s];
+            memcpy( lDetections + lCount * sizeof( lDetection ), &lDetection, sizeof( lDetection ) );
+            ++lCount;
+        }
+    }
+
+    lHeader.mStampSec = aFrame.mStamp.sec;
+    lHeader.mStampNsec = aFrame.mStamp.nsec;
+    lHeader.mArrivalSec = aFrame.mArrival.sec;
+    lHeader.mArrivalNsec = aFrame.mArrival.nsec;
+    lHeader.mRecordIndex = aFrame.mRecordIndex;
+    lHeader.mSegmentCount = aFrame.mSegmentCount;
+    lHeader.mDetectionCount = lCount;
+    memcpy( aBuffer, &lHeader, sizeof( lHeader ) );
+
+    return sizeof( lHeader ) + lCount * sizeof( RecordDetection );
+}
+
+// *****************************************************************************
+// Function: DecodeFrame
+//
+/// \brief   Read a frame in record format.
+///
+/// \param   aBuffer  Frames of a decompressed block, from this frame on.
+/// \param   aSize    Bytes left in the block.
+/// \param   aFrame   Receives the frame.
+///
+/// \return  Bytes read, 0 if the frame is truncated or invalid.
+// *****************************************************************************
+
+size_t
+DecodeFrame( const uint8_t *aBuffer, size_t aSize, SegmentFrame &aFrame )
+{
+    RecordFrameHeader lHeader;
+
+    if ( aSize < sizeof( lHeader ) )
+    {
+        return 0;
+    }
+
+    memcpy( &lHeader, aBuffer, sizeof( lHeader ) );
+
+    const size_t lSize = sizeof( lHeader ) + lHeader.mDetectionCount * sizeof( RecordDetection );
+
+    if ( ( lSize > aSize ) || ( lHeader.mSegmentCount > LEDDAR_MAX_SEGMENTS ) )
+    {
+        return 0;
+    }
+
+    aFrame.mStamp = ros::Time( lHeader.mStampSec, lHeader.mStampNsec );
+    aFrame.mArrival = ros::Time( lHeader.mArrivalSec, lHeader.mArrivalNsec );
+    aFrame.mRecordIndex = lHeader.mRecordIndex;
+    aFrame.mSegmentCount = lHeader.mSegmentCount;
+    memset( aFrame.mEchoCount, 0, sizeof( aFrame.mEchoCount ) );
+
+    const uint8_t *lDetections = aBuffer + sizeof( lHeader );
+
+    for( unsigned int i=0; i<lHeader.mDetectionCount; ++i )
+    {
+        RecordDetection lDetection;
+
+        memcpy( &lDetection, lDetections + i * sizeof( lDetection ), sizeof( lDetection ) );
+
+        const unsigned int s = lDetection.mSegment;
+        const unsigned int e = lDetection.mEcho;
+
+        if ( ( s >= aFrame.mSegmentCount ) || ( e >= LEDDAR_MAX_ECHOES ) )
+        {
+            return 0;
+        }
+
+        aFrame.mDistance[e][s] = lDetection.mDistance;
+        aFrame.mAmplitude[e][s] = lDetection.mAmplitude;
+        aFrame.mFlags[e][s] = lDetection.mFlags;
+
+        if ( e >= aFrame.mEchoCount[s] )
+        {
+            aFrame.mEchoCount[s] = e + 1;
+        }
+    }
+
+    return lSize;
+}
+
+} // namespace leddartech
+
+// End of file RecordFormat.cpp
@@ -0,0 +1,382 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    RecordReader.cpp
+///
+/// \brief   Random access to the frames of a record written by FrameRecorder.
+// *****************************************************************************
+
+#include "leddartech/RecordReader.h"
+
+#include <string.h>
+#include <sys/types.h>
+#include <zlib.h>
+
+#include <algorithm>
+
+#include "leddartech/RecordFormat.h"
+
+namespace leddartech
+{
+
+static const size_t kNoBlock = size_t( -1 );
+
+RecordReader::RecordReader( void )
+    : mFile( NULL ),
+      mSegmentCount( 0 ),
+      mRate( 0 ),
+      mKnownFrames( 0 ),
+      mIndexing( false ),
+      mStop( false ),
+      mLoaded( kNoBlock )
+{
+}
+
+RecordReader::~RecordReader( void )
+{
+    Close();
+}
+
+/// \brief   Whether a path names a record written by FrameRecorder rather
+///          than a LeddarC record.
+bool
+RecordReader::IsRecord( const std::string &aPath )
+{
+    static const std::string kExtension = ".ldrec";
+
+    return    ( aPath.size() > kExtension.size() )
+           && ( aPath.compare( aPath.size() - kExtension.size(), kExtension.size(), kExtension ) == 0 );
+}
+
+// *****************************************************************************
+// Function: RecordReader::Open
+//
+/// \brief   Read the header and index the first block, then start indexing
+///          the rest in the background.
+///
+/// \param   aPath  Record file.
+///
+/// \return  False if it cannot be read or is not a record.
+// *****************************************************************************
+
+bool
+RecordReader::Open( const std::string &aPath )
+{
+    Close();
+
+    RecordFileHeader lHeader;
+    FILE            *lFile = fopen( aPath.c_str(), "rb" );
+
+    if ( lFile == NULL )
+    {
+        return false;
+    }
+
+    if (    ( fread( &lHeader, sizeof( lHeader ), 1, lFile ) != 1 )
+         || ( memcmp( lHeader.mMagic, kRecordMagic, sizeof( lHeader.mMagic ) ) != 0 )
+         || ( lHeader.mVersion != kRecordVersion ) || ( lHeader.mSegmentCount > LEDDAR_MAX_SEGMENTS ) )
+    {
+        fclose( lFile );
+        return false;
+    }
+
+    mPath = aPath;
+    mFile = lFile;
+    mSegmentCount = lHeader.mSegmentCount;
+    mStop = false;
+
+    uint64_t lOffset = sizeof( lHeader );
+    uint32_t lFrameCount;
+    uint64_t lNext;
+
+    // The first block is indexed here so frames are available on return.
+    if ( ReadBlockHeader( mFile, lOffset, lFrameCount, lNext ) )
+    {
+        Block lBlock = { lOffset, 0, lFrameCount };
+
+        mBlocks.push_back( lBlock );
+        mKnownFrames = lFrameCount;
+        lOffset = lNext;
+
+        SegmentFrame lFirst;
+        SegmentFrame lLast;
+
+        if ( ( lFrameCount > 1 ) && Read( 0, lFirst ) && Read( lFrameCount - 1, lLast ) )
+        {
+            const double lSpan = ( lLast.mStamp - lFirst.mStamp ).toSec();
+
+            mRate = ( lSpan > 0 ) ? ( lFrameCount - 1 ) / lSpan : 0;
+        }
+
+        if ( lFrameCount > 0 )
+        {
+            Read( 0, lFirst );
+            mFirstStamp = lFirst.mStamp;
+        }
+    }
+
+    FILE *lIndexFile = fopen( aPath.c_str(), "rb" );
+
+    if ( lIndexFile != NULL )
+    {
+        mIndexing = true;
+        mIndexer = std::thread( &RecordReader::IndexerThread, this, lIndexFile, lOffset );
+    }
+
+    return true;
+}
+
+// *****************************************************************************
+// Function: RecordReader::Close
+//
+/// \brief   Stop indexing and close the record.
+// *****************************************************************************
+
+void
+RecordReader::Close( void )
+{
+    mStop = true;
+
+    if ( mIndexer.joinable() )
+    {
+        mIndexer.join();
+    }
+
+    if ( mFile != NULL )
+    {
+        fclose( mFile );
+        mFile = NULL;
+    }
+
+    std::lock_guard<std::mutex> lLock( mMutex );
+
+    mBlocks.clear();
+    mKnownFrames = 0;
+    mIndexing = false;
+    mLoaded = kNoBlock;
+    mSegmentCount = 0;
+    mRate = 0;
+    mFirstStamp = ros::Time();
+}
+
+/// \brief   Wait for the whole record to be indexed.
+void
+RecordReader::WaitIndexed( void )
+{
+    if ( mIndexer.joinable() )
+    {
+        mIndexer.join();
+    }
+}
+
+// *****************************************************************************
+// Function: RecordReader::ReadBlockHeader
+//
+/// \brief   Read the header of the block at an offset and check that the
+///          block is complete.
+///
+/// \param   aFile        Record file.
+/// \param   aOffset      Of the block header.
+/// \param   aFrameCount  Receives the number of frames of the block.
+/// \param   aNext        Receives the offset of the next block.
+///
+/// \return  False at the end of the file or on a truncated block.
+// *****************************************************************************
+
+bool
+RecordReader::ReadBlockHeader( FILE *aFile, uint64_t aOffset, uint32_t &aFrameCount,
+                               uint64_t &aNext )
+{
+    RecordBlockHeader lHeader;
+
+    if (    ( fseeko( aFile, aOffset, SEEK_SET ) != 0 )
+         || ( fread( &lHeader, sizeof( lHeader ), 1, aFile ) != 1 )
+         || ( memcmp( lHeader.mMagic, kRecordBlockMagic, sizeof( lHeader.mMagic ) ) != 0 ) )
+    {
+        return false;
+    }
+
+    aFrameCount = lHeader.mFrameCount;
+    aNext = aOffset + sizeof( lHeader ) + lHeader.mStoredSize;
+
+    // Only the last byte is read, the payload is skipped.
+    return    ( lHeader.mStoredSize == 0 )
+           || (    ( fseeko( aFile, aNext - 1, SEEK_SET ) == 0 )
+                && ( fgetc( aFile ) != EOF ) );
+}
+
+// *****************************************************************************
+// Function: RecordReader::IndexerThread
+//
+/// \brief   Index the blocks from an offset to the end of the file.
+///
+/// \param   aFile    Own handle on the record, closed on return.
+/// \param   aOffset  Of the first block not indexed yet.
+// *****************************************************************************
+
+void
+RecordReader::IndexerThread( FILE *aFile, uint64_t aOffset )
+{
+    uint32_t lFrameCount;
+    uint64_t lNext;
+
+    while( !mStop.load() && ReadBlockHeader( aFile, aOffset, lFrameCount, lNext ) )
+    {
+        {
+            std::lock_guard<std::mutex> lLock( mMutex );
+            Block                       lBlock = { aOffset, mKnownFrames.load(), lFrameCount };
+
+            mBlocks.push_back( lBlock );
+        }
+
+        mKnownFrames.fetch_add( lFrameCount );
+        aOffset = lNext;
+    }
+
+    fclose( aFile );
+    mIndexing = false;
+}
+
+// *****************************************************************************
+// Function: RecordReader::LoadBlock
+//
+/// \brief   Read and decompress a block and find where its frames start.
+// *****************************************************************************
+
+bool
+RecordReader::LoadBlock( size_t aBlock )
+{
+    Block lBlock;
+
+    {
+        std::lock_guard<std::mutex> lLock( mMutex );
+
+        lBlock = mBlocks[ aBlock ];
+    }
+
+    RecordBlockHeader lHeader;
+
+    mLoaded = kNoBlock;
+
+    if (    ( fseeko( mFile, lBlock.mOffset, SEEK_SET ) != 0 )
+         || ( fread( &lHeader, sizeof( lHeader ), 1, mFile ) != 1 ) )
+    {
+        return false;
+    }
+
+    mStored.resize( lHeader.mStoredSize );
+    mRaw.resize( lHeader.mRawSize );
+
+    if ( ( lHeader.mStoredSize > 0 ) && ( fread( &mStored[0], lHeader.mStoredSize, 1, mFile ) != 1 ) )
+    {
+        return false;
+    }
+
+    if ( lHeader.mCodec == RECORD_CODEC_ZLIB )
+    {
+        uLongf lSize = lHeader.mRawSize;
+
+        if (    ( uncompress( &mRaw[0], &lSize, &mStored[0], lHeader.mStoredSize ) != Z_OK )
+             || ( lSize != lHeader.mRawSize ) )
+        {
+            return false;
+        }
+    }
+    else
+    {
+        mRaw.swap( mStored );
+    }
+
+    mFrameOffsets.clear();
+
+    size_t lOffset = 0;
+
+    for( uint32_t i=0; i<lHeader.mFrameCount; ++i )
+    {
+        RecordFrameHeader lFrame;
+
+        if ( lOffset + sizeof( lFrame ) > mRaw.size() )
+        {
+            return false;
+        }
+
+        memcpy( &lFrame, &mRaw[ lOffset ], sizeof( lFrame ) );
+        mFrameOffsets.push_back( lOffset );
+        lOffset += sizeof( lFrame ) + lFrame.mDetectionCount * sizeof( RecordDetection );
+    }
+
+    mLoaded = aBlock;
+    return true;
+}
+
+// *****************************************************************************
+// Function: RecordReader::Read
+//
+/// \brief   Decode a frame. Not to be called from several threads at once.
+///
+/// \param   aIndex  Index of the frame in the record.
+/// \param   aFrame  Receives the frame.
+///
+/// \return  False if the frame is not indexed (yet) or cannot be read.
+// *****************************************************************************
+
+bool
+RecordReader::Read( uint64_t aIndex, SegmentFrame &aFrame )
+{
+    if ( aIndex >= mKnownFrames.load() )
+    {
+        return false;
+    }
+
+    size_t   lBlock = mLoaded;
+    uint64_t lFirst = 0;
+
+    {
+        std::lock_guard<std::mutex> lLock( mMutex );
+
+        if (    ( lBlock == kNoBlock ) || ( aIndex < mBlocks[ lBlock ].mFirstFrame )
+             || ( aIndex >= mBlocks[ lBlock ].mFirstFrame + mBlocks[ lBlock ].mFrameCount ) )
+        {
+            size_t lLow = 0;
+            size_t lHigh = mBlocks.size();
+
+            // Last block starting at or before aIndex.
+            while( lHigh - lLow > 1 )
+            {
+                const size_t lMiddle = ( lLow + lHigh ) / 2;
+
+                if ( mBlocks[ lMiddle ].mFirstFrame <= aIndex )
+                {
+                    lLow = lMiddle;
+                }
+                else
+                {
+                    lHigh = lMiddle;
+                }
+            }
+
+            lBlock = lLow;
+        }
+
+        lFirst = mBlocks[ lBlock ].mFirstFrame;
+    }
+
+    if ( ( lBlock != mLoaded ) && !LoadBlock( lBlock ) )
+    {
+        return false;
+    }
+
+    const size_t lFrame = aIndex - lFirst;
+
+    if ( lFrame >= mFrameOffsets.size() )
+    {
+        return false;
+    }
+
+    return DecodeFrame( &mRaw[ mFrameOffsets[ lFrame ] ], mRaw.size() - mFrameOffsets[ lFrame ],
+                        aFrame ) > 0;
+}
+
+} // namespace leddartech
+
+// End of file RecordReader.cpp
@@ -0,0 +1,279 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    RecordStats.cpp
+///
+/// \brief   Per-segment statistics over recorded frames.
+// *****************************************************************************
+
+#include "leddartech/RecordStats.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace leddartech
+{
+
+StatsSettings::StatsSettings( void )
+    : mDistanceBin( 0.1 ),
+      mMaxDistance( 50 ),
+      mAmplitudeBin( 1 ),
+      mMaxAmplitude( 200 )
+{
+}
+
+/// \brief   Bin of a value, the last one for values at or above the
+///          maximum.
+static inline size_t
+Bin( double aValue, double aWidth, size_t aCount )
+{
+    if ( aValue <= 0 )
+    {
+        return 0;
+    }
+
+    const size_t lBin = size_t( aValue / aWidth );
+
+    return lBin < aCount ? lBin : aCount - 1;
+}
+
+RecordStats::RecordStats( void )
+    : mFrames( 0 ),
+      mRecords( 0 ),
+      mSegmentCount( 0 )
+{
+    Reset( StatsSettings() );
+}
+
+// *****************************************************************************
+// Function: RecordStats::Reset
+//
+/// \brief   Clear the statistics and size the histograms.
+// *****************************************************************************
+
+void
+RecordStats::Reset( const StatsSettings &aSettings )
+{
+    mSettings = aSettings;
+    mFrames = 0;
+    mRecords = 0;
+    mSegmentCount = 0;
+
+    const size_t lDistanceBins = std::max( 1.0, ceil( aSettings.mMaxDistance / aSettings.mDistanceBin ) );
+    const size_t lAmplitudeBins = std::max( 1.0, ceil( aSettings.mMaxAmplitude / aSettings.mAmplitudeBin ) );
+
+    for( unsigned int s=0; s<LEDDAR_MAX_SEGMENTS; ++s )
+    {
+        SegmentStats &lSegment = mSegments[s];
+
+        lSegment.mFrames = 0;
+        lSegment.mDetected = 0;
+        lSegment.mEchoes = 0;
+        lSegment.mDropouts = 0;
+        lSegment.mLongestDropout = 0;
+        lSegment.mSum = 0;
+        lSegment.mSumSquares = 0;
+        lSegment.mDistance.assign( lDistanceBins, 0 );
+        lSegment.mAmplitude.assign( lAmplitudeBins, 0 );
+        mRun[s] = 0;
+    }
+}
+
+/// \brief   Start a record, drop-outs do not span records.
+void
+RecordStats::BeginRecord( unsigned int aSegmentCount )
+{
+    memset( mRun, 0, sizeof( mRun ) );
+    mSegmentCount = std::max( mSegmentCount, std::min<unsigned int>( aSegmentCount, LEDDAR_MAX_SEGMENTS ) );
+    ++mRecords;
+}
+
+void
+RecordStats::EndRecord( void )
+{
+    memset( mRun, 0, sizeof( mRun ) );
+}
+
+// *****************************************************************************
+// Function: RecordStats::Add
+//
+/// \brief   Count a frame of the current record, binned with the segment
+///          count of that record.
+// *****************************************************************************
+
+void
+RecordStats::Add( const SegmentFrame &aFrame )
+{
+    const unsigned int lSegmentCount = std::min<unsigned int>( aFrame.mSegmentCount, mSegmentCount );
+    const size_t       lDistanceBins = mSegments[0].mDistance.size();
+    const size_t       lAmplitudeBins = mSegments[0].mAmplitude.size();
+
+    ++mFrames;
+
+    for( unsigned int s=0; s<lSegmentCount; ++s )
+    {
+        SegmentStats      &lSegment = mSegments[s];
+        const unsigned int lEchoCount = aFrame.mEchoCount[s];
+
+        ++lSegment.mFrames;
+
+        if ( lEchoCount == 0 )
+        {
+            if ( mRun[s]++ == 0 )
+            {
+                ++lSegment.mDropouts;
+            }
+
+            lSegment.mLongestDropout = std::max( lSegment.mLongestDropout, mRun[s] );
+            continue;
+        }
+
+        const double lNearest = aFrame.mDistance[0][s];
+
+        mRun[s] = 0;
+        ++lSegment.mDetected;
+        lSegment.mEchoes += lEchoCount;
+        lSegment.mSum += lNearest;
+        lSegment.mSumSquares += lNearest * lNearest;
+
+        for( unsigned int e=0; e<lEchoCount; ++e )
+        {
+            ++lSegment.mDistance[ Bin( aFrame.mDistance[e][s], mSettings.mDistanceBin, lDistanceBins ) ];
+            ++lSegment.mAmplitude[ Bin( aFrame.mAmplitude[e][s], mSettings.mAmplitudeBin, lAmplitudeBins ) ];
+        }
+    }
+}
+
+// *****************************************************************************
+// Function: RecordStats::Merge
+//
+/// \brief   Add the statistics gathered by another instance, reset with the
+///          same settings.
+// *****************************************************************************
+
+void
+RecordStats::Merge( const RecordStats &aOther )
+{
+    mFrames += aOther.mFrames;
+    mRecords += aOther.mRecords;
+    mSegmentCount = std::max( mSegmentCount, aOther.mSegmentCount );
+
+    for( unsigned int s=0; s<aOther.mSegmentCount; ++s )
+    {
+        SegmentStats       &lSegment = mSegments[s];
+        const SegmentStats &lOther = aOther.mSegments[s];
+
+        lSegment.mFrames += lOther.mFrames;
+        lSegment.mDetected += lOther.mDetected;
+        lSegment.mEchoes += lOther.mEchoes;
+        lSegment.mDropouts += lOther.mDropouts;
+        lSegment.mLongestDropout = std::max( lSegment.mLongestDropout, lOther.mLongestDropout );
+        lSegment.mSum += lOther.mSum;
+        lSegment.mSumSquares += lOther.mSumSquares;
+
+        for( size_t i=0; i<lSegment.mDistance.size(); ++i )
+        {
+            lSegment.mDistance[i] += lOther.mDistance[i];
+        }
+
+        for( size_t i=0; i<lSegment.mAmplitude.size(); ++i )
+        {
+            lSegment.mAmplitude[i] += lOther.mAmplitude[i];
+        }
+    }
+}
+
+// *****************************************************************************
+// Function: RecordStats::WriteSegments
+//
+/// \brief   Write the detection rate and drop-out map as CSV, one line per
+///          segment. Rates are over the frames of the records that have the
+///          segment.
+///
+/// \return  False if the file could not be written.
+// *****************************************************************************
+
+bool
+RecordStats::WriteSegments( const std::string &aPath ) const
+{
+    FILE *lFile = fopen( aPath.c_str(), "w" );
+
+    if ( lFile == NULL )
+    {
+        return false;
+    }
+
+    fprintf( lFile, "# %u records, %llu frames\n", mRecords, (unsigned long long) mFrames );
+    fprintf( lFile, "segment,detection_rate,echoes_per_frame,dropouts,longest_dropout,"
+                    "mean_distance,std_distance\n" );
+
+    for( unsigned int s=0; s<mSegmentCount; ++s )
+    {
+        const SegmentStats &lSegment = mSegments[s];
+        const double        lFrames = lSegment.mFrames > 0 ? double( lSegment.mFrames ) : 1;
+        const double        lDetected = lSegment.mDetected > 0 ? double( lSegment.mDetected ) : 1;
+        const double        lMean = lSegment.mSum / lDetected;
+        const double        lVariance = lSegment.mSumSquares / lDetected - lMean * lMean;
+
+        fprintf( lFile, "%u,%.6f,%.4f,%llu,%llu,%.4f,%.4f\n", s, lSegment.mDetected / lFrames,
+                 lSegment.mEchoes / lFrames, (unsigned long long) lSegment.mDropouts,
+                 (unsigned long long) lSegment.mLongestDropout, lMean,
+                 sqrt( std::max( lVariance, 0.0 ) ) );
+    }
+
+    return fclose( lFile ) == 0;
+}
+
+// *****************************************************************************
+// Function: RecordStats::WriteHistograms
+//
+/// \brief   Write the distance and amplitude histograms as CSV, one line per
+///          segment and bin, empty bins skipped.
+///
+/// \return  False if the file could not be written.
+// *****************************************************************************
+
+bool
+RecordStats::WriteHistograms( const std::string &aPath ) const
+{
+    FILE *lFile = fopen( aPath.c_str(), "w" );
+
+    if ( lFile == NULL )
+    {
+        return false;
+    }
+
+    fprintf( lFile, "segment,quantity,bin_start,bin_width,count\n" );
+
+    for( unsigned int s=0; s<mSegmentCount; ++s )
+    {
+        const SegmentStats &lSegment = mSegments[s];
+
+        for( size_t i=0; i<lSegment.mDistance.size(); ++i )
+        {
+            if ( lSegment.mDistance[i] > 0 )
+            {
+                fprintf( lFile, "%u,distance,%g,%g,%llu\n", s, i * mSettings.mDistanceBin,
+                         mSettings.mDistanceBin, (unsigned long long) lSegment.mDistance[i] );
+            }
+        }
+
+        for( size_t i=0; i<lSegment.mAmplitude.size(); ++i )
+        {
+            if ( lSegment.mAmplitude[i] > 0 )
+            {
+                fprintf( lFile, "%u,amplitude,%g,%g,%llu\n", s, i * mSettings.mAmplitudeBin,
+                         mSettings.mAmplitudeBin, (unsigned long long) lSegment.mAmplitude[i] );
+            }
+        }
+    }
+
+    return fclose( lFile ) == 0;
+}
+
+} // namespace leddartech
+
+// End of file RecordStats.cpp
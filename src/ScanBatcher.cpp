@@ -0,0 +1,166 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    ScanBatcher.cpp
+///
+/// \brief   Pack consecutive segment-binned frames into ScanBatch messages.
+// *****************************************************************************
+
+#include "leddartech/ScanBatcher.h"
+
+#include <limits>
+
+namespace leddartech
+{
+
+// Batches preallocated. A batch is published at a fraction of the frame
+// rate, so a couple are enough for subscribers to release theirs.
+static const size_t kPoolSize = 2;
+
+ScanBatcher::ScanBatcher( void )
+    : mCount( 0 ),
+      mFrames( 0 ),
+      mMaxLatency( 0 ),
+      mSequence( 0 )
+{
+}
+
+// *****************************************************************************
+// Function: ScanBatcher::Configure
+//
+/// \brief   Size the batches and allocate the pool. Must not be called while
+///          Add may run on another thread; a batch being filled is dropped.
+///
+/// \param   aRays        Segment geometry of the sensor.
+/// \param   aFrameId     Frame id of the batches.
+/// \param   aEchoes      Echo rows kept per frame (1 to LEDDAR_MAX_ECHOES).
+/// \param   aFrames      Frames per batch, 0 disables batching.
+/// \param   aMaxLatency  Complete a batch once its frames span this long
+///                       (s), 0 for no limit.
+// *****************************************************************************
+
+void
+ScanBatcher::Configure( const RayTable &aRays, const std::string &aFrameId, unsigned int aEchoes,
+                        unsigned int aFrames, double aMaxLatency )
+{
+    const unsigned int lSegmentCount = aRays.SegmentCount();
+
+    if ( aEchoes < 1 )
+    {
+        aEchoes = 1;
+    }
+    else if ( aEchoes > LEDDAR_MAX_ECHOES )
+    {
+        aEchoes = LEDDAR_MAX_ECHOES;
+    }
+
+    mFrames = aFrames;
+    mMaxLatency = aMaxLatency;
+    mCurrent.reset();
+    mCount = 0;
+
+    mBatch.header.frame_id = aFrameId;
+    mBatch.segments = lSegmentCount;
+    mBatch.echoes = aEchoes;
+    mBatch.angle_min = aRays.Azimuth( 0 );
+    mBatch.angle_max = aRays.Azimuth( lSegmentCount - 1 );
+    mBatch.stamps.resize( aFrames );
+    mBatch.ranges.assign( aFrames * aEchoes * lSegmentCount, std::numeric_limits<float>::infinity() );
+    mBatch.intensities.assign( aFrames * aEchoes * lSegmentCount, 0 );
+
+    mPool.Reset( mBatch, aFrames > 0 ? kPoolSize : 0 );
+}
+
+// *****************************************************************************
+// Function: ScanBatcher::Add
+//
+/// \brief   Append a frame to the current batch, starting one if needed.
+///
+/// \param   aFrame  Stamped, segment-binned frame.
+///
+/// \return  The batch if this frame completed it, null otherwise. Never
+///          modified once returned.
+// *****************************************************************************
+
+ScanBatch::ConstPtr
+ScanBatcher::Add( const SegmentFrame &aFrame )
+{
+    if ( mFrames == 0 )
+    {
+        return ScanBatch::ConstPtr();
+    }
+
+    if ( !mCurrent )
+    {
+        mCurrent = mPool.Acquire( mBatch );
+        mCount = 0;
+
+        // A flushed batch was shortened, the capacity is still there.
+        mCurrent->stamps.resize( mBatch.stamps.size() );
+        mCurrent->ranges.resize( mBatch.ranges.size() );
+        mCurrent->intensities.resize( mBatch.intensities.size() );
+        mCurrent->header.stamp = aFrame.mStamp;
+    }
+
+    const unsigned int lSegments = mBatch.segments;
+    const unsigned int lEchoes = mBatch.echoes;
+    float             *lRanges = &mCurrent->ranges[ mCount * lEchoes * lSegments ];
+    float             *lIntensities = &mCurrent->intensities[ mCount * lEchoes * lSegments ];
+
+    mCurrent->stamps[ mCount ] = aFrame.mStamp;
+
+    for( unsigned int e=0; e<lEchoes; ++e )
+    {
+        for( unsigned int s=0; s<lSegments; ++s )
+        {
+            const bool lValid = ( s < aFrame.mSegmentCount ) && ( e < aFrame.mEchoCount[s] );
+
+            lRanges[ e * lSegments + s ] = lValid ? aFrame.mDistance[e][s]
+                                                  : std::numeric_limits<float>::infinity();
+            lIntensities[ e * lSegments + s ] = lValid ? aFrame.mAmplitude[e][s] : 0;
+        }
+    }
+
+    ++mCount;
+
+    if (    ( mCount == mFrames )
+         || ( ( mMaxLatency > 0 ) && ( ( aFrame.mStamp - mCurrent->header.stamp ).toSec() >= mMaxLatency ) ) )
+    {
+        return Flush();
+    }
+
+    return ScanBatch::ConstPtr();
+}
+
+// *****************************************************************************
+// Function: ScanBatcher::Flush
+//
+/// \brief   Complete the current batch with the frames it has.
+///
+/// \return  The batch, null if there is none.
+// *****************************************************************************
+
+ScanBatch::ConstPtr
+ScanBatcher::Flush( void )
+{
+    if ( !mCurrent )
+    {
+        return ScanBatch::ConstPtr();
+    }
+
+    const size_t lValues = mCount * mBatch.echoes * mBatch.segments;
+
+    mCurrent->header.seq = mSequence++;
+    mCurrent->stamps.resize( mCount );
+    mCurrent->ranges.resize( lValues );
+    mCurrent->intensities.resize( lValues );
+
+    ScanBatch::ConstPtr lBatch = mCurrent;
+
+    mCurrent.reset();
+    return lBatch;
+}
+
+} // namespace leddartech
+
+// End of file ScanBatcher.cpp
@@ -0,0 +1,255 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    ScanBuilder.cpp
+///
+/// \brief   Build scan and point cloud messages from segment-binned frames
+///          without allocating.
+// *****************************************************************************
+
+#include "leddartech/ScanBuilder.h"
+
+#include <limits>
+
+#include "leddartech/SensorModel.h"
+
+namespace leddartech
+{
+
+// Messages preallocated per type. Enough for a subscriber queue of a few
+// messages, the pools grow if subscribers hold on to more.
+static const size_t kPoolSize = 4;
+
+namespace
+{
+
+// *****************************************************************************
+// Class: ScanKernel
+//
+/// \brief   Fill the ranges and intensities of a single echo scan, for a
+///          segment count known at compile time, 0 for the size of the scan.
+// *****************************************************************************
+
+template< unsigned int tSegments >
+struct ScanKernel
+{
+    typedef void (*Function)( const SegmentFrame &, sensor_msgs::LaserScan & );
+
+    static void Run( const SegmentFrame &aFrame, sensor_msgs::LaserScan &aScan )
+    {
+        const unsigned int lSize = ( tSegments > 0 ) ? tSegments : aScan.ranges.size();
+        float             *lRanges = &aScan.ranges[0];
+        float             *lIntensities = &aScan.intensities[0];
+
+        for( unsigned int i=0; i<lSize; ++i )
+        {
+            // Segments without a detection are reported as out of range (REP 117).
+            if ( ( i < aFrame.mSegmentCount ) && ( aFrame.mEchoCount[i] > 0 ) )
+            {
+                lRanges[i] = aFrame.mDistance[0][i];
+                lIntensities[i] = aFrame.mAmplitude[0][i];
+            }
+            else
+            {
+                lRanges[i] = std::numeric_limits<float>::infinity();
+                lIntensities[i] = 0;
+            }
+        }
+    }
+};
+
+} // namespace
+
+ScanBuilder::ScanBuilder( void )
+{
+    Configure( RayTable(), "leddar_base_link", "leddar_base_link", 1 );
+}
+
+// *****************************************************************************
+// Function: ScanBuilder::Configure
+//
+/// \brief   Set the constant part of the messages and allocate the ranges,
+///          intensities, echoes and points of the pooled messages. Must not
+///          be called while Build may run on another thread. Messages still
+///          held by subscribers are left to them.
+///
+/// \param   aRays          Segment geometry of the sensor.
+/// \param   aFrameId       Frame id of the published scans.
+/// \param   aCloudFrameId  Frame id of the point cloud (the frame of the
+///                         rays).
+/// \param   aCloudEchoes   Number of echo rows of the organized cloud.
+// *****************************************************************************
+
+void
+ScanBuilder::Configure( const RayTable &aRays, const std::string &aFrameId,
+                        const std::string &aCloudFrameId, unsigned int aCloudEchoes )
+{
+    const unsigned int lSegmentCount = aRays.SegmentCount();
+
+    mRays = aRays;
+
+    // The scan angles are the centers of the first and last segments.
+    mScan.header.frame_id    = aFrameId;
+    mScan.angle_min          = aRays.Azimuth( 0 );
+    mScan.angle_max          = aRays.Azimuth( lSegmentCount - 1 );
+    mScan.angle_increment    = ( lSegmentCount > 1 )
+                               ? ( mScan.angle_max - mScan.angle_min ) / ( lSegmentCount - 1 )
+                               : 0;
+    mScan.range_min          = 0;
+    mScan.range_max          = aRays.RangeMax();
+
+    mScan.ranges.assign( lSegmentCount, std::numeric_limits<float>::infinity() );
+    mScan.intensities.assign( lSegmentCount, 0 );
+
+    mMultiEchoScan.header.frame_id = mScan.header.frame_id;
+    mMultiEchoScan.angle_min       = mScan.angle_min;
+    mMultiEchoScan.angle_max       = mScan.angle_max;
+    mMultiEchoScan.angle_increment = mScan.angle_increment;
+    mMultiEchoScan.range_min       = mScan.range_min;
+    mMultiEchoScan.range_max       = mScan.range_max;
+
+    // Echo vectors sized for the most echoes: the pooled copies get that
+    // capacity, so resizing them to the echo count never allocates.
+    sensor_msgs::LaserEcho lEchoes;
+
+    lEchoes.echoes.assign( LEDDAR_MAX_ECHOES, std::numeric_limits<float>::infinity() );
+    mMultiEchoScan.ranges.assign( lSegmentCount, lEchoes );
+    mMultiEchoScan.intensities.assign( lSegmentCount, lEchoes );
+
+    if ( aCloudEchoes < 1 )
+    {
+        aCloudEchoes = 1;
+    }
+    else if ( aCloudEchoes > LEDDAR_MAX_ECHOES )
+    {
+        aCloudEchoes = LEDDAR_MAX_ECHOES;
+    }
+
+    // Organized cloud: one row per echo, one column per segment.
+    static const char *const kFieldNames[] = { "x", "y", "z", "intensity" };
+
+    mCloud.header.frame_id = aCloudFrameId;
+    mCloud.height = aCloudEchoes;
+    mCloud.width = lSegmentCount;
+    mCloud.fields.resize( 4 );
+
+    for( unsigned int i=0; i<4; ++i )
+    {
+        mCloud.fields[i].name = kFieldNames[i];
+        mCloud.fields[i].offset = i * sizeof( float );
+        mCloud.fields[i].datatype = sensor_msgs::PointField::FLOAT32;
+        mCloud.fields[i].count = 1;
+    }
+
+    mCloud.is_bigendian = false;
+    mCloud.point_step = 4 * sizeof( float );
+    mCloud.row_step = mCloud.point_step * mCloud.width;
+    mCloud.is_dense = false;
+    mCloud.data.assign( mCloud.row_step * mCloud.height, 0 );
+
+    mScanPool.Reset( mScan, kPoolSize );
+    mMultiEchoPool.Reset( mMultiEchoScan, kPoolSize );
+    mCloudPool.Reset( mCloud, kPoolSize );
+
+    mFillScan = SelectKernel< ScanKernel >( lSegmentCount );
+}
+
+// *****************************************************************************
+// Function: ScanBuilder::Build
+//
+/// \brief   Fill a single echo scan with the nearest echo of each segment
+///          and its amplitude. Once configured no memory is allocated as
+///          long as subscribers release their messages.
+///
+/// \param   aFrame     Segment-binned detections.
+/// \param   aSequence  Sequence number of the message.
+///
+/// \return  The message, never modified once returned.
+// *****************************************************************************
+
+sensor_msgs::LaserScan::ConstPtr
+ScanBuilder::Build( const SegmentFrame &aFrame, uint32_t aSequence )
+{
+    sensor_msgs::LaserScan::Ptr lScan = mScanPool.Acquire( mScan );
+
+    lScan->header.stamp = aFrame.mStamp;
+    lScan->header.seq   = aSequence;
+
+    mFillScan( aFrame, *lScan );
+
+    return lScan;
+}
+
+// *****************************************************************************
+// Function: ScanBuilder::BuildMultiEcho
+//
+/// \brief   Fill a multi echo scan with every echo of each segment, nearest
+///          first. The echo vectors of the pooled messages have room for
+///          LEDDAR_MAX_ECHOES (see Configure), nothing is allocated.
+///
+/// \param   aFrame     Segment-binned detections.
+/// \param   aSequence  Sequence number of the message.
+///
+/// \return  The message, never modified once returned.
+// *****************************************************************************
+
+sensor_msgs::MultiEchoLaserScan::ConstPtr
+ScanBuilder::BuildMultiEcho( const SegmentFrame &aFrame, uint32_t aSequence )
+{
+    sensor_msgs::MultiEchoLaserScan::Ptr lScan = mMultiEchoPool.Acquire( mMultiEchoScan );
+    const unsigned int                   lSize = lScan->ranges.size();
+
+    lScan->header.stamp = aFrame.mStamp;
+    lScan->header.seq   = aSequence;
+
+    for( unsigned int i=0; i<lSize; ++i )
+    {
+        const unsigned int lEchoes = ( i < aFrame.mSegmentCount ) ? aFrame.mEchoCount[i] : 0;
+        std::vector<float> &lRanges = lScan->ranges[i].echoes;
+        std::vector<float> &lIntensities = lScan->intensities[i].echoes;
+
+        lRanges.resize( lEchoes );
+        lIntensities.resize( lEchoes );
+
+        for( unsigned int e=0; e<lEchoes; ++e )
+        {
+            lRanges[e] = aFrame.mDistance[e][i];
+            lIntensities[e] = aFrame.mAmplitude[e][i];
+        }
+    }
+
+    return lScan;
+}
+
+// *****************************************************************************
+// Function: ScanBuilder::BuildCloud
+//
+/// \brief   Fill an organized point cloud, projecting every echo row with
+///          the cached rays straight into the message buffer.
+///
+/// \param   aFrame     Segment-binned detections.
+/// \param   aSequence  Sequence number of the message.
+///
+/// \return  The message, never modified once returned.
+// *****************************************************************************
+
+sensor_msgs::PointCloud2::ConstPtr
+ScanBuilder::BuildCloud( const SegmentFrame &aFrame, uint32_t aSequence )
+{
+    sensor_msgs::PointCloud2::Ptr lCloud = mCloudPool.Acquire( mCloud );
+
+    lCloud->header.stamp = aFrame.mStamp;
+    lCloud->header.seq   = aSequence;
+
+    for( unsigned int e=0; e<lCloud->height; ++e )
+    {
+        mRays.Project( aFrame, e,
+                       reinterpret_cast<float *>( &lCloud->data[ e * lCloud->row_step ] ) );
+    }
+
+    return lCloud;
+}
+
+} // namespace leddartech
+
+// End of file ScanBuilder.cpp
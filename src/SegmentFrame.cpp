@@ -0,0 +1,121 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    SegmentFrame.cpp
+///
+/// \brief   Detections of a frame binned by segment.
+// *****************************************************************************
+
+#include "leddartech/SegmentFrame.h"
+
+#include <string.h>
+
+#include "leddartech/SensorModel.h"
+
+namespace leddartech
+{
+
+namespace
+{
+
+// *****************************************************************************
+// Class: BinKernel
+//
+/// \brief   BinDetections for a segment count known at compile time, 0 for
+///          the count passed.
+// *****************************************************************************
+
+template< unsigned int tSegments >
+struct BinKernel
+{
+    typedef void (*Function)( const LeddarFrame &, unsigned int, SegmentFrame &, float );
+
+    static void Run( const LeddarFrame &aFrame, unsigned int aSegmentCount, SegmentFrame &aBinned,
+                     float aMinAmplitude )
+    {
+        const unsigned int lSegmentCount = ( tSegments > 0 ) ? tSegments : aSegmentCount;
+
+        aBinned.mArrival = aFrame.mArrival;
+        aBinned.mStamp = aFrame.mArrival;
+        aBinned.mRecordIndex = aFrame.mRecordIndex;
+        aBinned.mSegmentCount = lSegmentCount;
+        memset( aBinned.mEchoCount, 0, lSegmentCount );
+
+        for( unsigned int i=0; i<aFrame.mCount; ++i )
+        {
+            const LdDetection &lDetection = aFrame.mDetections[i];
+            const unsigned int lSegment = lDetection.mSegment;
+
+            if ( ( lSegment >= lSegmentCount ) || !( lDetection.mFlags & LEDDAR_FLAG_VALID )
+                 || ( lDetection.mAmplitude < aMinAmplitude ) )
+            {
+                continue;
+            }
+
+            unsigned int lEcho = aBinned.mEchoCount[ lSegment ];
+
+            // Segment full: keep the nearest echoes only.
+            if ( lEcho == LEDDAR_MAX_ECHOES )
+            {
+                if ( lDetection.mDistance >= aBinned.mDistance[ lEcho-1 ][ lSegment ] )
+                {
+                    continue;
+                }
+
+                --lEcho;
+            }
+            else
+            {
+                ++aBinned.mEchoCount[ lSegment ];
+            }
+
+            while( ( lEcho > 0 ) && ( aBinned.mDistance[ lEcho-1 ][ lSegment ] > lDetection.mDistance ) )
+            {
+                aBinned.mDistance[ lEcho ][ lSegment ] = aBinned.mDistance[ lEcho-1 ][ lSegment ];
+                aBinned.mAmplitude[ lEcho ][ lSegment ] = aBinned.mAmplitude[ lEcho-1 ][ lSegment ];
+                aBinned.mFlags[ lEcho ][ lSegment ] = aBinned.mFlags[ lEcho-1 ][ lSegment ];
+                --lEcho;
+            }
+
+            aBinned.mDistance[ lEcho ][ lSegment ] = lDetection.mDistance;
+            aBinned.mAmplitude[ lEcho ][ lSegment ] = lDetection.mAmplitude;
+            aBinned.mFlags[ lEcho ][ lSegment ] = lDetection.mFlags;
+        }
+    }
+};
+
+} // namespace
+
+// *****************************************************************************
+// Function: BinDetections
+//
+/// \brief   Sort the detections of a frame into their segments, nearest echo
+///          first. Single pass over the detections with an insertion into
+///          at most LEDDAR_MAX_ECHOES slots, nothing is allocated. Invalid
+///          detections, detections of unknown segments and detections
+///          weaker than aMinAmplitude are skipped. Runs the kernel of the
+///          segment count when it is the count of a known model.
+///
+/// \param   aFrame         Raw detections.
+/// \param   aSegmentCount  Number of segments of the sensor (clamped to
+///                         LEDDAR_MAX_SEGMENTS).
+/// \param   aBinned        Receives the binned detections.
+/// \param   aMinAmplitude  Reject detections below this amplitude (outliers
+///                         from noise or crosstalk), 0 keeps all.
+// *****************************************************************************
+
+void
+BinDetections( const LeddarFrame &aFrame, unsigned int aSegmentCount,
+               SegmentFrame &aBinned, float aMinAmplitude )
+{
+    if ( aSegmentCount > LEDDAR_MAX_SEGMENTS )
+    {
+        aSegmentCount = LEDDAR_MAX_SEGMENTS;
+    }
+
+    SelectKernel< BinKernel >( aSegmentCount )( aFrame, aSegmentCount, aBinned, aMinAmplitude );
+}
+
+} // namespace leddartech
+
+// End of file SegmentFrame.cpp
@@ -0,0 +1,74 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    SensorModel.cpp
+///
+/// \brief   Run-time selection of the sensor model.
+// *****************************************************************************
+
+#include "leddartech/SensorModel.h"
+
+#include <math.h>
+
+#define ARRAY_LEN( a )  (sizeof(a)/sizeof(a[0]))
+
+namespace leddartech
+{
+
+// First model of each segment count is its default.
+static const SensorModelInfo kModels[] =
+{
+    MakeModelInfo< LeddarEvaluationKit >( "evaluation_kit" ),
+    MakeModelInfo< LeddarM16 >( "m16" ),
+    MakeModelInfo< LeddarVu8 >( "vu8" ),
+    MakeModelInfo< LeddarOne >( "one" )
+};
+
+// Fields of view within this many degrees are the same model.
+static const double kFieldOfViewTolerance = 1.0;
+
+// *****************************************************************************
+// Function: FindSensorModel
+//
+/// \brief   Model with a segment count and field of view.
+///
+/// \param   aSegmentCount  Number of segments of the sensor.
+/// \param   aFieldOfView   Degrees, spanned by the segments of the sensor.
+///
+/// \return  The model, null if none matches.
+// *****************************************************************************
+
+const SensorModelInfo *
+FindSensorModel( unsigned int aSegmentCount, double aFieldOfView )
+{
+    for( size_t i=0; i<ARRAY_LEN( kModels ); ++i )
+    {
+        if (    ( kModels[i].mSegmentCount == aSegmentCount )
+             && ( fabs( kModels[i].mFieldOfView - aFieldOfView ) <= kFieldOfViewTolerance ) )
+        {
+            return &kModels[i];
+        }
+    }
+
+    return NULL;
+}
+
+/// \brief   First model with a segment count, for a sensor that does not
+///          report its geometry. Null if none.
+const SensorModelInfo *
+DefaultSensorModel( unsigned int aSegmentCount )
+{
+    for( size_t i=0; i<ARRAY_LEN( kModels ); ++i )
+    {
+        if ( kModels[i].mSegmentCount == aSegmentCount )
+        {
+            return &kModels[i];
+        }
+    }
+
+    return NULL;
+}
+
+} // namespace leddartech
+
+// End of file SensorModel.cpp
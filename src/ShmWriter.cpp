@@ -0,0 +1,181 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    ShmWriter.cpp
+///
+/// \brief   Writer of the shared-memory frame ring.
+// *****************************************************************************
+
+#include "leddartech/ShmWriter.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ros/ros.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace leddartech
+{
+
+static_assert( ( LEDDAR_SHM_MAX_SEGMENTS == LEDDAR_MAX_SEGMENTS )
+               && ( LEDDAR_SHM_MAX_ECHOES == LEDDAR_MAX_ECHOES ),
+               "LeddarShmFrame must hold a SegmentFrame" );
+
+ShmWriter::ShmWriter( void )
+    : mHeader( NULL ),
+      mSlots( NULL ),
+      mSize( 0 ),
+      mWritten( 0 )
+{
+}
+
+ShmWriter::~ShmWriter( void )
+{
+    Close();
+}
+
+// *****************************************************************************
+// Function: ShmWriter::Open
+//
+/// \brief   Create the ring, replacing one left by a writer that did not
+///          close it.
+///
+/// \param   aName          Shared memory object, a leading / is added if
+///                         missing.
+/// \param   aSlotCount     Frames kept.
+/// \param   aSegmentCount  Number of segments of the sensor.
+///
+/// \return  False if it could not be created.
+// *****************************************************************************
+
+bool
+ShmWriter::Open( const std::string &aName, unsigned int aSlotCount, unsigned int aSegmentCount )
+{
+    Close();
+
+    mName = ( !aName.empty() && ( aName[0] == '/' ) ) ? aName : "/" + aName;
+    aSlotCount = std::max( aSlotCount, 2u );
+
+    // A new object, readers of a stale one keep it until they reopen.
+    shm_unlink( mName.c_str() );
+
+    const int lFd = shm_open( mName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644 );
+
+    if ( lFd < 0 )
+    {
+        ROS_ERROR( "Failed to create the shared memory %s: %s.", mName.c_str(), strerror( errno ) );
+        return false;
+    }
+
+    const size_t lSize = sizeof( LeddarShmHeader ) + aSlotCount * sizeof( LeddarShmSlot );
+    void        *lMap = MAP_FAILED;
+
+    if ( ftruncate( lFd, lSize ) == 0 )
+    {
+        lMap = mmap( NULL, lSize, PROT_READ | PROT_WRITE, MAP_SHARED, lFd, 0 );
+    }
+
+    close( lFd );
+
+    if ( lMap == MAP_FAILED )
+    {
+        ROS_ERROR( "Failed to map the shared memory %s: %s.", mName.c_str(), strerror( errno ) );
+        shm_unlink( mName.c_str() );
+        return false;
+    }
+
+    // Fresh pages are zero: every slot sequence is even and empty.
+    mHeader = static_cast<LeddarShmHeader *>( lMap );
+    mSlots = reinterpret_cast<LeddarShmSlot *>( mHeader + 1 );
+    mSize = lSize;
+    mWritten = 0;
+
+    mHeader->mVersion = LEDDAR_SHM_VERSION;
+    mHeader->mSlotCount = aSlotCount;
+    mHeader->mSlotSize = sizeof( LeddarShmSlot );
+    mHeader->mSegmentCount = aSegmentCount;
+    mHeader->mWriterId = getpid();
+    mHeader->mActive = 1;
+
+    // Readers check the magic first, it comes last.
+    __atomic_store_n( &mHeader->mMagic, LEDDAR_SHM_MAGIC, __ATOMIC_RELEASE );
+    return true;
+}
+
+// *****************************************************************************
+// Function: ShmWriter::Write
+//
+/// \brief   Copy a frame to the next slot and publish it.
+///
+/// \param   aFrame  Stamped, segment-binned frame.
+// *****************************************************************************
+
+void
+ShmWriter::Write( const SegmentFrame &aFrame )
+{
+    if ( mHeader == NULL )
+    {
+        return;
+    }
+
+    LeddarShmSlot     &lSlot = mSlots[ mWritten % mHeader->mSlotCount ];
+    LeddarShmFrame    &lFrame = lSlot.mFrame;
+    const uint32_t     lSequence = lSlot.mSequence;
+    const unsigned int lSegments = std::min<unsigned int>( aFrame.mSegmentCount, LEDDAR_MAX_SEGMENTS );
+    unsigned int       lEchoes = 0;
+    struct timespec    lNow;
+
+    clock_gettime( CLOCK_REALTIME, &lNow );
+
+    // Odd: readers of this slot retry until it is written.
+    __atomic_store_n( &lSlot.mSequence, lSequence + 1, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+
+    lFrame.mIndex = mWritten;
+    lFrame.mStamp = aFrame.mStamp.toNSec();
+    lFrame.mArrival = aFrame.mArrival.toNSec();
+    lFrame.mWritten = lNow.tv_sec * 1000000000LL + lNow.tv_nsec;
+    lFrame.mSegmentCount = lSegments;
+    memcpy( lFrame.mEchoCount, aFrame.mEchoCount, lSegments );
+
+    for( unsigned int s=0; s<lSegments; ++s )
+    {
+        lEchoes = std::max<unsigned int>( lEchoes, aFrame.mEchoCount[s] );
+    }
+
+    // Only the echo rows in use.
+    for( unsigned int e=0; e<lEchoes; ++e )
+    {
+        memcpy( lFrame.mDistance[e], aFrame.mDistance[e], lSegments * sizeof( float ) );
+        memcpy( lFrame.mAmplitude[e], aFrame.mAmplitude[e], lSegments * sizeof( float ) );
+        memcpy( lFrame.mFlags[e], aFrame.mFlags[e], lSegments * sizeof( LeddarU16 ) );
+    }
+
+    __atomic_store_n( &lSlot.mSequence, lSequence + 2, __ATOMIC_RELEASE );
+    __atomic_store_n( &mHeader->mWritten, ++mWritten, __ATOMIC_RELEASE );
+}
+
+/// \brief   Mark the ring inactive and unlink it.
+void
+ShmWriter::Close( void )
+{
+    if ( mHeader == NULL )
+    {
+        return;
+    }
+
+    __atomic_store_n( &mHeader->mActive, 0, __ATOMIC_RELEASE );
+    munmap( mHeader, mSize );
+    shm_unlink( mName.c_str() );
+
+    mHeader = NULL;
+    mSlots = NULL;
+}
+
+} // namespace leddartech
+
+// End of file ShmWriter.cpp
@@ -0,0 +1,140 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    StampFilter.cpp
+///
+/// \brief   Estimate acquisition times from callback arrival times.
+// *****************************************************************************
+
+#include "leddartech/StampFilter.h"
+
+#include <math.h>
+
+namespace leddartech
+{
+
+// Gain applied when a frame arrives later than predicted (delivery jitter)
+// and when it arrives earlier (the prediction is behind).
+static const double kLateGain = 0.01;
+static const double kEarlyGain = 0.5;
+// Frames needed before the measured period replaces the nominal one, and
+// the range allowed around the nominal period (the sensor clock drift is
+// far below this).
+static const double kPeriodMinFrames = 50;
+static const double kPeriodTolerance = 0.05;
+// An error larger than this many periods means the stream was interrupted,
+// the filter restarts from the arrival time.
+static const double kResetPeriods = 5;
+
+StampFilter::StampFilter( void )
+    : mLatencyOffset( 0 )
+{
+    Reset( 1.0 / 12.5 );
+}
+
+// *****************************************************************************
+// Function: StampFilter::Reset
+//
+/// \brief   Restart the estimation, for example after a reconnection or a
+///          change of PID_MEASUREMENT_RATE.
+///
+/// \param   aNominalPeriod  Expected period between frames, in seconds.
+// *****************************************************************************
+
+void
+StampFilter::Reset( double aNominalPeriod )
+{
+    mNominalPeriod = aNominalPeriod;
+    mPeriod = aNominalPeriod;
+    mFirst = 0;
+    mFrames = 0;
+    mLastArrival = 0;
+    mLast = 0;
+    mInitialized = false;
+}
+
+// *****************************************************************************
+// Function: StampFilter::Update
+//
+/// \brief   Compute the stamp of a frame from its arrival time.
+///
+/// \param   aArrival  Time at which the data callback was called.
+///
+/// \return  The estimated acquisition time.
+// *****************************************************************************
+
+ros::Time
+StampFilter::Update( const ros::Time &aArrival )
+{
+    const double lArrival = aArrival.toSec();
+
+    if ( !mInitialized )
+    {
+        mInitialized = true;
+        mFirst = lArrival;
+        mLastArrival = lArrival;
+        mLast = lArrival;
+        return ros::Time( mLast - mLatencyOffset );
+    }
+
+    // Number of periods since the last frame, more than 1 if frames were
+    // dropped by the sensor or the SDK. Assumes the delivery jitter stays
+    // below half a period.
+    double lPeriods = floor( ( lArrival - mLastArrival ) / mPeriod + 0.5 );
+
+    // A single frame delivered very late makes the gap look like a drop.
+    // A frame cannot be acquired after it arrives, so never predict more
+    // than half a period past the arrival.
+    while( ( lPeriods > 1 ) && ( mLast + ( lPeriods - 0.5 ) * mPeriod > lArrival ) )
+    {
+        --lPeriods;
+    }
+
+    if ( lPeriods < 1 )
+    {
+        lPeriods = 1;
+    }
+
+    // Arriving half a period before the prediction means the previous gap
+    // was a frame delivered very late, not a drop: take that period back.
+    if ( ( lArrival < mLast + ( lPeriods - 0.5 ) * mPeriod ) && ( mFrames > lPeriods ) )
+    {
+        mLast -= mPeriod;
+        mFrames -= 1;
+    }
+
+    const double lPredicted = mLast + lPeriods * mPeriod;
+    const double lError = lArrival - lPredicted;
+
+    if ( fabs( lError ) > kResetPeriods * mPeriod )
+    {
+        Reset( mNominalPeriod );
+        return Update( aArrival );
+    }
+
+    mLast = lPredicted + ( ( lError < 0 ) ? kEarlyGain : kLateGain ) * lError;
+    mLastArrival = lArrival;
+    mFrames += lPeriods;
+
+    // The delivery delay does not accumulate, so the mean period since the
+    // first frame converges to the sensor period.
+    if ( mFrames >= kPeriodMinFrames )
+    {
+        mPeriod = ( lArrival - mFirst ) / mFrames;
+    }
+
+    if ( mPeriod > mNominalPeriod * ( 1 + kPeriodTolerance ) )
+    {
+        mPeriod = mNominalPeriod * ( 1 + kPeriodTolerance );
+    }
+    else if ( mPeriod < mNominalPeriod * ( 1 - kPeriodTolerance ) )
+    {
+        mPeriod = mNominalPeriod * ( 1 - kPeriodTolerance );
+    }
+
+    return ros::Time( mLast - mLatencyOffset );
+}
+
+} // namespace leddartech
+
+// End of file StampFilter.cpp
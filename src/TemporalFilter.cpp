@@ -0,0 +1,507 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    TemporalFilter.cpp
+///
+/// \brief   Per-segment smoothing of the nearest echo over time.
+// *****************************************************************************
+
+#include "leddartech/TemporalFilter.h"
+
+#include <algorithm>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace leddartech
+{
+
+// Missing frames after which the state of a segment is restarted.
+static const float kMaxMissed = 5;
+
+// Initial velocity variance of the Kalman filter, (m/s)^2.
+static const float kInitialVelocityVariance = 4;
+
+#ifdef __SSE2__
+// *****************************************************************************
+// Function: ValidMask
+//
+/// \brief   All ones in the lanes of the 4 segments from aIndex that have a
+///          detection.
+// *****************************************************************************
+
+static inline __m128
+ValidMask( const SegmentFrame &aFrame, unsigned int aIndex )
+{
+    int lEchoCounts;
+
+    memcpy( &lEchoCounts, &aFrame.mEchoCount[ aIndex ], sizeof( lEchoCounts ) );
+
+    const __m128i lZero = _mm_setzero_si128();
+    __m128i       lCounts = _mm_cvtsi32_si128( lEchoCounts );
+
+    lCounts = _mm_unpacklo_epi16( _mm_unpacklo_epi8( lCounts, lZero ), lZero );
+
+    return _mm_castsi128_ps( _mm_cmpgt_epi32( lCounts, lZero ) );
+}
+
+/// \brief   aMask ? aTrue : aFalse, lane by lane.
+static inline __m128
+Select( __m128 aMask, __m128 aTrue, __m128 aFalse )
+{
+    return _mm_or_ps( _mm_and_ps( aMask, aTrue ), _mm_andnot_ps( aMask, aFalse ) );
+}
+#endif
+
+/// \brief   Median of 3 with min and max only, as the SSE version does.
+static inline float
+Median3( float aA, float aB, float aC )
+{
+    return std::max( std::min( aA, aB ), std::min( std::max( aA, aB ), aC ) );
+}
+
+// *****************************************************************************
+// Function: SortFilteredEcho
+//
+/// \brief   Move the filtered first echo of each segment back to its place
+///          among the others, with its amplitude and flags, so the echoes
+///          stay nearest first. The others are still sorted, one pass does.
+// *****************************************************************************
+
+static void
+SortFilteredEcho( SegmentFrame &aFrame )
+{
+    for( unsigned int s=0; s<aFrame.mSegmentCount; ++s )
+    {
+        const unsigned int lEchoes = aFrame.mEchoCount[s];
+        const float        lDistance = aFrame.mDistance[0][s];
+
+        if ( ( lEchoes < 2 ) || ( lDistance <= aFrame.mDistance[1][s] ) )
+        {
+            continue;
+        }
+
+        const float     lAmplitude = aFrame.mAmplitude[0][s];
+        const LeddarU16 lFlags = aFrame.mFlags[0][s];
+        unsigned int    e = 0;
+
+        for( ; ( e + 1 < lEchoes ) && ( aFrame.mDistance[e + 1][s] < lDistance ); ++e )
+        {
+            aFrame.mDistance[e][s] = aFrame.mDistance[e + 1][s];
+            aFrame.mAmplitude[e][s] = aFrame.mAmplitude[e + 1][s];
+            aFrame.mFlags[e][s] = aFrame.mFlags[e + 1][s];
+        }
+
+        aFrame.mDistance[e][s] = lDistance;
+        aFrame.mAmplitude[e][s] = lAmplitude;
+        aFrame.mFlags[e][s] = lFlags;
+    }
+}
+
+TemporalFilter::TemporalFilter( void )
+    : mMode( FILTER_NONE ),
+      mWindow( 5 ),
+      mAlpha( 0.3f ),
+      mProcessNoise( 4 ),
+      mMeasurementNoise( 0.0025f ),
+      mPeriod( 0.08f )
+{
+    Reset();
+}
+
+// *****************************************************************************
+// Function: TemporalFilter::ParseMode
+//
+/// \param   aName  none, median, exponential or kalman.
+/// \param   aMode  Receives the mode.
+///
+/// \return  False if the name is not known.
+// *****************************************************************************
+
+bool
+TemporalFilter::ParseMode( const std::string &aName, Mode &aMode )
+{
+    if ( aName.empty() || ( aName == "none" ) )
+    {
+        aMode = FILTER_NONE;
+    }
+    else if ( aName == "median" )
+    {
+        aMode = FILTER_MEDIAN;
+    }
+    else if ( aName == "exponential" )
+    {
+        aMode = FILTER_EXPONENTIAL;
+    }
+    else if ( aName == "kalman" )
+    {
+        aMode = FILTER_KALMAN;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+// *****************************************************************************
+// Function: TemporalFilter::Configure
+//
+/// \brief   Set the mode and its parameters and restart every segment.
+///
+/// \param   aMode              Filter to apply.
+/// \param   aWindow            Median window, 3 or less gives 3, more gives 5.
+/// \param   aAlpha             Weight of a new detection in the average.
+/// \param   aProcessNoise      Standard deviation of the acceleration of the
+///                             targets (m/s^2).
+/// \param   aMeasurementNoise  Standard deviation of the distance (m).
+/// \param   aPeriod            Time between frames (s).
+// *****************************************************************************
+
+void
+TemporalFilter::Configure( Mode aMode, unsigned int aWindow, float aAlpha, float aProcessNoise,
+                           float aMeasurementNoise, double aPeriod )
+{
+    mMode = aMode;
+    mWindow = ( aWindow <= 3 ) ? 3 : 5;
+    mAlpha = std::min( std::max( aAlpha, 0.0f ), 1.0f );
+    mProcessNoise = aProcessNoise * aProcessNoise;
+    mMeasurementNoise = aMeasurementNoise * aMeasurementNoise;
+    mPeriod = aPeriod;
+
+    Reset();
+}
+
+void
+TemporalFilter::Reset( void )
+{
+    std::fill( mMissed, mMissed + LEDDAR_MAX_SEGMENTS, kMaxMissed + 1 );
+    memset( mValue, 0, sizeof( mValue ) );
+    memset( mVelocity, 0, sizeof( mVelocity ) );
+    memset( mP00, 0, sizeof( mP00 ) );
+    memset( mP01, 0, sizeof( mP01 ) );
+    memset( mP11, 0, sizeof( mP11 ) );
+    memset( mHistory, 0, sizeof( mHistory ) );
+    mHistoryIndex = 0;
+}
+
+// *****************************************************************************
+// Function: TemporalFilter::Apply
+//
+/// \brief   Replace the nearest echo distance of every segment with a
+///          detection by its filtered value. Nothing is done in FILTER_NONE.
+///          The filtered value can go past the next echo, the echoes are
+///          then sorted again.
+///
+/// \param   aFrame  Segment-binned frame, updated in place.
+// *****************************************************************************
+
+void
+TemporalFilter::Apply( SegmentFrame &aFrame )
+{
+    switch( mMode )
+    {
+        case FILTER_MEDIAN:
+            ApplyMedian( aFrame );
+            break;
+        case FILTER_EXPONENTIAL:
+            ApplyExponential( aFrame );
+            break;
+        case FILTER_KALMAN:
+            ApplyKalman( aFrame );
+            break;
+        default:
+            return;
+    }
+
+    SortFilteredEcho( aFrame );
+}
+
+// *****************************************************************************
+// Function: TemporalFilter::ApplyMedian
+//
+/// \brief   Median of the last mWindow detections of each segment, with a
+///          min/max network so all lanes take the same path. The median of
+///          5 drops the smallest and largest of 4 samples (neither can be
+///          the median) and takes the median of 3 of the rest.
+// *****************************************************************************
+
+void
+TemporalFilter::ApplyMedian( SegmentFrame &aFrame )
+{
+    const unsigned int lCount = aFrame.mSegmentCount;
+    float             *lDistance = aFrame.mDistance[0];
+    float             *lCurrent = mHistory[ mHistoryIndex ];
+    unsigned int       i = 0;
+
+    mHistoryIndex = ( mHistoryIndex + 1 ) % mWindow;
+
+#ifdef __SSE2__
+    const __m128 lMaxMissed = _mm_set1_ps( kMaxMissed );
+    const __m128 lOne = _mm_set1_ps( 1 );
+
+    for( ; i + 4 <= lCount; i += 4 )
+    {
+        const __m128 lValid = ValidMask( aFrame, i );
+        const __m128 lZ = _mm_loadu_ps( lDistance + i );
+        const __m128 lMissed = _mm_loadu_ps( mMissed + i );
+
+        // Restarted segments get their whole history set to the detection.
+        const __m128 lRestart = _mm_and_ps( lValid, _mm_cmpgt_ps( lMissed, lMaxMissed ) );
+
+        if ( _mm_movemask_ps( lRestart ) != 0 )
+        {
+            for( unsigned int k=0; k<mWindow; ++k )
+            {
+                float *lSlot = mHistory[k] + i;
+
+                _mm_storeu_ps( lSlot, Select( lRestart, lZ, _mm_loadu_ps( lSlot ) ) );
+            }
+        }
+
+        _mm_storeu_ps( lCurrent + i, Select( lValid, lZ, _mm_loadu_ps( lCurrent + i ) ) );
+        _mm_storeu_ps( mMissed + i, Select( lValid, _mm_setzero_ps(),
+                                            _mm_add_ps( lMissed, lOne ) ) );
+
+        __m128 lA = _mm_loadu_ps( mHistory[0] + i );
+        __m128 lB = _mm_loadu_ps( mHistory[1] + i );
+        __m128 lC = _mm_loadu_ps( mHistory[2] + i );
+
+        if ( mWindow == 5 )
+        {
+            const __m128 lD = _mm_loadu_ps( mHistory[3] + i );
+            const __m128 lLow = _mm_max_ps( _mm_min_ps( lA, lB ), _mm_min_ps( lC, lD ) );
+            const __m128 lHigh = _mm_min_ps( _mm_max_ps( lA, lB ), _mm_max_ps( lC, lD ) );
+
+            lA = lLow;
+            lB = lHigh;
+            lC = _mm_loadu_ps( mHistory[4] + i );
+        }
+
+        const __m128 lMedian = _mm_max_ps( _mm_min_ps( lA, lB ),
+                                           _mm_min_ps( _mm_max_ps( lA, lB ), lC ) );
+
+        _mm_storeu_ps( lDistance + i, Select( lValid, lMedian, lZ ) );
+    }
+#endif
+
+    for( ; i<lCount; ++i )
+    {
+        if ( aFrame.mEchoCount[i] == 0 )
+        {
+            mMissed[i] += 1;
+            continue;
+        }
+
+        if ( mMissed[i] > kMaxMissed )
+        {
+            for( unsigned int k=0; k<mWindow; ++k )
+            {
+                mHistory[k][i] = lDistance[i];
+            }
+        }
+
+        lCurrent[i] = lDistance[i];
+        mMissed[i] = 0;
+
+        float lA = mHistory[0][i], lB = mHistory[1][i], lC = mHistory[2][i];
+
+        if ( mWindow == 5 )
+        {
+            const float lD = mHistory[3][i];
+            const float lLow = std::max( std::min( lA, lB ), std::min( lC, lD ) );
+            const float lHigh = std::min( std::max( lA, lB ), std::max( lC, lD ) );
+
+            lA = lLow;
+            lB = lHigh;
+            lC = mHistory[4][i];
+        }
+
+        lDistance[i] = Median3( lA, lB, lC );
+    }
+}
+
+// *****************************************************************************
+// Function: TemporalFilter::ApplyExponential
+//
+/// \brief   Exponential moving average of the detections of each segment.
+// *****************************************************************************
+
+void
+TemporalFilter::ApplyExponential( SegmentFrame &aFrame )
+{
+    const unsigned int lCount = aFrame.mSegmentCount;
+    float             *lDistance = aFrame.mDistance[0];
+    unsigned int       i = 0;
+
+#ifdef __SSE2__
+    const __m128 lMaxMissed = _mm_set1_ps( kMaxMissed );
+    const __m128 lOne = _mm_set1_ps( 1 );
+    const __m128 lAlpha = _mm_set1_ps( mAlpha );
+
+    for( ; i + 4 <= lCount; i += 4 )
+    {
+        const __m128 lValid = ValidMask( aFrame, i );
+        const __m128 lZ = _mm_loadu_ps( lDistance + i );
+        const __m128 lMissed = _mm_loadu_ps( mMissed + i );
+        const __m128 lValue = _mm_loadu_ps( mValue + i );
+
+        const __m128 lAverage = _mm_add_ps( lValue, _mm_mul_ps( lAlpha, _mm_sub_ps( lZ, lValue ) ) );
+        const __m128 lNew = Select( _mm_cmpgt_ps( lMissed, lMaxMissed ), lZ, lAverage );
+
+        _mm_storeu_ps( mValue + i, Select( lValid, lNew, lValue ) );
+        _mm_storeu_ps( mMissed + i, Select( lValid, _mm_setzero_ps(),
+                                            _mm_add_ps( lMissed, lOne ) ) );
+        _mm_storeu_ps( lDistance + i, Select( lValid, lNew, lZ ) );
+    }
+#endif
+
+    for( ; i<lCount; ++i )
+    {
+        if ( aFrame.mEchoCount[i] == 0 )
+        {
+            mMissed[i] += 1;
+            continue;
+        }
+
+        mValue[i] = ( mMissed[i] > kMaxMissed ) ? lDistance[i]
+                                                : mValue[i] + mAlpha * ( lDistance[i] - mValue[i] );
+        mMissed[i] = 0;
+        lDistance[i] = mValue[i];
+    }
+}
+
+// *****************************************************************************
+// Function: TemporalFilter::ApplyKalman
+//
+/// \brief   Constant velocity Kalman filter on the distance of each segment.
+///          Every segment is predicted, only those with a detection are
+///          updated; restarted segments start at the detection with no
+///          velocity.
+// *****************************************************************************
+
+void
+TemporalFilter::ApplyKalman( SegmentFrame &aFrame )
+{
+    const unsigned int lCount = aFrame.mSegmentCount;
+    float             *lDistance = aFrame.mDistance[0];
+    const float        lDt = mPeriod;
+
+    // Process noise of a random acceleration over one period.
+    const float  lQ00 = mProcessNoise * lDt * lDt * lDt * lDt / 4;
+    const float  lQ01 = mProcessNoise * lDt * lDt * lDt / 2;
+    const float  lQ11 = mProcessNoise * lDt * lDt;
+    unsigned int i = 0;
+
+#ifdef __SSE2__
+    const __m128 lMaxMissed = _mm_set1_ps( kMaxMissed );
+    const __m128 lOne = _mm_set1_ps( 1 );
+    const __m128 lZero = _mm_setzero_ps();
+    const __m128 lDtV = _mm_set1_ps( lDt );
+    const __m128 lQ00V = _mm_set1_ps( lQ00 );
+    const __m128 lQ01V = _mm_set1_ps( lQ01 );
+    const __m128 lQ11V = _mm_set1_ps( lQ11 );
+    const __m128 lR = _mm_set1_ps( mMeasurementNoise );
+    const __m128 lInitialP11 = _mm_set1_ps( kInitialVelocityVariance );
+
+    for( ; i + 4 <= lCount; i += 4 )
+    {
+        const __m128 lValid = ValidMask( aFrame, i );
+        const __m128 lZ = _mm_loadu_ps( lDistance + i );
+        const __m128 lMissed = _mm_loadu_ps( mMissed + i );
+
+        __m128 lX = _mm_loadu_ps( mValue + i );
+        __m128 lV = _mm_loadu_ps( mVelocity + i );
+        __m128 lP00 = _mm_loadu_ps( mP00 + i );
+        __m128 lP01 = _mm_loadu_ps( mP01 + i );
+        __m128 lP11 = _mm_loadu_ps( mP11 + i );
+
+        // Predict.
+        lX = _mm_add_ps( lX, _mm_mul_ps( lV, lDtV ) );
+        lP00 = _mm_add_ps( lP00, _mm_add_ps( _mm_mul_ps( lDtV, _mm_add_ps( _mm_add_ps( lP01, lP01 ),
+                                                                           _mm_mul_ps( lDtV, lP11 ) ) ),
+                                             lQ00V ) );
+        lP01 = _mm_add_ps( lP01, _mm_add_ps( _mm_mul_ps( lDtV, lP11 ), lQ01V ) );
+        lP11 = _mm_add_ps( lP11, lQ11V );
+
+        // Update.
+        const __m128 lInnovation = _mm_sub_ps( lZ, lX );
+        const __m128 lS = _mm_add_ps( lP00, lR );
+        const __m128 lK0 = _mm_div_ps( lP00, lS );
+        const __m128 lK1 = _mm_div_ps( lP01, lS );
+
+        __m128 lUX = _mm_add_ps( lX, _mm_mul_ps( lK0, lInnovation ) );
+        __m128 lUV = _mm_add_ps( lV, _mm_mul_ps( lK1, lInnovation ) );
+        __m128 lUP00 = _mm_mul_ps( _mm_sub_ps( lOne, lK0 ), lP00 );
+        __m128 lUP01 = _mm_mul_ps( _mm_sub_ps( lOne, lK0 ), lP01 );
+        __m128 lUP11 = _mm_sub_ps( lP11, _mm_mul_ps( lK1, lP01 ) );
+
+        // Restart.
+        const __m128 lRestart = _mm_cmpgt_ps( lMissed, lMaxMissed );
+
+        lUX = Select( lRestart, lZ, lUX );
+        lUV = Select( lRestart, lZero, lUV );
+        lUP00 = Select( lRestart, lR, lUP00 );
+        lUP01 = Select( lRestart, lZero, lUP01 );
+        lUP11 = Select( lRestart, lInitialP11, lUP11 );
+
+        _mm_storeu_ps( mValue + i, Select( lValid, lUX, lX ) );
+        _mm_storeu_ps( mVelocity + i, Select( lValid, lUV, lV ) );
+        _mm_storeu_ps( mP00 + i, Select( lValid, lUP00, lP00 ) );
+        _mm_storeu_ps( mP01 + i, Select( lValid, lUP01, lP01 ) );
+        _mm_storeu_ps( mP11 + i, Select( lValid, lUP11, lP11 ) );
+        _mm_storeu_ps( mMissed + i, Select( lValid, lZero, _mm_add_ps( lMissed, lOne ) ) );
+        _mm_storeu_ps( lDistance + i, Select( lValid, _mm_max_ps( lUX, lZero ), lZ ) );
+    }
+#endif
+
+    for( ; i<lCount; ++i )
+    {
+        const float lX = mValue[i] + mVelocity[i] * lDt;
+        const float lP00 = mP00[i] + lDt * ( 2 * mP01[i] + lDt * mP11[i] ) + lQ00;
+        const float lP01 = mP01[i] + lDt * mP11[i] + lQ01;
+        const float lP11 = mP11[i] + lQ11;
+
+        if ( aFrame.mEchoCount[i] == 0 )
+        {
+            mValue[i] = lX;
+            mP00[i] = lP00;
+            mP01[i] = lP01;
+            mP11[i] = lP11;
+            mMissed[i] += 1;
+            continue;
+        }
+
+        if ( mMissed[i] > kMaxMissed )
+        {
+            mValue[i] = lDistance[i];
+            mVelocity[i] = 0;
+            mP00[i] = mMeasurementNoise;
+            mP01[i] = 0;
+            mP11[i] = kInitialVelocityVariance;
+        }
+        else
+        {
+            const float lInnovation = lDistance[i] - lX;
+            const float lS = lP00 + mMeasurementNoise;
+            const float lK0 = lP00 / lS;
+            const float lK1 = lP01 / lS;
+
+            mValue[i] = lX + lK0 * lInnovation;
+            mVelocity[i] += lK1 * lInnovation;
+            mP00[i] = ( 1 - lK0 ) * lP00;
+            mP01[i] = ( 1 - lK0 ) * lP01;
+            mP11[i] = lP11 - lK1 * lP01;
+        }
+
+        mMissed[i] = 0;
+        lDistance[i] = std::max( mValue[i], 0.0f );
+    }
+}
+
+} // namespace leddartech
+
+// End of file TemporalFilter.cpp
@@ -0,0 +1,252 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    ZoneMonitor.cpp
+///
+/// \brief   Zone intrusion detection on the segment-binned frames.
+// *****************************************************************************
+
+#include "leddartech/ZoneMonitor.h"
+
+#include <algorithm>
+
+#include "LeddarProperties.h"
+
+namespace leddartech
+{
+
+ZoneSettings::ZoneSettings( void )
+    : mNearLimit( 0 ),
+      mFarLimit( 1000 ),
+      mSegments( ~uint64_t( 0 ) ),
+      mRisingDebounce( 1 ),
+      mFallingDebounce( 1 )
+{
+}
+
+ZoneMonitor::ZoneMonitor( void )
+    : mOccupied( 0 )
+{
+}
+
+// *****************************************************************************
+// Function: ZoneMonitor::ReadZones
+//
+/// \brief   Read the zones listed by name in ~zones. Each zone reads
+///          near_limit, far_limit (m), segments (list of indexes, all when
+///          not set), rising_debounce and falling_debounce (frames) from
+///          ~zone/<name>/.
+///
+/// \param   aPrivate  Namespace to read from.
+/// \param   aZones    Receives the zones, in the order listed.
+// *****************************************************************************
+
+void
+ZoneMonitor::ReadZones( const ros::NodeHandle &aPrivate, std::vector<ZoneSettings> &aZones )
+{
+    std::vector<std::string> lNames;
+
+    if ( !aPrivate.getParam( "zones", lNames ) )
+    {
+        return;
+    }
+
+    aZones.clear();
+
+    for( size_t i=0; i<lNames.size(); ++i )
+    {
+        const ros::NodeHandle lZoneNode( aPrivate, "zone/" + lNames[i] );
+        ZoneSettings          lZone;
+        double                lNear = lZone.mNearLimit;
+        double                lFar = lZone.mFarLimit;
+        int                   lRising = lZone.mRisingDebounce;
+        int                   lFalling = lZone.mFallingDebounce;
+        std::vector<int>      lSegments;
+
+        lZoneNode.param( "near_limit", lNear, lNear );
+        lZoneNode.param( "far_limit", lFar, lFar );
+        lZoneNode.param( "rising_debounce", lRising, lRising );
+        lZoneNode.param( "falling_debounce", lFalling, lFalling );
+
+        lZone.mName = lNames[i];
+        lZone.mNearLimit = lNear;
+        lZone.mFarLimit = lFar;
+        lZone.mRisingDebounce = std::max( lRising, 1 );
+        lZone.mFallingDebounce = std::max( lFalling, 1 );
+
+        if ( lZoneNode.getParam( "segments", lSegments ) )
+        {
+            lZone.mSegments = 0;
+
+            for( size_t s=0; s<lSegments.size(); ++s )
+            {
+                if ( ( lSegments[s] >= 0 ) && ( lSegments[s] < LEDDAR_MAX_SEGMENTS ) )
+                {
+                    lZone.mSegments |= uint64_t( 1 ) << lSegments[s];
+                }
+            }
+        }
+
+        if ( aZones.size() == kMaxZones )
+        {
+            ROS_WARN( "Only the first %u zones are monitored.", kMaxZones );
+            break;
+        }
+
+        aZones.push_back( lZone );
+    }
+}
+
+// *****************************************************************************
+// Function: ZoneMonitor::ReadSensorZone
+//
+/// \brief   Read the detection zone configured in the sensor.
+///
+/// \param   aProperties    Properties of the sensor.
+/// \param   aSegmentCount  Number of segments of the sensor.
+/// \param   aZone          Receives the zone, named "sensor".
+///
+/// \return  False if the sensor has no zone or it is disabled.
+// *****************************************************************************
+
+bool
+ZoneMonitor::ReadSensorZone( const PropertyCache &aProperties, unsigned int aSegmentCount,
+                             ZoneSettings &aZone )
+{
+    double lNear, lFar;
+
+    if (    ( aProperties.Value( PID_ZONE_ENABLED, 0, 0.0 ) == 0 )
+         || !aProperties.Get( PID_ZONE_NEAR_LIMIT, 0, lNear )
+         || !aProperties.Get( PID_ZONE_FAR_LIMIT, 0, lFar ) )
+    {
+        return false;
+    }
+
+    aZone = ZoneSettings();
+    aZone.mName = "sensor";
+    aZone.mNearLimit = lNear;
+    aZone.mFarLimit = lFar;
+    aZone.mRisingDebounce = std::max( aProperties.Value( PID_ZONE_RISING_DEBOUNCE, 0, 1.0 ), 1.0 );
+    aZone.mFallingDebounce = std::max( aProperties.Value( PID_ZONE_FALLING_DEBOUNCE, 0, 1.0 ), 1.0 );
+    aZone.mSegments = 0;
+
+    for( unsigned int i=0; ( i<aSegmentCount ) && ( i<LEDDAR_MAX_SEGMENTS ); ++i )
+    {
+        if ( aProperties.Value( PID_ZONE_SEGMENT_ENABLED, i, 1.0 ) != 0 )
+        {
+            aZone.mSegments |= uint64_t( 1 ) << i;
+        }
+    }
+
+    return true;
+}
+
+// *****************************************************************************
+// Function: ZoneMonitor::Configure
+//
+/// \brief   Set the zones to monitor. The occupancy is kept when the zones
+///          are the same ones (by name, as on a reconnection) so no spurious
+///          change is reported, otherwise every zone starts clear.
+///
+/// \param   aZones  At most kMaxZones zones.
+// *****************************************************************************
+
+void
+ZoneMonitor::Configure( const std::vector<ZoneSettings> &aZones )
+{
+    bool lSame = ( aZones.size() == mZones.size() );
+
+    for( size_t i=0; lSame && ( i<aZones.size() ); ++i )
+    {
+        lSame = ( aZones[i].mName == mZones[i].mName );
+    }
+
+    mZones.assign( aZones.begin(),
+                   aZones.begin() + std::min<size_t>( aZones.size(), kMaxZones ) );
+
+    if ( !lSame )
+    {
+        mPending.assign( mZones.size(), 0 );
+        mOccupied = 0;
+    }
+}
+
+// *****************************************************************************
+// Function: ZoneMonitor::Update
+//
+/// \brief   Evaluate the zones on a frame. Echoes are sorted nearest first,
+///          so the first echo of a segment at or beyond the near limit is
+///          its nearest detection that can be in the zone.
+///
+/// \param   aFrame        Segment-binned frame.
+/// \param   aTransitions  Receives the confirmed changes.
+///
+/// \return  The number of changes.
+// *****************************************************************************
+
+unsigned int
+ZoneMonitor::Update( const SegmentFrame &aFrame, ZoneTransition aTransitions[ kMaxZones ] )
+{
+    unsigned int lCount = 0;
+
+    for( unsigned int z=0; z<mZones.size(); ++z )
+    {
+        const ZoneSettings &lZone = mZones[z];
+        float               lNearest = lZone.mFarLimit;
+        unsigned int        lSegment = 0;
+
+        for( unsigned int s=0; s<aFrame.mSegmentCount; ++s )
+        {
+            if ( !( lZone.mSegments & ( uint64_t( 1 ) << s ) ) )
+            {
+                continue;
+            }
+
+            for( unsigned int e=0; e<aFrame.mEchoCount[s]; ++e )
+            {
+                const float lDistance = aFrame.mDistance[e][s];
+
+                if ( lDistance >= lZone.mNearLimit )
+                {
+                    if ( lDistance < lNearest )
+                    {
+                        lNearest = lDistance;
+                        lSegment = s;
+                    }
+
+                    break;
+                }
+            }
+        }
+
+        const bool lDetected = ( lNearest < lZone.mFarLimit );
+        const bool lOccupied = ( mOccupied >> z ) & 1;
+
+        if ( lDetected == lOccupied )
+        {
+            mPending[z] = 0;
+            continue;
+        }
+
+        if ( ++mPending[z] < ( lDetected ? lZone.mRisingDebounce : lZone.mFallingDebounce ) )
+        {
+            continue;
+        }
+
+        mPending[z] = 0;
+        mOccupied ^= uint32_t( 1 ) << z;
+
+        ZoneTransition &lTransition = aTransitions[ lCount++ ];
+
+        lTransition.mZone = z;
+        lTransition.mEnter = lDetected;
+        lTransition.mSegment = lDetected ? lSegment : 0;
+        lTransition.mDistance = lDetected ? lNearest : 0;
+    }
+
+    return lCount;
+}
+
+} // namespace leddartech
+
+// End of file ZoneMonitor.cpp
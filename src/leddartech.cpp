@@ -25,25 +25,115 @@
 // !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 // *****************************************************************************
 #include <ros/ros.h>
-#include <sensor_msgs/LaserScan.h>
-#include <angles/angles.h>
 
+#include <memory>
+#include <string>
+#include <vector>
 #include <stdio.h>
 #include <ctype.h>
+#include <signal.h>
 #include <string.h>
+#include <termios.h>
+#include <unistd.h>
 #include "LeddarC.h"
 #include "LeddarProperties.h"
+#include "leddartech/EventLoop.h"
+#include "leddartech/LeddarDevice.h"
+#include "leddartech/LeddarDriver.h"
+#include "leddartech/LeddarSensor.h"
+
+using leddartech::Device;
+using leddartech::EventLoop;
+using leddartech::LeddarDriver;
+using leddartech::LeddarSensor;
+using leddartech::LeddarSensorOptions;
+using leddartech::PropertyCache;
+using leddartech::PropertyWrite;
+using leddartech::Result;
 
 
 #define ARRAY_LEN( a )  (sizeof(a)/sizeof(a[0]))
 
 // Global variable to avoid passing to each function.
-static LeddarHandle gHandle=NULL;
+static Device *gDevice=NULL;
+
+// The sensor driven by the interactive menus, gDevice is its device.
+static std::unique_ptr<LeddarSensor> gSensor;
+
+// Wall time at which the node started, used to report time-to-first-frame.
+static ros::WallTime gStartTime;
+
+// Events the menus wait for, all through gLoop.
+enum MenuEvent
+{
+    EVENT_KEY      = 1 << 0,    ///< A key can be read from the terminal.
+    EVENT_PING     = 1 << 1,    ///< The live connection must be pinged.
+    EVENT_LOADING  = 1 << 2,    ///< Time to check if the record is loaded.
+    EVENT_FRAME    = 1 << 3,    ///< The sensor received a frame.
+    EVENT_SHUTDOWN = 1 << 4     ///< SIGINT or SIGTERM.
+};
+
+// A live connection is pinged this often to stay alive.
+static const double kPingPeriod = 0.5;
+
+// LeddarC does not tell when a record is loaded, it is checked this often
+// while it loads (and only then).
+static const double kLoadingPeriod = 0.1;
+
+static EventLoop gLoop;
+
+// Set once a shutdown was requested, every menu then quits.
+static bool gShutdown = false;
+
+// *****************************************************************************
+/// \brief   Terminal without line buffering while it exists, so that a key
+///          wakes the loop as soon as it is pressed instead of on Enter.
+// *****************************************************************************
+
+class TerminalKeys
+{
+public:
+    TerminalKeys( void )
+        : mRestore( isatty( STDIN_FILENO ) && ( tcgetattr( STDIN_FILENO, &mSaved ) == 0 ) )
+    {
+        if ( mRestore )
+        {
+            struct termios lKeys = mSaved;
+
+            lKeys.c_lflag &= ~ICANON;
+            lKeys.c_cc[VMIN] = 1;
+            lKeys.c_cc[VTIME] = 0;
+            tcsetattr( STDIN_FILENO, TCSANOW, &lKeys );
+        }
+    }
 
+    ~TerminalKeys( void )
+    {
+        if ( mRestore )
+        {
+            tcsetattr( STDIN_FILENO, TCSANOW, &mSaved );
+        }
+    }
 
-sensor_msgs::LaserScan constructLeddarMessage(std::vector<double> data);
-ros::Publisher leddar_publisher;
-int leddar_sequence_number = 0;
+private:
+    TerminalKeys( const TerminalKeys & );
+    TerminalKeys &operator=( const TerminalKeys & );
+
+    struct termios mSaved;
+    bool           mRestore;
+};
+
+// *****************************************************************************
+// Function: RequestShutdown
+//
+/// \brief   SIGINT and SIGTERM handler. Post is async-signal-safe.
+// *****************************************************************************
+
+static void
+RequestShutdown( int )
+{
+    gLoop.Post( EVENT_SHUTDOWN );
+}
 
 
 // *****************************************************************************
@@ -52,18 +142,15 @@ int leddar_sequence_number = 0;
 /// \brief   Check a return code and if it is not success, display an error
 ///          message corresponding to the code.
 ///
-/// \param   aCode  The result code to verify.
+/// \param   aResult  The result to verify.
 // *****************************************************************************
 
 static void
-CheckError( int aCode )
+CheckError( Result aResult )
 {
-    if ( aCode != LD_SUCCESS )
+    if ( !aResult.Ok() )
     {
-        LtChar lMessage[200];
-
-        LeddarGetErrorMessage( aCode, lMessage, ARRAY_LEN( lMessage ) );
-        LeddarPrintf( LTS( "LeddarC error (%d): %s\n" ), aCode, lMessage );
+        LeddarPrintf( LTS( "LeddarC error (%d): %s\n" ), aResult.Code(), aResult.Message().c_str() );
     }
 }
 
@@ -71,89 +158,77 @@ CheckError( int aCode )
 // Function: WaitKey
 //
 /// \brief   Wait for a key to be pressed on the keyboard, pinging the sensor
-///          to keep the connection alive while waiting.
+///          to keep the connection alive while waiting. Sleeps in gLoop
+///          until something happens, nothing is polled.
+///
+/// \param   aEvents  Other events to return on: EVENT_FRAME, or
+///                   EVENT_LOADING for the end of a record load.
 ///
 /// \return  The character corresponding to the key pressed (converted to
-///          uppercase for letters).
+///          uppercase for letters), 0 if the ping failed or for aEvents,
+///          Escape once a shutdown is requested.
 // *****************************************************************************
 
 static char
-WaitKey( void )
+WaitKey( uint32_t aEvents = 0 )
 {
-    // LeddarGetKey is blocking so we need to wait for a key to be pressed
-    // before calling it.
-    while( !LeddarKeyPressed() )
+    TerminalKeys lKeys;
+
+    while( !gShutdown )
     {
-        // If a live connection is active we need to ping it periodically.
-        if ( LeddarGetConnected( gHandle ) )
+        const uint32_t lEvents = gLoop.Wait();
+
+        if ( lEvents & EVENT_SHUTDOWN )
         {
-            if ( LeddarPing( gHandle ) != LD_SUCCESS )
-            {
-                return 0;
-            }
+            gShutdown = true;
+            break;
         }
 
-        LeddarSleep( 0.5 );
-    }
-
-    return toupper( LeddarGetKey() );
-}
+        // LeddarGetKey is blocking, it is called once a key is waiting.
+        if ( lEvents & EVENT_KEY )
+        {
+            const int lKey = LeddarGetKey();
 
-// *****************************************************************************
-// Function: DataCallback
-//
-/// \brief   This is the function that is called when a new set of data is
-///          available. Here we simply display the first 12 detections.
-///
-/// \param   aHandle  This is the user data parameter that was passed to
-///                   LeddarAddCallback. Here by design we know its the handle.
-/// \param   aLevels  A bitmask of the data levels received in that frame.
-///
-/// \return  Non zero to be called again (responding 0 would remove this
-///          function from the callback list).
-// *****************************************************************************
+            // Input closed, nothing more will come.
+            if ( lKey == EOF )
+            {
+                gShutdown = true;
+                break;
+            }
 
-static unsigned char
-DataCallback( void *aHandle, unsigned int aLevels )
-{
-    LdDetection lDetections[50];
-    unsigned int i, j, lCount = LeddarGetDetectionCount( aHandle );
+            return toupper( lKey );
+        }
 
-    if ( lCount > ARRAY_LEN( lDetections ) )
-    {
-        lCount = ARRAY_LEN( lDetections );
-    }
+        // If a live connection is active we need to ping it periodically.
+        if ( ( lEvents & EVENT_PING ) && gDevice->Connected() && !gDevice->Ping().Ok() )
+        {
+            return 0;
+        }
 
-    LeddarGetDetections( aHandle, lDetections, ARRAY_LEN( lDetections ) );
+        if ( ( lEvents & EVENT_LOADING ) && !gDevice->RecordLoading() )
+        {
+            gLoop.SetTimer( EVENT_LOADING, 0 );
 
-    // When replaying a record, display the current index
-    if ( LeddarGetRecordSize( gHandle ) != 0 )
-    {
-        printf( "%6d ", LeddarGetCurrentRecordIndex( gHandle ) );
-    }
+            if ( aEvents & EVENT_LOADING )
+            {
+                return 0;
+            }
+        }
 
-    std::vector<double> leddar_data;
-    for( i=0, j=0; (i<lCount) && (j<16); ++i )
-    {
-        printf( "%5.2f ", lDetections[i].mDistance );
-        leddar_data.push_back(lDetections[i].mDistance);
-        ++j;
+        if ( lEvents & aEvents & ~EVENT_LOADING )
+        {
+            return 0;
+        }
     }
-    puts( "" );
-
-
-    sensor_msgs::LaserScan message = constructLeddarMessage(leddar_data);
-    leddar_publisher.publish(message);
-
 
-    return 1;
+    return 27;
 }
 
 // *****************************************************************************
 // Function: ReadLiveData
 //
 /// \brief   Start data transfer until a key is pressed and stop it (data is
-///          displayed by the callback).
+///          published by the sensor).
 // *****************************************************************************
 
 static void
@@ -162,20 +237,26 @@ ReadLiveData( void )
     puts( "\nPress a key to start reading data and press a key again to stop." );
     WaitKey();
 
-    CheckError( LeddarStartDataTransfer( gHandle, LDDL_DETECTIONS ) );
-    CheckError( LeddarAddCallback( gHandle, DataCallback, gHandle ) );
+    // Told of the first frame only.
+    gSensor->SetFrameEvents( &gLoop, EVENT_FRAME );
+    gSensor->StartStreaming();
 
-    WaitKey();
+    if ( ( WaitKey( EVENT_FRAME ) == 0 ) && gDevice->Connected() )
+    {
+        gSensor->SetFrameEvents( NULL, 0 );
+        puts( "Receiving data." );
+        WaitKey();
+    }
 
-    LeddarStopDataTransfer( gHandle );
-    LeddarRemoveCallback( gHandle, DataCallback, gHandle );
+    gSensor->SetFrameEvents( NULL, 0 );
+    gSensor->StopStreaming();
 }
 
 // *****************************************************************************
 // Function: ReplayData
 //
-/// \brief   Navigation through a record file to display the data (data is
-///          displayed by the callback).
+/// \brief   Navigation through a record file to publish the data (data is
+///          published by the sensor).
 // *****************************************************************************
 
 static void
@@ -183,8 +264,7 @@ ReplayData( void )
 {
     puts( "\nP to go forward, O to go backward, H to return to beginning, Q to quit" );
 
-    CheckError( LeddarStartDataTransfer( gHandle, LDDL_DETECTIONS ) );
-    CheckError( LeddarAddCallback( gHandle, DataCallback, gHandle ) );
+    gSensor->StartStreaming();
 
     for(;;)
     {
@@ -193,18 +273,17 @@ ReplayData( void )
         switch( lChoice )
         {
             case 'H':
-                LeddarMoveRecordTo( gHandle, 0 );
+                gDevice->MoveRecordTo( 0 );
                 break;
             case 'O':
-                CheckError( LeddarStepBackward( gHandle ) );
+                CheckError( gDevice->StepBackward() );
                 break;
             case 'P':
-                CheckError( LeddarStepForward( gHandle ) );
+                CheckError( gDevice->StepForward() );
                 break;
             case 'Q':
             case  27: // Escape
-                LeddarStopDataTransfer( gHandle );
-                LeddarRemoveCallback( gHandle, DataCallback, gHandle );
+                gSensor->StopStreaming();
                 return;
         }
     }
@@ -219,22 +298,18 @@ ReplayData( void )
 static void
 ReadConfiguration( void )
 {
-    double lValue;
-    char   lValueStr[64];
+    const PropertyCache &lProperties = gSensor->Properties();
+    std::string          lName;
+
+    lProperties.GetText( PID_NAME, 0, lName );
 
     puts( "\nCurrent Configuration:\n" );
-    CheckError( LeddarGetTextProperty( gHandle, PID_NAME, 0, lValueStr, sizeof(lValueStr) ) );
-    printf( "  Device Name     : %s\n", lValueStr );
-    CheckError( LeddarGetProperty( gHandle, PID_OVERSAMPLING, 0, &lValue ) );
-    printf( "  Oversampling    : %.0f\n", lValue );
-    CheckError( LeddarGetProperty( gHandle, PID_ACCUMULATION, 0, &lValue ) );
-    printf( "  Accumulations   : %.0f\n", lValue );
-    CheckError( LeddarGetProperty( gHandle, PID_BASE_POINT_COUNT, 0, &lValue ) );
-    printf( "  Base Point Count: %.0f\n", lValue );
-    CheckError( LeddarGetProperty( gHandle, PID_LED_INTENSITY, 0, &lValue ) );
-    printf( "  Led Intensity   : %.0f\n", lValue );
-    CheckError( LeddarGetProperty( gHandle, PID_THRESHOLD_OFFSET, 0, &lValue ) );
-    printf( "  Threshold offset: %.2f\n", lValue );
+    printf( "  Device Name     : %s\n", lName.c_str() );
+    printf( "  Oversampling    : %.0f\n", lProperties.Value( PID_OVERSAMPLING, 0, 0 ) );
+    printf( "  Accumulations   : %.0f\n", lProperties.Value( PID_ACCUMULATION, 0, 0 ) );
+    printf( "  Base Point Count: %.0f\n", lProperties.Value( PID_BASE_POINT_COUNT, 0, 0 ) );
+    printf( "  Led Intensity   : %.0f\n", lProperties.Value( PID_LED_INTENSITY, 0, 0 ) );
+    printf( "  Threshold offset: %.2f\n", lProperties.Value( PID_THRESHOLD_OFFSET, 0, 0 ) );
 
     puts( "\nPress a key to continue." );
     WaitKey();
@@ -243,13 +318,17 @@ ReadConfiguration( void )
 // *****************************************************************************
 // Function: ConfigurationMenu
 //
-/// \brief   Menu allowing the change of configuration parameters.
+/// \brief   Menu allowing the change of configuration parameters. Changes
+///          are kept until Write, which sends them to the sensor as one
+///          batch (see LeddarSensor::WriteProperties).
 // *****************************************************************************
 
 static void
 ConfigurationMenu( void )
 {
-    while( LeddarGetConnected( gHandle ) )
+    std::vector<PropertyWrite> lPending;
+
+    while( gDevice->Connected() )
     {
         char         lChoice;
         unsigned int lId = 0;
@@ -290,14 +369,15 @@ ConfigurationMenu( void )
                 lType = 2;
                 break;
             case '7':
-                CheckError( LeddarWriteConfiguration( gHandle ) );
+                CheckError( gSensor->WriteProperties( lPending ) );
+                lPending.clear();
                 break;
             case '8':
-                CheckError( LeddarRestoreConfiguration( gHandle ) );
+                lPending.clear();
                 break;
             case '9':
             case  27: // Escape
-                if ( !LeddarGetConfigurationModified( gHandle ) )
+                if ( lPending.empty() || gShutdown )
                 {
                     return;
                 }
@@ -317,7 +397,7 @@ ConfigurationMenu( void )
                     double lValue;
 
                     scanf( "%lf", &lValue );
-                    CheckError( LeddarSetProperty( gHandle, lId, 0, lValue ) );
+                    lPending.push_back( PropertyWrite( lId, 0, lValue ) );
                 }
                     break;
                 case 2:
@@ -325,7 +405,7 @@ ConfigurationMenu( void )
                     char lValue[64];
 
                     scanf( "%63s", lValue );
-                    CheckError( LeddarSetTextProperty( gHandle, lId, 0, lValue ) );
+                    lPending.push_back( PropertyWrite( lId, 0, std::string( lValue ) ) );
                 }
                     break;
             }
@@ -360,9 +440,12 @@ ConnectMenu( int aTrySingleUsb )
         scanf( "%24s", lAddress );
     }
 
-    if ( LeddarConnect( gHandle, lAddress ) == LD_SUCCESS )
+    if ( gDevice->Connect( lAddress ).Ok() )
     {
-        while( LeddarGetConnected( gHandle ) )
+        gSensor->Configure();
+        gLoop.SetTimer( EVENT_PING, kPingPeriod );
+
+        while( gDevice->Connected() )
         {
             char lChoice;
 
@@ -370,7 +453,7 @@ ConnectMenu( int aTrySingleUsb )
             puts( "  1. Read Data" );
             puts( "  2. Read Configuration" );
             puts( "  3. Change Configuration" );
-            if ( LeddarGetRecording( gHandle ) )
+            if ( gDevice->Recording() )
             {
                 puts( "  4. Stop Recording" );
             }
@@ -394,21 +477,23 @@ ConnectMenu( int aTrySingleUsb )
                     ConfigurationMenu();
                     break;
                 case '4':
-                    if ( LeddarGetRecording( gHandle ) )
+                    if ( gDevice->Recording() )
                     {
-                        LeddarStopRecording( gHandle );
+                        gDevice->StopRecording();
                     }
                     else
                     {
-                        CheckError( LeddarStartRecording( gHandle ) );
+                        CheckError( gDevice->StartRecording() );
                     }
                     break;
                 case '5':
                 case  27:
-                    LeddarDisconnect( gHandle );
-                    return;
+                    gDevice->Disconnect();
+                    break;
             }
         }
+
+        gLoop.SetTimer( EVENT_PING, 0 );
     }
     else
     {
@@ -431,32 +516,39 @@ ReplayMenu( void )
     printf( "\nEnter file name: " );
     LeddarScanf( LTS( "%255s" ), lName );
 
-    if ( LeddarLoadRecord( gHandle, lName ) == LD_SUCCESS )
+    if ( gDevice->LoadRecord( lName ).Ok() )
     {
-        puts( "\nPlease wait while the record is loading..." );
+        // For a big file, especially if it is on a network drive, loading
+        // takes a while. The frames loaded so far can be replayed already,
+        // the size reported grows until it is done.
+        printf( "Record opened, %d frames loaded so far.\n", (int) gDevice->RecordSize() );
 
-        // For a big file, especially if it is on a network drive, it may
-        // take a while before the replay is 100% ready. Note that you
-        // can still use the replay but it will not report the complete
-        // size until it is finished loading.
-        while( LeddarGetRecordLoading( gHandle ) )
+        gSensor->Configure();
+
+        // The menu is shown again with the full size once it is loaded.
+        if ( gDevice->RecordLoading() )
         {
-            LeddarSleep( 0.5 );
+            gLoop.SetTimer( EVENT_LOADING, kLoadingPeriod );
         }
 
-        printf( "Finished loading record of %d frames.\n",
-                LeddarGetRecordSize( gHandle ) );
-
         for(;;)
         {
             char lChoice;
 
-            puts( "\nReplay Menu" );
+            if ( gDevice->RecordLoading() )
+            {
+                printf( "\nReplay Menu (%d frames, loading)\n", (int) gDevice->RecordSize() );
+            }
+            else
+            {
+                printf( "\nReplay Menu (%d frames)\n", (int) gDevice->RecordSize() );
+            }
+
             puts( "  1. Read Data" );
             puts( "  2. Read Configuration" );
             puts( "  3. Close" );
 
-            lChoice = WaitKey();
+            lChoice = WaitKey( EVENT_LOADING );
 
             switch( lChoice )
             {
@@ -468,7 +560,8 @@ ReplayMenu( void )
                     break;
                 case '3':
                 case  27:
-                    LeddarDisconnect( gHandle );
+                    gLoop.SetTimer( EVENT_LOADING, 0 );
+                    gDevice->Disconnect();
                     return;
             }
         }
@@ -499,7 +592,7 @@ ConfigureRecordingMenu( void )
         printf( "  2. Change max file size (%dMB)\n", LeddarGetMaxRecordFileSize() );
         puts( "  3. Quit" );
 
-        lChoice = toupper( LeddarGetKey() );
+        lChoice = WaitKey();
 
         switch( lChoice )
         {
@@ -529,20 +622,17 @@ ConfigureRecordingMenu( void )
 static void
 ListSensors( void )
 {
-    char         lAddresses[256];
-    unsigned int lCount = sizeof(lAddresses);
-    unsigned int lIndex = 0;
+    std::vector<std::string> lAddresses;
 
     puts( "\nScanning for available sensors, please wait..." );
 
-    CheckError( LeddarListSensors( lAddresses, &lCount, 2000 ) );
+    CheckError( Device::ListSensors( lAddresses, 2000 ) );
 
-    printf( "Found %d sensors\n", lCount );
+    printf( "Found %d sensors\n", (int) lAddresses.size() );
 
-    while( strlen( lAddresses+lIndex ) > 0 )
+    for( size_t i=0; i<lAddresses.size(); ++i )
     {
-        printf( "%s\n", lAddresses + lIndex );
-        lIndex += strlen( lAddresses+lIndex ) + 1;
+        printf( "%s\n", lAddresses[i].c_str() );
     }
 }
 
@@ -567,7 +657,7 @@ MainMenu( void )
         puts( "  5. Configure Recording" );
         puts( "  6. Quit" );
 
-        lChoice = toupper( LeddarGetKey() );
+        lChoice = WaitKey();
 
         switch( lChoice )
         {
@@ -596,31 +686,6 @@ MainMenu( void )
 }
 
 
-sensor_msgs::LaserScan constructLeddarMessage(std::vector<double> data){
-
-    sensor_msgs::LaserScan scan_message;
-    scan_message.header.frame_id    = "leddar_base_link";
-    scan_message.header.stamp       = ros::Time::now();
-    scan_message.header.seq         = leddar_sequence_number;
-    scan_message.angle_min          = angles::from_degrees(-22.5);
-    scan_message.angle_max          = angles::from_degrees(22.5);
-    scan_message.angle_increment    = angles::from_degrees(45/16);
-    scan_message.range_min          = 0;
-    scan_message.range_max          = 50;
-
-    std::cout << "Data size = " << data.size() << std::endl;
-
-    for(int i=0; i < data.size() ; i++){
-        scan_message.ranges.push_back(data.at(i));
-    }
-
-    std::cout << scan_message << std::endl;
-
-    leddar_sequence_number++;
-
-    return scan_message;
-}
-
 // *****************************************************************************
 // Function: main
 //
@@ -629,21 +694,68 @@ sensor_msgs::LaserScan constructLeddarMessage(std::vector<double> data){
 
 int main(int argc, char** argv){
 
+    gStartTime = ros::WallTime::now();
+
     ros::init (argc, argv, "leddartech_node");
     ros::NodeHandle n;
+    ros::NodeHandle lPrivate("~");
 
-    leddar_publisher = n.advertise<sensor_msgs::LaserScan>(std::string("leddar_scan"), 1);
+    LeddarSensorOptions lOptions;
 
+    lOptions.mStartTime = gStartTime;
+    lOptions.Read( lPrivate );
 
-    puts( "*************************************************" );
-    puts( "* Welcome to the LeddarC Demonstration Program! *" );
-    puts( "*************************************************" );
+    bool lInteractive;
+    lPrivate.param( "interactive", lInteractive, false );
 
-    gHandle = LeddarCreate();
+    if ( lInteractive )
+    {
+        if ( !gLoop.Open() || !gLoop.Watch( STDIN_FILENO, EVENT_KEY ) )
+        {
+            return 1;
+        }
 
-    MainMenu();
+        // Instead of the roscpp handler: the menus quit and the node exits.
+        struct sigaction lAction;
 
-    LeddarDestroy( gHandle );
+        memset( &lAction, 0, sizeof( lAction ) );
+        lAction.sa_handler = RequestShutdown;
+        sigaction( SIGINT, &lAction, NULL );
+        sigaction( SIGTERM, &lAction, NULL );
+
+        gSensor.reset( new LeddarSensor( std::string(), lOptions, n, lPrivate ) );
+        gDevice = &gSensor->Handle();
+
+        puts( "*************************************************" );
+        puts( "* Welcome to the LeddarC Demonstration Program! *" );
+        puts( "*************************************************" );
+
+        MainMenu();
+
+        gSensor.reset();
+        gDevice = NULL;
+    }
+    else
+    {
+        // Same driver as the nodelet, in its own process, which exits once
+        // no sensor is left running.
+        LeddarDriver lDriver( n, lPrivate, lOptions, []() { ros::shutdown(); } );
+
+        // One spinner thread per sensor so that pings and replay steps of one
+        // sensor never wait behind another.
+        ros::AsyncSpinner lSpinner( lDriver.SensorCount() );
+        lSpinner.start();
+
+        lDriver.Start();
+
+        if ( lDriver.WaitOpened() == 0 )
+        {
+            return 1;
+        }
+
+        ros::waitForShutdown();
+        lSpinner.stop();
+    }
 
     return 0;
 }
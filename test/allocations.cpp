@@ -0,0 +1,201 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    allocations.cpp
+///
+/// \brief   The publishing path allocates nothing once warmed up.
+///
+/// Every operator new of the test thread is counted while frames of the
+/// mock (LeddarCMock) go through LeddarSensor::PublishFrame, with the
+/// temporal filter, the zones, the shared memory ring and multi-echo
+/// frames. The messages built only for subscribers (multi-echo scan, cloud,
+/// batches) are checked on their builders: a subscriber in this process
+/// would make roscpp allocate its own queue entries.
+///
+/// Zone transitions are published on a latched topic, which roscpp
+/// serializes for late subscribers: the mock scene never leaves the zones
+/// over the counted frames, so none is published then.
+///
+/// Runs with rostest, on the mock: catkin_make run_tests -DLEDDARTECH_MOCK=ON.
+// *****************************************************************************
+
+#include <gtest/gtest.h>
+#include <ros/ros.h>
+#include <stdlib.h>
+
+#include <cmath>
+#include <new>
+
+#include "LeddarProperties.h"
+#include "leddartech/LeddarSensor.h"
+#include "leddartech/RayTable.h"
+#include "leddartech/ScanBatcher.h"
+#include "leddartech/ScanBuilder.h"
+
+// Allocations of the thread counting, while it counts.
+static thread_local bool     gCounting = false;
+static thread_local unsigned gAllocations = 0;
+
+void *
+operator new( size_t aSize )
+{
+    if ( gCounting )
+    {
+        ++gAllocations;
+    }
+
+    void *lMemory = malloc( aSize > 0 ? aSize : 1 );
+
+    if ( lMemory == NULL )
+    {
+        throw std::bad_alloc();
+    }
+
+    return lMemory;
+}
+
+void
+operator delete( void *aMemory ) noexcept
+{
+    free( aMemory );
+}
+
+namespace leddartech
+{
+
+// Frames processed before counting: pools and filter state settle.
+static const unsigned int kWarmupFrames = 100;
+static const unsigned int kCountedFrames = 500;
+
+// *****************************************************************************
+/// \brief   Friend of LeddarSensor, to call PublishFrame on the test thread.
+// *****************************************************************************
+
+class LeddarSensorTest : public ::testing::Test
+{
+protected:
+    static void Publish( LeddarSensor &aSensor, const LeddarFrame &aFrame )
+    {
+        aSensor.PublishFrame( aFrame );
+    }
+
+    /// \brief   Next frame of the mock record, as OnData fetches it.
+    static void Step( LeddarSensor &aSensor, LeddarFrame &aFrame )
+    {
+        Device &lDevice = aSensor.Handle();
+
+        lDevice.StepForward();
+        aFrame.mArrival = ros::Time::now();
+        aFrame.mMonotonic = MonotonicSeconds();
+        aFrame.mLevels = LDDL_DETECTIONS;
+        aFrame.mRecordIndex = lDevice.RecordIndex();
+        aFrame.mCount = lDevice.Detections( aFrame.mDetections ).Size();
+    }
+};
+
+TEST_F( LeddarSensorTest, PublishFrameDoesNotAllocate )
+{
+    ros::NodeHandle     lNode;
+    ros::NodeHandle     lPrivate( "~" );
+    LeddarSensorOptions lOptions;
+
+    // Any name loads a synthetic record in the mock, stepped from here.
+    lOptions.mReplayFile = "mock";
+    lOptions.mAutostart = false;
+    lOptions.mDiagnosticsPeriod = 0;
+    lOptions.mLatencyReportPeriod = 0;
+    lOptions.mFilter = "kalman";
+    lOptions.mCloudEchoes = 3;
+    lOptions.mShmName = "leddartech_allocation_test";
+    lOptions.mShmSlots = 8;
+
+    LeddarSensor lSensor( "", lOptions, lNode, lPrivate );
+    LeddarFrame  lFrame;
+
+    ASSERT_TRUE( lSensor.Open() );
+    lSensor.Activate();
+
+    for( unsigned int i=0; i<kWarmupFrames; ++i )
+    {
+        Step( lSensor, lFrame );
+        Publish( lSensor, lFrame );
+    }
+
+    unsigned int lAllocations = 0;
+
+    for( unsigned int i=0; i<kCountedFrames; ++i )
+    {
+        Step( lSensor, lFrame );
+        ASSERT_GT( lFrame.mCount, 0u );
+
+        gAllocations = 0;
+        gCounting = true;
+        Publish( lSensor, lFrame );
+        gCounting = false;
+        lAllocations += gAllocations;
+    }
+
+    EXPECT_EQ( 0u, lAllocations );
+
+    lSensor.Close();
+}
+
+TEST( ScanBuilder, BuildDoesNotAllocate )
+{
+    RayTable     lRays;
+    ScanBuilder  lBuilder;
+    ScanBatcher  lBatcher;
+    SegmentFrame lFrame = SegmentFrame();
+
+    lRays.SetUniform( 16, 45 );
+    lBuilder.Configure( lRays, "leddar", "leddar", LEDDAR_MAX_ECHOES );
+    lBatcher.Configure( lRays, "leddar", LEDDAR_MAX_ECHOES, 4, 0 );
+
+    lFrame.mSegmentCount = 16;
+
+    unsigned int lAllocations = 0;
+
+    // Every echo count on every segment, from the first frame on.
+    for( unsigned int i=0; i<kCountedFrames; ++i )
+    {
+        for( unsigned int s=0; s<lFrame.mSegmentCount; ++s )
+        {
+            lFrame.mEchoCount[s] = ( i + s ) % ( LEDDAR_MAX_ECHOES + 1 );
+
+            for( unsigned int e=0; e<lFrame.mEchoCount[s]; ++e )
+            {
+                lFrame.mDistance[e][s] = 1.0f + e + 0.01f * i;
+                lFrame.mAmplitude[e][s] = 100.0f;
+                lFrame.mFlags[e][s] = LEDDAR_FLAG_VALID;
+            }
+        }
+
+        gAllocations = 0;
+        gCounting = true;
+        lBuilder.Build( lFrame, i );
+        lBuilder.BuildMultiEcho( lFrame, i );
+        lBuilder.BuildCloud( lFrame, i );
+        lBatcher.Add( lFrame );
+        gCounting = false;
+        lAllocations += gAllocations;
+    }
+
+    EXPECT_EQ( 0u, lAllocations );
+}
+
+} // namespace leddartech
+
+int
+main( int argc, char **argv )
+{
+    // Multi-echo frames, and more record frames than the test steps.
+    setenv( "LEDDAR_MOCK_ECHOES", "3", 1 );
+    setenv( "LEDDAR_MOCK_RECORD_FRAMES", "100000", 1 );
+
+    testing::InitGoogleTest( &argc, argv );
+    ros::init( argc, argv, "leddartech_allocation_test" );
+
+    return RUN_ALL_TESTS();
+}
+
+// End of file allocations.cpp
@@ -0,0 +1,430 @@
+// *****************************************************************************
+// Module..: leddartech -- ROS driver for Leddar sensors.
+//
+/// \file    pipeline.cpp
+///
+/// \brief   Unit tests of the frame processing stages: binning, temporal
+///          filter, change gate, zones, record format and the shared memory
+///          ring.
+///
+/// No ROS master or sensor is needed, the tests only feed synthetic frames to
+/// the stages (catkin_make run_tests).
+// *****************************************************************************
+
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "leddartech/ChangeGate.h"
+#include "leddartech/LeddarShm.h"
+#include "leddartech/RecordFormat.h"
+#include "leddartech/SegmentFrame.h"
+#include "leddartech/ShmWriter.h"
+#include "leddartech/TemporalFilter.h"
+#include "leddartech/ZoneMonitor.h"
+
+namespace leddartech
+{
+
+/// \brief   Append a detection to a raw frame.
+static void
+AddDetection( LeddarFrame &aFrame, unsigned int aSegment, float aDistance,
+              float aAmplitude = 100, unsigned int aFlags = LEDDAR_FLAG_VALID )
+{
+    LdDetection &lDetection = aFrame.mDetections[ aFrame.mCount++ ];
+
+    lDetection.mSegment = aSegment;
+    lDetection.mDistance = aDistance;
+    lDetection.mAmplitude = aAmplitude;
+    lDetection.mFlags = aFlags;
+}
+
+/// \brief   A frame with one echo per segment at aDistance.
+static SegmentFrame
+UniformFrame( unsigned int aSegments, float aDistance, double aStamp = 1 )
+{
+    SegmentFrame lFrame = SegmentFrame();
+
+    lFrame.mStamp = ros::Time( aStamp );
+    lFrame.mSegmentCount = aSegments;
+
+    for( unsigned int s=0; s<aSegments; ++s )
+    {
+        lFrame.mEchoCount[s] = 1;
+        lFrame.mDistance[0][s] = aDistance;
+        lFrame.mAmplitude[0][s] = 100;
+        lFrame.mFlags[0][s] = LEDDAR_FLAG_VALID;
+    }
+
+    return lFrame;
+}
+
+// *****************************************************************************
+// BinDetections
+// *****************************************************************************
+
+TEST( BinDetections, SortsEchoesNearestFirst )
+{
+    LeddarFrame  lRaw = LeddarFrame();
+    SegmentFrame lBinned;
+
+    AddDetection( lRaw, 2, 7.0f );
+    AddDetection( lRaw, 0, 3.0f );
+    AddDetection( lRaw, 2, 1.5f );
+    AddDetection( lRaw, 2, 4.0f );
+
+    BinDetections( lRaw, 4, lBinned );
+
+    EXPECT_EQ( 4u, lBinned.mSegmentCount );
+    EXPECT_EQ( 1, lBinned.mEchoCount[0] );
+    EXPECT_EQ( 0, lBinned.mEchoCount[1] );
+    ASSERT_EQ( 3, lBinned.mEchoCount[2] );
+    EXPECT_FLOAT_EQ( 3.0f, lBinned.mDistance[0][0] );
+    EXPECT_FLOAT_EQ( 1.5f, lBinned.mDistance[0][2] );
+    EXPECT_FLOAT_EQ( 4.0f, lBinned.mDistance[1][2] );
+    EXPECT_FLOAT_EQ( 7.0f, lBinned.mDistance[2][2] );
+}
+
+TEST( BinDetections, SkipsInvalidAndOutOfRange )
+{
+    LeddarFrame  lRaw = LeddarFrame();
+    SegmentFrame lBinned;
+
+    AddDetection( lRaw, 0, 2.0f, 100, 0 );         // Not valid.
+    AddDetection( lRaw, 1, 2.0f, 5 );               // Too weak.
+    AddDetection( lRaw, 4, 2.0f );                  // No such segment.
+    AddDetection( lRaw, 3, 2.0f );
+
+    BinDetections( lRaw, 4, lBinned, 10 );
+
+    EXPECT_EQ( 0, lBinned.mEchoCount[0] );
+    EXPECT_EQ( 0, lBinned.mEchoCount[1] );
+    EXPECT_EQ( 0, lBinned.mEchoCount[2] );
+    EXPECT_EQ( 1, lBinned.mEchoCount[3] );
+}
+
+TEST( BinDetections, KeepsTheNearestEchoes )
+{
+    LeddarFrame  lRaw = LeddarFrame();
+    SegmentFrame lBinned;
+
+    for( unsigned int i=0; i<LEDDAR_MAX_ECHOES + 2; ++i )
+    {
+        AddDetection( lRaw, 0, 10.0f - i );
+    }
+
+    BinDetections( lRaw, 1, lBinned );
+
+    ASSERT_EQ( LEDDAR_MAX_ECHOES, lBinned.mEchoCount[0] );
+
+    for( unsigned int e=0; e<LEDDAR_MAX_ECHOES; ++e )
+    {
+        EXPECT_FLOAT_EQ( 10.0f - ( LEDDAR_MAX_ECHOES + 1 ) + e, lBinned.mDistance[e][0] );
+    }
+}
+
+// *****************************************************************************
+// ChangeGate
+// *****************************************************************************
+
+TEST( ChangeGate, PassesEverythingWhenDisabled )
+{
+    ChangeGate         lGate;
+    const SegmentFrame lFrame = UniformFrame( 4, 2.0f );
+
+    lGate.Configure( false, std::vector<double>( 1, 0.1 ), std::vector<double>(), 0 );
+
+    EXPECT_EQ( ChangeGate::GATE_CHANGED, lGate.Check( lFrame ) );
+    EXPECT_EQ( ChangeGate::GATE_CHANGED, lGate.Check( lFrame ) );
+}
+
+TEST( ChangeGate, SuppressesWithinTheDeadbands )
+{
+    ChangeGate lGate;
+
+    lGate.Configure( true, std::vector<double>( 1, 0.1 ), std::vector<double>( 1, 20 ), 0 );
+
+    EXPECT_EQ( ChangeGate::GATE_CHANGED, lGate.Check( UniformFrame( 4, 2.0f, 1.0 ) ) );
+    EXPECT_EQ( ChangeGate::GATE_SUPPRESSED, lGate.Check( UniformFrame( 4, 2.05f, 1.1 ) ) );
+
+    // Compared with the last published frame, so a slow drift gets out.
+    EXPECT_EQ( ChangeGate::GATE_SUPPRESSED, lGate.Check( UniformFrame( 4, 2.09f, 1.2 ) ) );
+    EXPECT_EQ( ChangeGate::GATE_CHANGED, lGate.Check( UniformFrame( 4, 2.15f, 1.3 ) ) );
+
+    SegmentFrame lFrame = UniformFrame( 4, 2.15f, 1.4 );
+
+    lFrame.mAmplitude[0][1] += 30;
+    EXPECT_EQ( ChangeGate::GATE_CHANGED, lGate.Check( lFrame ) );
+
+    // An echo gained or lost always counts.
+    lFrame.mEchoCount[3] = 0;
+    EXPECT_EQ( ChangeGate::GATE_CHANGED, lGate.Check( lFrame ) );
+}
+
+TEST( ChangeGate, PerSegmentDeadbands )
+{
+    ChangeGate          lGate;
+    std::vector<double> lDeadbands;
+
+    lDeadbands.push_back( 0.01 );
+    lDeadbands.push_back( 1.0 );
+
+    // Segments past the list take its last value.
+    lGate.Configure( true, lDeadbands, std::vector<double>(), 0 );
+    lGate.Check( UniformFrame( 4, 2.0f ) );
+
+    SegmentFrame lFrame = UniformFrame( 4, 2.0f );
+
+    lFrame.mDistance[0][3] = 2.5f;
+    EXPECT_EQ( ChangeGate::GATE_SUPPRESSED, lGate.Check( lFrame ) );
+
+    lFrame.mDistance[0][0] = 2.05f;
+    EXPECT_EQ( ChangeGate::GATE_CHANGED, lGate.Check( lFrame ) );
+}
+
+TEST( ChangeGate, KeepAlive )
+{
+    ChangeGate lGate;
+
+    // 2 Hz: a static scene is published every 0.5 s.
+    lGate.Configure( true, std::vector<double>( 1, 0.1 ), std::vector<double>(), 2.0 );
+
+    EXPECT_EQ( ChangeGate::GATE_CHANGED, lGate.Check( UniformFrame( 4, 2.0f, 10.0 ) ) );
+    EXPECT_EQ( ChangeGate::GATE_SUPPRESSED, lGate.Check( UniformFrame( 4, 2.0f, 10.3 ) ) );
+    EXPECT_EQ( ChangeGate::GATE_KEEP_ALIVE, lGate.Check( UniformFrame( 4, 2.0f, 10.5 ) ) );
+    EXPECT_EQ( ChangeGate::GATE_SUPPRESSED, lGate.Check( UniformFrame( 4, 2.0f, 10.9 ) ) );
+    EXPECT_EQ( ChangeGate::GATE_KEEP_ALIVE, lGate.Check( UniformFrame( 4, 2.0f, 11.0 ) ) );
+}
+
+// *****************************************************************************
+// ZoneMonitor
+// *****************************************************************************
+
+class ZoneMonitorTest : public ::testing::Test
+{
+protected:
+    void SetUp( void )
+    {
+        ZoneSettings lZone;
+
+        lZone.mName = "door";
+        lZone.mNearLimit = 1.0f;
+        lZone.mFarLimit = 3.0f;
+        lZone.mSegments = 0x6;     // Segments 1 and 2.
+        lZone.mRisingDebounce = 3;
+        lZone.mFallingDebounce = 2;
+
+        mMonitor.Configure( std::vector<ZoneSettings>( 1, lZone ) );
+    }
+
+    /// \brief   Update with one frame, nothing in the zone but aDistance on
+    ///          segment aSegment.
+    unsigned int Update( unsigned int aSegment, float aDistance )
+    {
+        SegmentFrame lFrame = UniformFrame( 4, 10.0f );
+
+        lFrame.mDistance[0][aSegment] = aDistance;
+        return mMonitor.Update( lFrame, mTransitions );
+    }
+
+    ZoneMonitor    mMonitor;
+    ZoneTransition mTransitions[ ZoneMonitor::kMaxZones ];
+};
+
+TEST_F( ZoneMonitorTest, RisingDebounce )
+{
+    EXPECT_EQ( 0u, Update( 1, 2.0f ) );
+    EXPECT_EQ( 0u, Update( 1, 2.0f ) );
+
+    // An empty frame restarts the count.
+    EXPECT_EQ( 0u, Update( 1, 5.0f ) );
+    EXPECT_EQ( 0u, Update( 2, 2.5f ) );
+    EXPECT_EQ( 0u, Update( 2, 2.5f ) );
+    ASSERT_EQ( 1u, Update( 2, 2.5f ) );
+
+    EXPECT_EQ( 0u, mTransitions[0].mZone );
+    EXPECT_TRUE( mTransitions[0].mEnter );
+    EXPECT_EQ( 2u, mTransitions[0].mSegment );
+    EXPECT_FLOAT_EQ( 2.5f, mTransitions[0].mDistance );
+    EXPECT_EQ( 1u, mMonitor.Occupied() );
+
+    // Occupied stays occupied, without events.
+    EXPECT_EQ( 0u, Update( 2, 2.5f ) );
+}
+
+TEST_F( ZoneMonitorTest, FallingDebounce )
+{
+    for( unsigned int i=0; i<3; ++i )
+    {
+        Update( 1, 2.0f );
+    }
+
+    ASSERT_EQ( 1u, mMonitor.Occupied() );
+
+    // Outside the limits or the segments is empty.
+    EXPECT_EQ( 0u, Update( 1, 0.5f ) );
+    EXPECT_EQ( 0u, Update( 1, 2.0f ) );
+    EXPECT_EQ( 0u, Update( 1, 3.0f ) );
+    ASSERT_EQ( 1u, Update( 0, 2.0f ) );
+
+    EXPECT_FALSE( mTransitions[0].mEnter );
+    EXPECT_EQ( 0u, mMonitor.Occupied() );
+}
+
+// *****************************************************************************
+// TemporalFilter
+// *****************************************************************************
+
+TEST( TemporalFilter, KeepsEchoesNearestFirst )
+{
+    TemporalFilter lFilter;
+    SegmentFrame   lFrame = UniformFrame( 4, 5.0f );
+
+    lFilter.Configure( TemporalFilter::FILTER_EXPONENTIAL, 5, 0.5f, 4, 0.0025f, 0.02f );
+    lFilter.Apply( lFrame );
+
+    // The first echo of segment 1 jumps close, filtered it lands past 2 m.
+    lFrame = UniformFrame( 4, 5.0f );
+    lFrame.mEchoCount[1] = 3;
+    lFrame.mDistance[0][1] = 1.0f;
+    lFrame.mDistance[1][1] = 2.0f;
+    lFrame.mDistance[2][1] = 4.0f;
+    lFrame.mAmplitude[0][1] = 10.0f;
+    lFrame.mAmplitude[1][1] = 20.0f;
+    lFrame.mAmplitude[2][1] = 40.0f;
+    lFilter.Apply( lFrame );
+
+    ASSERT_EQ( 3, lFrame.mEchoCount[1] );
+    EXPECT_FLOAT_EQ( 2.0f, lFrame.mDistance[0][1] );
+    EXPECT_FLOAT_EQ( 3.0f, lFrame.mDistance[1][1] );
+    EXPECT_FLOAT_EQ( 4.0f, lFrame.mDistance[2][1] );
+    EXPECT_FLOAT_EQ( 20.0f, lFrame.mAmplitude[0][1] );
+    EXPECT_FLOAT_EQ( 10.0f, lFrame.mAmplitude[1][1] );
+    EXPECT_FLOAT_EQ( 40.0f, lFrame.mAmplitude[2][1] );
+}
+
+// *****************************************************************************
+// RecordFormat
+// *****************************************************************************
+
+TEST( RecordFormat, RoundTrip )
+{
+    SegmentFrame lFrame = UniformFrame( 8, 4.0f );
+
+    lFrame.mStamp = ros::Time( 1500000000, 123456789 );
+    lFrame.mArrival = ros::Time( 1500000000, 223456789 );
+    lFrame.mRecordIndex = 42;
+    lFrame.mEchoCount[2] = 0;
+    lFrame.mEchoCount[5] = 3;
+    lFrame.mDistance[1][5] = 6.0f;
+    lFrame.mDistance[2][5] = 8.5f;
+    lFrame.mAmplitude[1][5] = 12.0f;
+    lFrame.mAmplitude[2][5] = 3.0f;
+    lFrame.mFlags[1][5] = 0x11;
+    lFrame.mFlags[2][5] = 0x21;
+
+    std::vector<uint8_t> lBuffer( kRecordMaxFrameSize );
+    SegmentFrame         lDecoded;
+    const size_t         lSize = EncodeFrame( lFrame, &lBuffer[0] );
+
+    ASSERT_EQ( lSize, DecodeFrame( &lBuffer[0], lSize, lDecoded ) );
+    EXPECT_EQ( lFrame.mStamp, lDecoded.mStamp );
+    EXPECT_EQ( lFrame.mArrival, lDecoded.mArrival );
+    EXPECT_EQ( lFrame.mRecordIndex, lDecoded.mRecordIndex );
+    ASSERT_EQ( lFrame.mSegmentCount, lDecoded.mSegmentCount );
+
+    for( unsigned int s=0; s<lFrame.mSegmentCount; ++s )
+    {
+        ASSERT_EQ( lFrame.mEchoCount[s], lDecoded.mEchoCount[s] );
+
+        for( unsigned int e=0; e<lFrame.mEchoCount[s]; ++e )
+        {
+            EXPECT_EQ( lFrame.mDistance[e][s], lDecoded.mDistance[e][s] );
+            EXPECT_EQ( lFrame.mAmplitude[e][s], lDecoded.mAmplitude[e][s] );
+            EXPECT_EQ( lFrame.mFlags[e][s], lDecoded.mFlags[e][s] );
+        }
+    }
+
+    // Truncated frames are rejected.
+    EXPECT_EQ( 0u, DecodeFrame( &lBuffer[0], lSize - 1, lDecoded ) );
+    EXPECT_EQ( 0u, DecodeFrame( &lBuffer[0], sizeof( RecordFrameHeader ) - 1, lDecoded ) );
+}
+
+// *****************************************************************************
+// LeddarShm
+// *****************************************************************************
+
+TEST( LeddarShm, ReadStatus )
+{
+    static const char *const kName = "/leddartech_test_shm";
+    static const unsigned    kSlots = 4;
+
+    ShmWriter lWriter;
+
+    ASSERT_TRUE( lWriter.Open( kName, kSlots, 8 ) );
+
+    LeddarShm *lShm = LeddarShmOpen( kName );
+
+    ASSERT_TRUE( lShm != NULL );
+    EXPECT_TRUE( LeddarShmActive( lShm ) );
+    EXPECT_EQ( kSlots, LeddarShmSlotCount( lShm ) );
+    EXPECT_EQ( 8u, LeddarShmSegmentCount( lShm ) );
+
+    LeddarShmFrame lFrame;
+
+    EXPECT_EQ( LEDDAR_SHM_NOT_YET, LeddarShmLatest( lShm, &lFrame ) );
+    EXPECT_EQ( LEDDAR_SHM_NOT_YET, LeddarShmRead( lShm, 0, &lFrame ) );
+
+    for( unsigned int i=0; i<kSlots + 2; ++i )
+    {
+        lWriter.Write( UniformFrame( 8, 1.0f + i ) );
+    }
+
+    EXPECT_EQ( kSlots + 2, LeddarShmWritten( lShm ) );
+
+    // Frames 0 and 1 were lapped, 2 to 5 are in the ring.
+    EXPECT_EQ( LEDDAR_SHM_OVERWRITTEN, LeddarShmRead( lShm, 1, &lFrame ) );
+    ASSERT_EQ( LEDDAR_SHM_OK, LeddarShmRead( lShm, 2, &lFrame ) );
+    EXPECT_EQ( 2u, lFrame.mIndex );
+    EXPECT_FLOAT_EQ( 3.0f, lFrame.mDistance[0][7] );
+    EXPECT_EQ( LEDDAR_SHM_NOT_YET, LeddarShmRead( lShm, kSlots + 2, &lFrame ) );
+
+    ASSERT_EQ( LEDDAR_SHM_OK, LeddarShmLatest( lShm, &lFrame ) );
+    EXPECT_EQ( kSlots + 1, lFrame.mIndex );
+
+    // A slot left odd looks like a writer still writing it.
+    const int lFd = shm_open( kName, O_RDWR, 0 );
+
+    ASSERT_GE( lFd, 0 );
+
+    const size_t lSize = sizeof( LeddarShmHeader ) + kSlots * sizeof( LeddarShmSlot );
+    void        *lMap = mmap( NULL, lSize, PROT_READ | PROT_WRITE, MAP_SHARED, lFd, 0 );
+
+    close( lFd );
+    ASSERT_NE( MAP_FAILED, lMap );
+
+    LeddarShmSlot *lSlots = reinterpret_cast<LeddarShmSlot *>( static_cast<LeddarShmHeader *>( lMap ) + 1 );
+
+    lSlots[ 3 % kSlots ].mSequence |= 1;
+    EXPECT_EQ( LEDDAR_SHM_BUSY, LeddarShmRead( lShm, 3, &lFrame ) );
+    munmap( lMap, lSize );
+
+    lWriter.Close();
+    EXPECT_FALSE( LeddarShmActive( lShm ) );
+    LeddarShmClose( lShm );
+}
+
+} // namespace leddartech
+
+int
+main( int argc, char **argv )
+{
+    testing::InitGoogleTest( &argc, argv );
+    return RUN_ALL_TESTS();
+}
+
+// End of file pipeline.cpp